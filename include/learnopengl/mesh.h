@@ -7,6 +7,12 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <learnopengl/shader.h>
+#include <rg/VertexPacking.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
 
 #include <string>
 #include <vector>
@@ -27,6 +33,13 @@ struct Vertex {
 
 
 
+// layout of the vertex buffer a Mesh uploads. Full is Vertex as is, Packed is rg::PackedVertex (20 instead of 56 bytes)
+// and needs the PACKED_VERTICES variant of the shaders, which dequantize the position with meshBoundsMin/meshBoundsExtent.
+enum class VertexFormat {
+    Full,
+    Packed
+};
+
 struct Texture {
     unsigned int id;
     string type;
@@ -41,81 +54,218 @@ public:
     vector<Texture>      textures;
 
     unsigned int VAO;
+    // range of the mesh in the buffers of its VAO, which may be shared with other meshes
+    unsigned int firstIndex;
+    unsigned int indexCount;
+    int baseVertex;
+    GLenum indexType;
+    VertexFormat format;
+    // object space bounds, the sphere is centered on the box and only as large as the vertices need
+    glm::vec3 boundsMin;
+    glm::vec3 boundsMax;
+    glm::vec3 boundsCenter;
+    float boundsRadius;
     std::string glslIdentifierPrefix;
     // constructor
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, VertexFormat format = VertexFormat::Full)
+        : format(format)
     {
         this->vertices = vertices;
         this->indices = indices;
         this->textures = textures;
 
         // now that we have all the required data, set the vertex buffers and its attribute pointers.
-        setupMesh();
+        setupMesh(this->vertices.data(), this->vertices.size(), this->indices.data(), this->indices.size());
+    }
+
+    // constructor for data that lives outside of the mesh (e.g. a memory mapped cooked model).
+    // the data is uploaded directly and not kept on the CPU side, so vertices and indices stay empty.
+    Mesh(const Vertex *vertexData, size_t vertexCount, const unsigned int *indexData, size_t indexCount, vector<Texture> textures,
+         VertexFormat format = VertexFormat::Full)
+        : format(format)
+    {
+        this->textures = textures;
+        setupMesh(vertexData, vertexCount, indexData, indexCount);
+    }
+
+    // constructor for a range of buffers the caller filled with appendVertexData/appendIndexData and set up
+    // with setupVertexAttributes, so several meshes can be drawn from one VAO.
+    Mesh(unsigned int VAO, GLenum indexType, unsigned int firstIndex, unsigned int indexCount, int baseVertex,
+         glm::vec3 boundsMin, glm::vec3 boundsMax, float boundsRadius, vector<Texture> textures, VertexFormat format)
+        : textures(textures), VAO(VAO), firstIndex(firstIndex), indexCount(indexCount), baseVertex(baseVertex),
+          indexType(indexType), format(format), boundsMin(boundsMin), boundsMax(boundsMax),
+          boundsCenter((boundsMin + boundsMax) * 0.5f), boundsRadius(boundsRadius), VBO(0), EBO(0)
+    {
     }
 
     // render the mesh
     void Draw(Shader &shader)
     {
+        bindMaterial(shader);
+
+        // draw mesh, the VAO and the textures stay bound so the next draw of the same mesh doesn't rebind them
+        rg::GLState::instance().bindVertexArray(VAO);
+        DrawElements();
+    }
+
+    // render instanceCount copies of the mesh, the per-instance model matrices are read from the buffer
+    // set up with setupInstanceAttributes (see Model::DrawInstanced) and need the INSTANCED shader variants.
+    void DrawInstanced(Shader &shader, unsigned int instanceCount)
+    {
+        bindMaterial(shader);
+
+        rg::GLState::instance().bindVertexArray(VAO);
+        DrawElements(instanceCount);
+    }
+
+    // issues only the draw call, for callers that bound the VAO and the material themselves (see rg::RenderQueue)
+    void DrawElements(unsigned int instanceCount = 1) const
+    {
+        const void *offset = (void*)(size_t(firstIndex) * indexSize(indexType));
+        if (instanceCount == 1)
+            glDrawElementsBaseVertex(GL_TRIANGLES, indexCount, indexType, offset, baseVertex);
+        else
+            glDrawElementsInstancedBaseVertex(GL_TRIANGLES, indexCount, indexType, offset, instanceCount, baseVertex);
+    }
+
+    // binds the textures of the mesh and sets the uniforms it needs
+    void bindMaterial(Shader &shader)
+    {
+        bindTextures(shader);
+        bindBounds(shader);
+    }
+
+    // binds the textures of the mesh to units 0..n-1 and points the samplers at them
+    void bindTextures(Shader &shader)
+    {
+        const ShaderUniforms &uniforms = uniformsFor(shader);
         // bind appropriate textures
-        unsigned int diffuseNr  = 1;
-        unsigned int specularNr = 1;
-        unsigned int normalNr   = 1;
-        unsigned int heightNr   = 1;
         for(unsigned int i = 0; i < textures.size(); i++)
         {
-            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
-            // retrieve texture number (the N in diffuse_textureN)
-            string number;
-            string name = textures[i].type;
-            if(name == "texture_diffuse")
-                number = std::to_string(diffuseNr++);
-            else if(name == "texture_specular")
-                number = std::to_string(specularNr++); // transfer unsigned int to stream
-            else if(name == "texture_normal")
-                number = std::to_string(normalNr++); // transfer unsigned int to stream
-            else if(name == "texture_height")
-                number = std::to_string(heightNr++); // transfer unsigned int to stream
+            // set the sampler to the texture unit
+            uniforms.samplers[i].set((int)i);
+            // and bind the texture, the unit is only made active when the binding changes
+            rg::GLState::instance().bindTexture(i, GL_TEXTURE_2D, textures[i].id);
+        }
+    }
 
-            // now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shader.ID, (glslIdentifierPrefix + name + number).c_str()), i);
-            // and finally bind the texture
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+    // packed positions are stored relative to the mesh bounds, nothing to do for full vertices
+    void bindBounds(Shader &shader)
+    {
+        if (format == VertexFormat::Packed)
+        {
+            const ShaderUniforms &uniforms = uniformsFor(shader);
+            uniforms.boundsMin.set(boundsMin);
+            uniforms.boundsExtent.set(boundsMax - boundsMin);
         }
+    }
 
+    // the sampler names are built from the prefix, so the cached uniform handles are dropped
+    void SetShaderTextureNamePrefix(const std::string &prefix)
+    {
+        glslIdentifierPrefix = prefix;
+        shaderUniforms.clear();
+    }
 
+    static void computeBounds(const Vertex *vertexData, size_t vertexCount, glm::vec3 &boundsMin, glm::vec3 &boundsMax)
+    {
+        boundsMin = glm::vec3(FLT_MAX);
+        boundsMax = glm::vec3(-FLT_MAX);
+        for (size_t i = 0; i < vertexCount; i++)
+        {
+            boundsMin = glm::min(boundsMin, vertexData[i].Position);
+            boundsMax = glm::max(boundsMax, vertexData[i].Position);
+        }
+        if (vertexCount == 0)
+            boundsMin = boundsMax = glm::vec3(0.0f);
+    }
 
-        // draw mesh
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
+    // radius of the sphere around the center of the box that holds every vertex, at most half the box diagonal
+    static float computeBoundsRadius(const Vertex *vertexData, size_t vertexCount, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax)
+    {
+        glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+        float radius2 = 0.0f;
+        for (size_t i = 0; i < vertexCount; i++)
+        {
+            glm::vec3 d = vertexData[i].Position - center;
+            radius2 = std::max(radius2, glm::dot(d, d));
+        }
+        return std::sqrt(radius2);
+    }
 
-        // always good practice to set everything back to defaults once configured.
-        glActiveTexture(GL_TEXTURE0);
+    static size_t vertexSize(VertexFormat format)
+    {
+        return format == VertexFormat::Packed ? sizeof(rg::PackedVertex) : sizeof(Vertex);
     }
 
-private:
-    // render data
-    unsigned int VBO, EBO;
+    // 16 bit indices whenever every index of the range fits
+    static GLenum indexTypeFor(size_t vertexCount)
+    {
+        return vertexCount <= 65536 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    }
 
-    // initializes all the buffer objects/arrays
-    void setupMesh()
+    static size_t indexSize(GLenum indexType)
     {
-        // create buffers/arrays
-        glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
-        glGenBuffers(1, &EBO);
+        return indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+    }
 
-        glBindVertexArray(VAO);
-        // load data into vertex buffers
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        // A great thing about structs is that their memory layout is sequential for all its items.
-        // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
-        // again translates to 3/2 floats which translates to a byte array.
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+    // appends the vertices in the given format, packed positions are quantized relative to the given bounds.
+    static void appendVertexData(vector<unsigned char> &out, const Vertex *vertexData, size_t vertexCount, VertexFormat format,
+                                 const glm::vec3 &boundsMin, const glm::vec3 &boundsMax)
+    {
+        size_t offset = out.size();
+        out.resize(offset + vertexCount * vertexSize(format));
+        if (format == VertexFormat::Full)
+        {
+            std::memcpy(out.data() + offset, vertexData, vertexCount * sizeof(Vertex));
+            return;
+        }
+        glm::vec3 extent = boundsMax - boundsMin;
+        for (size_t i = 0; i < vertexCount; i++)
+        {
+            const Vertex &v = vertexData[i];
+            rg::PackedVertex packed = rg::packVertex(v.Position, v.Normal, v.TexCoords, v.Tangent, v.Bitangent, boundsMin, extent);
+            std::memcpy(out.data() + offset + i * sizeof(rg::PackedVertex), &packed, sizeof(packed));
+        }
+    }
 
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+    static void appendIndexData(vector<unsigned char> &out, const unsigned int *indexData, size_t indexCount, GLenum indexType)
+    {
+        size_t offset = out.size();
+        out.resize(offset + indexCount * indexSize(indexType));
+        if (indexType == GL_UNSIGNED_INT)
+        {
+            std::memcpy(out.data() + offset, indexData, indexCount * sizeof(unsigned int));
+            return;
+        }
+        for (size_t i = 0; i < indexCount; i++)
+        {
+            unsigned short index = (unsigned short) indexData[i];
+            std::memcpy(out.data() + offset + i * sizeof(unsigned short), &index, sizeof(index));
+        }
+    }
 
+    // sets the attribute pointers of the bound VAO for the vertex buffer bound to GL_ARRAY_BUFFER.
+    static void setupVertexAttributes(VertexFormat format)
+    {
+        if (format == VertexFormat::Packed)
+        {
+            // the attribute locations stay the same as for Vertex, the bitangent (location 4) is rebuilt
+            // in the shader from the sign stored in the position w.
+            // vertex Positions (xyz) and bitangent sign (w)
+            glEnableVertexAttribArray(0);
+            glVertexAttribPointer(0, 4, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(rg::PackedVertex), (void*)offsetof(rg::PackedVertex, Position));
+            // octahedral normals
+            glEnableVertexAttribArray(1);
+            glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, sizeof(rg::PackedVertex), (void*)offsetof(rg::PackedVertex, Normal));
+            // vertex texture coords
+            glEnableVertexAttribArray(2);
+            glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(rg::PackedVertex), (void*)offsetof(rg::PackedVertex, TexCoords));
+            // octahedral tangents
+            glEnableVertexAttribArray(3);
+            glVertexAttribPointer(3, 2, GL_SHORT, GL_TRUE, sizeof(rg::PackedVertex), (void*)offsetof(rg::PackedVertex, Tangent));
+            return;
+        }
         // set the vertex attribute pointers
         // vertex Positions
         glEnableVertexAttribArray(0);
@@ -132,8 +282,117 @@ private:
         // vertex bitangent
         glEnableVertexAttribArray(4);
         glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
+    }
+
+    // per-instance model matrix of the bound VAO, read from the buffer bound to GL_ARRAY_BUFFER starting at offset.
+    // a mat4 attribute takes four consecutive locations, one per column.
+    // a divisor above 1 repeats every matrix for that many consecutive instances (see rg::Pipeline::layers)
+    static void setupInstanceAttributes(size_t offset = 0, unsigned int divisor = 1)
+    {
+        for (unsigned int column = 0; column < 4; column++)
+        {
+            glEnableVertexAttribArray(INSTANCE_MATRIX_LOCATION + column);
+            glVertexAttribPointer(INSTANCE_MATRIX_LOCATION + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4),
+                                  (void*)(offset + column * sizeof(glm::vec4)));
+            glVertexAttribDivisor(INSTANCE_MATRIX_LOCATION + column, divisor);
+        }
+    }
+
+    static const unsigned int INSTANCE_MATRIX_LOCATION = 5;
+
+private:
+    // render data
+    unsigned int VBO, EBO;
+
+    // handles of the uniforms the mesh sets, per shader it is drawn with
+    struct ShaderUniforms
+    {
+        unsigned int shaderID;
+        vector<UniformHandle<int>> samplers;
+        UniformHandle<glm::vec3> boundsMin;
+        UniformHandle<glm::vec3> boundsExtent;
+    };
+    vector<ShaderUniforms> shaderUniforms;
+
+    // resolves the handles the first time the mesh is drawn with a shader, a mesh only ever sees a few shaders
+    const ShaderUniforms& uniformsFor(const Shader &shader)
+    {
+        for (const ShaderUniforms &uniforms : shaderUniforms)
+            if (uniforms.shaderID == shader.ID)
+                return uniforms;
+
+        ShaderUniforms uniforms;
+        uniforms.shaderID = shader.ID;
+        unsigned int diffuseNr  = 1;
+        unsigned int specularNr = 1;
+        unsigned int normalNr   = 1;
+        unsigned int heightNr   = 1;
+        for (const Texture &texture : textures)
+        {
+            // retrieve texture number (the N in diffuse_textureN)
+            string number;
+            const string &name = texture.type;
+            if(name == "texture_diffuse")
+                number = std::to_string(diffuseNr++);
+            else if(name == "texture_specular")
+                number = std::to_string(specularNr++); // transfer unsigned int to stream
+            else if(name == "texture_normal")
+                number = std::to_string(normalNr++); // transfer unsigned int to stream
+            else if(name == "texture_height")
+                number = std::to_string(heightNr++); // transfer unsigned int to stream
+            uniforms.samplers.push_back(shader.uniform<int>(glslIdentifierPrefix + name + number));
+        }
+        uniforms.boundsMin = shader.uniform<glm::vec3>("meshBoundsMin");
+        uniforms.boundsExtent = shader.uniform<glm::vec3>("meshBoundsExtent");
+        shaderUniforms.push_back(uniforms);
+        return shaderUniforms.back();
+    }
+
+    // initializes all the buffer objects/arrays
+    void setupMesh(const Vertex *vertexData, size_t vertexCount, const unsigned int *indexData, size_t indexCount)
+    {
+        this->firstIndex = 0;
+        this->indexCount = indexCount;
+        this->baseVertex = 0;
+        this->indexType = indexTypeFor(vertexCount);
+        computeBounds(vertexData, vertexCount, boundsMin, boundsMax);
+        boundsCenter = (boundsMin + boundsMax) * 0.5f;
+        boundsRadius = computeBoundsRadius(vertexData, vertexCount, boundsMin, boundsMax);
+
+        // create buffers/arrays
+        glGenVertexArrays(1, &VAO);
+        glGenBuffers(1, &VBO);
+        glGenBuffers(1, &EBO);
+
+        rg::GLState::instance().bindVertexArray(VAO);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        if (indexType == GL_UNSIGNED_INT)
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(unsigned int), indexData, GL_STATIC_DRAW);
+        else
+        {
+            // every index fits in 16 bits, halves the index buffer
+            vector<unsigned char> shortIndices;
+            appendIndexData(shortIndices, indexData, indexCount, indexType);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, shortIndices.size(), shortIndices.data(), GL_STATIC_DRAW);
+        }
+
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        if (format == VertexFormat::Full)
+        {
+            // A great thing about structs is that their memory layout is sequential for all its items.
+            // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
+            // again translates to 3/2 floats which translates to a byte array.
+            glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(Vertex), vertexData, GL_STATIC_DRAW);
+        }
+        else
+        {
+            vector<unsigned char> packed;
+            appendVertexData(packed, vertexData, vertexCount, format, boundsMin, boundsMax);
+            glBufferData(GL_ARRAY_BUFFER, packed.size(), packed.data(), GL_STATIC_DRAW);
+        }
+        setupVertexAttributes(format);
 
-        glBindVertexArray(0);
+        rg::GLState::instance().bindVertexArray(0);
     }
 };
-#endif
\ No newline at end of file
+#endif
@@ -6,13 +6,18 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <stb_image.h>
-#include <assimp/Importer.hpp>
-#include <assimp/scene.h>
-#include <assimp/postprocess.h>
-
 #include <learnopengl/mesh.h>
 #include <learnopengl/shader.h>
-
+#include <rg/CookedModel.h>
+#include <rg/CpuProfiler.h>
+#include <rg/GLExtensions.h>
+#include <rg/GLState.h>
+#include <rg/ImageDecodePool.h>
+#include <rg/KtxFile.h>
+#include <rg/TextureRegistry.h>
+#include <rg/ModelImporter.h>
+
+#include <cstring>
 #include <string>
 #include <fstream>
 #include <sstream>
@@ -29,230 +34,363 @@ class Model
 {
 public:
     // model data
-    vector<Texture> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
+    vector<Texture> textures_loaded;	// stores all the texture references this model holds in the texture registry
     vector<Mesh>    meshes;
     string directory;
     bool gammaCorrection;
+    VertexFormat vertexFormat;
+    bool mergeMaterials;
 
     // constructor, expects a filepath to a 3D model.
-    Model(string const &path, bool gamma = false) : gammaCorrection(gamma)
+    // a cooked binary version of the model (see rg/CookedModel.h) is used when it is up to date,
+    // Assimp only runs when it is missing or stale and the result is cooked for the next run.
+    // with VertexFormat::Packed the model has to be drawn with the PACKED_VERTICES variant of its shaders.
+    // with mergeMaterials all meshes of a material are merged into one mesh inside a single model wide buffer.
+    Model(string const &path, bool gamma = false, VertexFormat format = VertexFormat::Full, bool mergeMaterials = false)
+        : gammaCorrection(gamma), vertexFormat(format), mergeMaterials(mergeMaterials)
     {
-        loadModel(path);
+        RG_PROFILE_ZONE("Load model");
+        // retrieve the directory path of the filepath
+        directory = path.substr(0, path.find_last_of('/'));
+
+        string cookedPath = rg::cookedModelPath(path);
+        if (!rg::isCookedModelFresh(cookedPath, path) || !loadCookedModel(cookedPath))
+            loadModel(path, cookedPath);
+    }
+
+    ~Model()
+    {
+        for (const Texture &texture : textures_loaded)
+            rg::TextureRegistry::instance().release(texture.id);
+        if (instanceVBO)
+            glDeleteBuffers(1, &instanceVBO);
+        if (mergedVAO)
+        {
+            rg::GLState::instance().vertexArrayDeleted(mergedVAO);
+            glDeleteVertexArrays(1, &mergedVAO);
+            glDeleteBuffers(1, &mergedVBO);
+            glDeleteBuffers(1, &mergedEBO);
+        }
     }
 
+    // a copy would release the shared textures twice
+    Model(const Model&) = delete;
+    Model& operator=(const Model&) = delete;
+
     // draws the model, and thus all its meshes
     void Draw(Shader &shader)
     {
+        RG_PROFILE_ZONE("Model::Draw");
         for(unsigned int i = 0; i < meshes.size(); i++)
             meshes[i].Draw(shader);
     }
 
+    // draws one instance of the model per matrix with one draw call per mesh. the shader has to be an INSTANCED
+    // variant, which takes the model matrix from the per-instance attribute instead of the model uniform.
+    void DrawInstanced(Shader &shader, const vector<glm::mat4> &instances)
+    {
+        if (instances.empty())
+            return;
+        uploadInstances(instances);
+        for (Mesh &mesh : meshes)
+            mesh.DrawInstanced(shader, (unsigned int) instances.size());
+    }
+
     void SetShaderTextureNamePrefix(std::string prefix) {
         for (Mesh& mesh: meshes) {
-            mesh.glslIdentifierPrefix = prefix;
+            mesh.SetShaderTextureNamePrefix(prefix);
         }
     }
 private:
-    // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
-    void loadModel(string const &path)
+    // buffers shared by all meshes when they are merged by material
+    unsigned int mergedVAO = 0, mergedVBO = 0, mergedEBO = 0;
+
+    // per-instance model matrices of DrawInstanced, only uploaded again when they change between calls
+    unsigned int instanceVBO = 0;
+    vector<glm::mat4> uploadedInstances;
+
+    void uploadInstances(const vector<glm::mat4> &instances)
     {
-        // read file via ASSIMP
-        Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
-        // check for errors
-        if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
+        if (!instanceVBO)
+            glGenBuffers(1, &instanceVBO);
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        if (instances != uploadedInstances)
         {
-            cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
-            return;
+            glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(glm::mat4), instances.data(), GL_DYNAMIC_DRAW);
+            uploadedInstances = instances;
+        }
+        // the attributes are pointed at our buffer on every call, rg::RenderQueue points them at its own
+        unsigned int lastVAO = 0;
+        for (const Mesh &mesh : meshes)
+        {
+            // merged meshes share their VAO
+            if (mesh.VAO == lastVAO)
+                continue;
+            rg::GLState::instance().bindVertexArray(mesh.VAO);
+            Mesh::setupInstanceAttributes();
+            lastVAO = mesh.VAO;
         }
-        // retrieve the directory path of the filepath
-        directory = path.substr(0, path.find_last_of('/'));
-
-        // process ASSIMP's root node recursively
-        processNode(scene->mRootNode, scene);
     }
 
-    // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-    void processNode(aiNode *node, const aiScene *scene)
+    // a mesh as it comes from the importer or the cooked file, before it is uploaded.
+    struct MeshSource
     {
-        // process each mesh located at the current node
-        for(unsigned int i = 0; i < node->mNumMeshes; i++)
-        {
-            // the node object only contains indices to index the actual objects in the scene.
-            // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
-            aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-            meshes.push_back(processMesh(mesh, scene));
-        }
-        // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
-        for(unsigned int i = 0; i < node->mNumChildren; i++)
+        const Vertex *vertices;
+        size_t vertexCount;
+        const unsigned int *indices;
+        size_t indexCount;
+        unsigned int material;
+    };
+
+    // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
+    void loadModel(string const &path, string const &cookedPath)
+    {
+        rg::ImportedModel model;
+        if (!rg::importModel(path, model))
+            return;
+        if (!rg::writeCookedModel(cookedPath, path, model))
+            cout << "WARNING::MODEL:: failed to write cooked model " << cookedPath << endl;
+
+        vector<MeshSource> sources;
+        for (size_t i = 0; i < model.meshes.size(); i++)
         {
-            processNode(node->mChildren[i], scene);
+            const rg::ImportedMesh &mesh = model.meshes[i];
+            sources.push_back(MeshSource{mesh.vertices.data(), mesh.vertices.size(), mesh.indices.data(), mesh.indices.size(), mesh.material});
+            rg::reportMeshOptimization(path + " mesh " + std::to_string(i), mesh.optimization);
         }
 
+        // the textures of every used material are acquired once, no matter how many meshes share it
+        vector<vector<Texture>> materialTextures(model.materials.size());
+        vector<bool> used = usedMaterials(sources, model.materials.size());
+        for (size_t i = 0; i < model.materials.size(); i++)
+            if (used[i])
+                for (const rg::ImportedTexture &texture : model.materials[i].textures)
+                    materialTextures[i].push_back(loadMaterialTexture(texture.path, texture.type));
+        buildMeshes(sources, materialTextures);
     }
 
-    Mesh processMesh(aiMesh *mesh, const aiScene *scene)
+    // loads a cooked model, the vertex and index blobs are uploaded straight from the file mapping.
+    bool loadCookedModel(string const &cookedPath)
     {
-        // data to fill
-        vector<Vertex> vertices;
-        vector<unsigned int> indices;
-        vector<Texture> textures;
+        rg::MappedFile file;
+        rg::CookedModelView cooked;
+        if (!file.open(cookedPath) || !cooked.open(file))
+            return false;
+
+        const rg::CookedModelHeader &header = cooked.header();
+        vector<MeshSource> sources;
+        for (uint32_t i = 0; i < header.meshCount; i++)
+        {
+            const rg::CookedMeshRecord &mesh = cooked.meshes()[i];
+            if (!cooked.indicesInRange(mesh))
+                return false;
+            sources.push_back(MeshSource{cooked.vertices() + mesh.firstVertex, mesh.vertexCount,
+                                         cooked.indices() + mesh.firstIndex, mesh.indexCount, mesh.material});
+        }
 
-        // walk through each of the mesh's vertices
-        for(unsigned int i = 0; i < mesh->mNumVertices; i++)
+        vector<vector<Texture>> materialTextures(header.materialCount);
+        vector<bool> used = usedMaterials(sources, header.materialCount);
+        for (uint32_t i = 0; i < header.materialCount; i++)
         {
-            Vertex vertex;
-            glm::vec3 vector; // we declare a placeholder vector since assimp_ uses its own vector class that doesn't directly convert to glm's vec3 class so we transfer the data to this placeholder glm::vec3 first.
-            // positions
-            vector.x = mesh->mVertices[i].x;
-            vector.y = mesh->mVertices[i].y;
-            vector.z = mesh->mVertices[i].z;
-            vertex.Position = vector;
-            // normals
-            if (mesh->HasNormals())
-            {
-                vector.x = mesh->mNormals[i].x;
-                vector.y = mesh->mNormals[i].y;
-                vector.z = mesh->mNormals[i].z;
-                vertex.Normal = vector;
-            }
-            // texture coordinates
-            if(mesh->mTextureCoords[0]) // does the mesh contain texture coordinates?
+            if (!used[i])
+                continue;
+            const rg::CookedMaterialRecord &material = cooked.materials()[i];
+            for (uint32_t j = 0; j < material.textureCount; j++)
             {
-                glm::vec2 vec;
-                // a vertex can contain up to 8 different texture coordinates. We thus make the assumption that we won't
-                // use models where a vertex can have multiple texture coordinates so we always take the first set (0).
-                vec.x = mesh->mTextureCoords[0][i].x;
-                vec.y = mesh->mTextureCoords[0][i].y;
-                vertex.TexCoords = vec;
-                // tangent
-                vector.x = mesh->mTangents[i].x;
-                vector.y = mesh->mTangents[i].y;
-                vector.z = mesh->mTangents[i].z;
-                vertex.Tangent = vector;
-                // bitangent
-                vector.x = mesh->mBitangents[i].x;
-                vector.y = mesh->mBitangents[i].y;
-                vector.z = mesh->mBitangents[i].z;
-                vertex.Bitangent = vector;
+                const rg::CookedTextureRecord &texture = cooked.textures()[material.firstTexture + j];
+                materialTextures[i].push_back(loadMaterialTexture(cooked.string(texture.pathOffset, texture.pathLength),
+                                                                  cooked.string(texture.typeOffset, texture.typeLength)));
             }
-            else
-                vertex.TexCoords = glm::vec2(0.0f, 0.0f);
+        }
 
-            vertices.push_back(vertex);
+        for (uint32_t i = 0; i < header.meshCount; i++)
+        {
+            const rg::CookedMeshRecord &mesh = cooked.meshes()[i];
+            rg::MeshOptimizationStats stats;
+            stats.vertexCountBefore = mesh.sourceVertexCount;
+            stats.vertexCountAfter = mesh.vertexCount;
+            stats.acmrBefore = mesh.acmrBefore;
+            stats.acmrAfter = mesh.acmrAfter;
+            rg::reportMeshOptimization(cookedPath + " mesh " + std::to_string(i), stats);
+        }
+        buildMeshes(sources, materialTextures);
+        return true;
+    }
 
+    static vector<bool> usedMaterials(const vector<MeshSource> &sources, size_t materialCount)
+    {
+        vector<bool> used(materialCount, false);
+        for (const MeshSource &source : sources)
+            if (source.material < materialCount)
+                used[source.material] = true;
+        return used;
+    }
 
+    void buildMeshes(const vector<MeshSource> &sources, const vector<vector<Texture>> &materialTextures)
+    {
+        if (mergeMaterials)
+        {
+            mergeMeshesByMaterial(sources, materialTextures);
+            return;
         }
-        // now wak through each of the mesh's faces (a face is a mesh its triangle) and retrieve the corresponding vertex indices.
-        for(unsigned int i = 0; i < mesh->mNumFaces; i++)
+        for (const MeshSource &source : sources)
         {
-            aiFace face = mesh->mFaces[i];
-            // retrieve all indices of the face and store them in the indices vector
-            for(unsigned int j = 0; j < face.mNumIndices; j++)
-                indices.push_back(face.mIndices[j]);
+            vector<Texture> textures;
+            if (source.material < materialTextures.size())
+                textures = materialTextures[source.material];
+            meshes.push_back(Mesh(source.vertices, source.vertexCount, source.indices, source.indexCount, textures, vertexFormat));
         }
-        // process materials
-        aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
-        // we assume a convention for sampler names in the shaders. Each diffuse texture should be named
-        // as 'texture_diffuseN' where N is a sequential number ranging from 1 to MAX_SAMPLER_NUMBER.
-        // Same applies to other texture as the following list summarizes:
-        // diffuse: texture_diffuseN
-        // specular: texture_specularN
-        // normal: texture_normalN
-        aiColor3D color(0.0f, 0.0f, 0.0f);
-        material->Get(AI_MATKEY_COLOR_AMBIENT, color);
-
-
-        // 1. diffuse maps
-        vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
-        textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
-        // 2. specular maps
-        vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
-        textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
-        // 3. normal maps
-        std::vector<Texture> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal");
-        textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
-        // 4. height maps
-        std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
-        textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
-
-
-
-        // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures);
     }
 
-    // checks all material textures of a given type and loads the textures if they're not loaded yet.
-    // the required info is returned as a Texture struct.
-    vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName)
+    // puts all meshes into one vertex and one index buffer, the meshes sharing a material are concatenated into a
+    // single range drawn with a base vertex offset, so the model costs one draw and one set of texture binds per material.
+    void mergeMeshesByMaterial(const vector<MeshSource> &sources, const vector<vector<Texture>> &materialTextures)
     {
-        vector<Texture> textures;
-        for(unsigned int i = 0; i < mat->GetTextureCount(type); i++)
+        std::map<unsigned int, vector<const MeshSource*>> groups;
+        for (const MeshSource &source : sources)
+            groups[source.material].push_back(&source);
+
+        // indices are relative to the range, so 16 bit indices work as long as every range has at most 65536 vertices
+        size_t largestRange = 0;
+        for (const auto &group : groups)
         {
-            aiString str;
-            mat->GetTexture(type, i, &str);
-            // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-            bool skip = false;
-            for(unsigned int j = 0; j < textures_loaded.size(); j++)
+            size_t vertexCount = 0;
+            for (const MeshSource *source : group.second)
+                vertexCount += source->vertexCount;
+            largestRange = std::max(largestRange, vertexCount);
+        }
+        GLenum indexType = Mesh::indexTypeFor(largestRange);
+
+        vector<unsigned char> vertexData, indexData;
+        vector<Vertex> rangeVertices;
+        vector<unsigned int> rangeIndices;
+        size_t firstVertex = 0, firstIndex = 0;
+        for (const auto &group : groups)
+        {
+            rangeVertices.clear();
+            rangeIndices.clear();
+            for (const MeshSource *source : group.second)
             {
-                if(std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
-                {
-                    textures.push_back(textures_loaded[j]);
-                    skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-                    break;
-                }
-            }
-            if(!skip)
-            {   // if texture hasn't been loaded already, load it
-                Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
-                texture.type = typeName;
-                texture.path = str.C_Str();
-                textures.push_back(texture);
-                textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
+                unsigned int offset = (unsigned int) rangeVertices.size();
+                rangeVertices.insert(rangeVertices.end(), source->vertices, source->vertices + source->vertexCount);
+                for (size_t i = 0; i < source->indexCount; i++)
+                    rangeIndices.push_back(source->indices[i] + offset);
             }
+            glm::vec3 boundsMin, boundsMax;
+            Mesh::computeBounds(rangeVertices.data(), rangeVertices.size(), boundsMin, boundsMax);
+            float boundsRadius = Mesh::computeBoundsRadius(rangeVertices.data(), rangeVertices.size(), boundsMin, boundsMax);
+            Mesh::appendVertexData(vertexData, rangeVertices.data(), rangeVertices.size(), vertexFormat, boundsMin, boundsMax);
+            Mesh::appendIndexData(indexData, rangeIndices.data(), rangeIndices.size(), indexType);
+
+            vector<Texture> textures;
+            if (group.first < materialTextures.size())
+                textures = materialTextures[group.first];
+            meshes.push_back(Mesh(0, indexType, (unsigned int) firstIndex, (unsigned int) rangeIndices.size(), (int) firstVertex,
+                                  boundsMin, boundsMax, boundsRadius, textures, vertexFormat));
+            firstVertex += rangeVertices.size();
+            firstIndex += rangeIndices.size();
         }
-        return textures;
+
+        glGenVertexArrays(1, &mergedVAO);
+        glGenBuffers(1, &mergedVBO);
+        glGenBuffers(1, &mergedEBO);
+        rg::GLState::instance().bindVertexArray(mergedVAO);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mergedEBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexData.size(), indexData.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, mergedVBO);
+        glBufferData(GL_ARRAY_BUFFER, vertexData.size(), vertexData.data(), GL_STATIC_DRAW);
+        Mesh::setupVertexAttributes(vertexFormat);
+        rg::GLState::instance().bindVertexArray(0);
+        for (Mesh &mesh : meshes)
+            mesh.VAO = mergedVAO;
+    }
+
+    // textures are shared between all models through the process wide texture registry, which only decodes
+    // and uploads an image whose contents aren't resident yet. the required info is returned as a Texture struct.
+    Texture loadMaterialTexture(string const &path, string const &typeName)
+    {
+        Texture texture;
+        texture.id = rg::TextureRegistry::instance().acquire(this->directory + '/' + path, "model", [this, &path]()
+        {
+            return TextureFromFile(path.c_str(), this->directory, gammaCorrection);
+        });
+        texture.type = typeName;
+        texture.path = path;
+        textures_loaded.push_back(texture);  // every reference this model holds, released again in the destructor
+        return texture;
     }
 };
 
 
+// uploads the block compressed version of an image written by the asset cooker, with its precomputed mip chain.
+// returns 0 when there is no up to date .ktx file or the GL can't sample its format.
+unsigned int CompressedTextureFromFile(const string &filename)
+{
+    uint32_t format;
+    if (!rg::isCompressedTextureFresh(filename, format))
+        return 0;
+
+    rg::MappedFile file;
+    rg::KtxView ktx;
+    if (!file.open(rg::compressedTexturePath(filename)) || !ktx.open(file) || !rg::isCompressedFormatSupported(ktx.header().glInternalFormat))
+        return 0;
+
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+    rg::GLState::instance().bindTexture(GL_TEXTURE_2D, textureID);
+    const vector<rg::KtxView::Level> &levels = ktx.levels();
+    for (unsigned int level = 0; level < levels.size(); level++)
+        glCompressedTexImage2D(GL_TEXTURE_2D, level, ktx.header().glInternalFormat, levels[level].width, levels[level].height,
+                               0, levels[level].size, levels[level].data);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint) levels.size() - 1);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    return textureID;
+}
+
+// the texture name is created right away, the image itself is decoded on the decode pool and
+// uploaded once the pool hands it back on the GL thread (see rg::ImageDecodePool::finish).
+// a cooked block compressed version of the image is preferred when there is one.
 unsigned int TextureFromFile(const char *path, const string &directory, bool gamma)
 {
     string filename = string(path);
     filename = directory + '/' + filename;
 
+    if (unsigned int compressedID = CompressedTextureFromFile(filename))
+        return compressedID;
+
     unsigned int textureID;
     glGenTextures(1, &textureID);
 
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data)
-    {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    }
-    else
+    rg::ImageDecodePool::instance().submit(filename, true, [textureID](const rg::DecodedImage &image)
     {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
-    }
+        if (image.data)
+        {
+            GLenum format;
+            if (image.components == 1)
+                format = GL_RED;
+            else if (image.components == 3)
+                format = GL_RGB;
+            else if (image.components == 4)
+                format = GL_RGBA;
+
+            rg::GLState::instance().bindTexture(GL_TEXTURE_2D, textureID);
+            glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, image.data);
+            glGenerateMipmap(GL_TEXTURE_2D);
+
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        }
+        else
+        {
+            std::cout << "Texture failed to load at path: " << image.path << std::endl;
+        }
+    });
 
     return textureID;
 }
@@ -3,20 +3,75 @@
 
 #include <glad/glad.h>
 #include <glm/glm.hpp>
+#include <rg/CpuProfiler.h>
 
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
 #include <common.h>
+#include <rg/GLState.h>
+#include <rg/UniformBlocks.h>
+
+// glUniform* for every type a UniformHandle can hold, count > 1 uploads consecutive array elements
+inline void uploadUniform(GLint location, const int *values, GLsizei count) { glUniform1iv(location, count, values); }
+inline void uploadUniform(GLint location, const float *values, GLsizei count) { glUniform1fv(location, count, values); }
+inline void uploadUniform(GLint location, const glm::vec2 *values, GLsizei count) { glUniform2fv(location, count, &values[0][0]); }
+inline void uploadUniform(GLint location, const glm::vec3 *values, GLsizei count) { glUniform3fv(location, count, &values[0][0]); }
+inline void uploadUniform(GLint location, const glm::vec4 *values, GLsizei count) { glUniform4fv(location, count, &values[0][0]); }
+inline void uploadUniform(GLint location, const glm::mat3 *values, GLsizei count) { glUniformMatrix3fv(location, count, GL_FALSE, &values[0][0][0]); }
+inline void uploadUniform(GLint location, const glm::mat4 *values, GLsizei count) { glUniformMatrix4fv(location, count, GL_FALSE, &values[0][0][0]); }
+
+// whether a GLSL uniform of the given type can be set through a UniformHandle<T>
+inline bool isUniformTypeCompatible(GLenum type, const int*) { return type == GL_INT || type == GL_BOOL || type == GL_SAMPLER_2D
+                                                                  || type == GL_SAMPLER_CUBE || type == GL_SAMPLER_2D_ARRAY
+                                                                  || type == GL_SAMPLER_2D_SHADOW || type == GL_SAMPLER_BUFFER
+                                                                  || type == GL_INT_SAMPLER_BUFFER || type == GL_UNSIGNED_INT_SAMPLER_BUFFER; }
+inline bool isUniformTypeCompatible(GLenum type, const float*) { return type == GL_FLOAT; }
+inline bool isUniformTypeCompatible(GLenum type, const glm::vec2*) { return type == GL_FLOAT_VEC2; }
+inline bool isUniformTypeCompatible(GLenum type, const glm::vec3*) { return type == GL_FLOAT_VEC3; }
+inline bool isUniformTypeCompatible(GLenum type, const glm::vec4*) { return type == GL_FLOAT_VEC4; }
+inline bool isUniformTypeCompatible(GLenum type, const glm::mat3*) { return type == GL_FLOAT_MAT3; }
+inline bool isUniformTypeCompatible(GLenum type, const glm::mat4*) { return type == GL_FLOAT_MAT4; }
+
+// a uniform location resolved once (see Shader::uniform), setting it is a single glUniform call without any
+// string work or driver lookup. like the string setters it applies to the program that is currently in use.
+// uniforms the program doesn't use resolve to -1, which GL silently ignores.
+template<typename T>
+struct UniformHandle
+{
+    GLint location = -1;
+
+    void set(const T &value) const
+    {
+        uploadUniform(location, &value, 1);
+    }
+    // sets count elements of an array uniform, starting at the element the handle was resolved for
+    void set(const T *values, GLsizei count) const
+    {
+        uploadUniform(location, values, count);
+    }
+    bool valid() const
+    {
+        return location >= 0;
+    }
+};
+
 class Shader
 {
 public:
     unsigned int ID;
     // constructor generates the shader on the fly
+    // every entry of defines is inserted as "#define <entry>" right after the #version line of each stage,
+    // which is how shader variants (e.g. PACKED_VERTICES) are built from the same source files.
     // ------------------------------------------------------------------------
-    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr)
+    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr,
+           const std::vector<std::string> &defines = std::vector<std::string>())
     {
+        RG_PROFILE_ZONE("Compile shader");
         std::string vertexPathString(vertexPath);
         std::string fragmentPathString(fragmentPath);
 
@@ -64,6 +119,9 @@ public:
         {
             std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
         }
+        vertexCode = insertDefines(vertexCode, defines);
+        fragmentCode = insertDefines(fragmentCode, defines);
+        geometryCode = insertDefines(geometryCode, defines);
         const char* vShaderCode = vertexCode.c_str();
         const char * fShaderCode = fragmentCode.c_str();
         // 2. compile shaders
@@ -102,73 +160,172 @@ public:
         if(geometryPath != nullptr)
             glDeleteShader(geometry);
 
+        introspectUniforms();
+        bindUniformBlocks();
+    }
+    // the location of an active uniform, -1 if the program doesn't use it. O(1), no driver call.
+    // ------------------------------------------------------------------------
+    GLint uniformLocation(const std::string &name) const
+    {
+        auto it = uniforms.find(name);
+        return it == uniforms.end() ? -1 : it->second.location;
+    }
+    // resolves a typed handle for the hot loop, see UniformHandle.
+    // ------------------------------------------------------------------------
+    template<typename T>
+    UniformHandle<T> uniform(const std::string &name) const
+    {
+        UniformHandle<T> handle;
+        auto it = uniforms.find(name);
+        if (it == uniforms.end())
+            return handle;
+        if (!isUniformTypeCompatible(it->second.type, (const T*)nullptr))
+            std::cout << "WARNING::SHADER:: uniform " << name << " has GL type 0x" << std::hex << it->second.type << std::dec
+                      << ", which doesn't match its handle" << std::endl;
+        handle.location = it->second.location;
+        return handle;
     }
     // activate the shader
     // ------------------------------------------------------------------------
     void use() 
     { 
-        glUseProgram(ID); 
+        rg::GLState::instance().useProgram(ID);
     }
     // utility uniform functions
     // ------------------------------------------------------------------------
     void setBool(const std::string &name, bool value) const
     {         
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value); 
+        glUniform1i(uniformLocation(name), (int)value); 
     }
     // ------------------------------------------------------------------------
     void setInt(const std::string &name, int value) const
     { 
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value); 
+        glUniform1i(uniformLocation(name), value); 
     }
     // ------------------------------------------------------------------------
     void setFloat(const std::string &name, float value) const
     { 
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
+        glUniform1f(uniformLocation(name), value); 
     }
     // ------------------------------------------------------------------------
     void setVec2(const std::string &name, const glm::vec2 &value) const
     { 
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform2fv(uniformLocation(name), 1, &value[0]); 
     }
     void setVec2(const std::string &name, float x, float y) const
     { 
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y); 
+        glUniform2f(uniformLocation(name), x, y); 
     }
     // ------------------------------------------------------------------------
     void setVec3(const std::string &name, const glm::vec3 &value) const
     { 
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform3fv(uniformLocation(name), 1, &value[0]); 
     }
     void setVec3(const std::string &name, float x, float y, float z) const
     { 
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z); 
+        glUniform3f(uniformLocation(name), x, y, z); 
     }
     // ------------------------------------------------------------------------
     void setVec4(const std::string &name, const glm::vec4 &value) const
     { 
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform4fv(uniformLocation(name), 1, &value[0]); 
     }
     void setVec4(const std::string &name, float x, float y, float z, float w) 
     { 
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w); 
+        glUniform4f(uniformLocation(name), x, y, z, w); 
     }
     // ------------------------------------------------------------------------
     void setMat2(const std::string &name, const glm::mat2 &mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix2fv(uniformLocation(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat3(const std::string &name, const glm::mat3 &mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix3fv(uniformLocation(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat4(const std::string &name, const glm::mat4 &mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix4fv(uniformLocation(name), 1, GL_FALSE, &mat[0][0]);
     }
 
 private:
+    struct UniformInfo
+    {
+        GLint location;
+        GLenum type;
+    };
+    // every active uniform by name, array elements are listed as name[i] and the array itself under both
+    // name and name[0], so the names that worked with glGetUniformLocation keep working.
+    std::unordered_map<std::string, UniformInfo> uniforms;
+
+    void introspectUniforms()
+    {
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::vector<GLchar> nameBuffer(std::max(maxLength, 1));
+        for (GLint i = 0; i < count; i++)
+        {
+            GLint size = 0;
+            GLenum type = 0;
+            GLsizei length = 0;
+            glGetActiveUniform(ID, (GLuint)i, (GLsizei)nameBuffer.size(), &length, &size, &type, nameBuffer.data());
+            std::string name(nameBuffer.data(), length);
+            GLint location = glGetUniformLocation(ID, name.c_str());
+            // members of uniform blocks have no location
+            if (location < 0)
+                continue;
+            uniforms[name] = UniformInfo{location, type};
+            size_t bracket = name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0 ? name.size() - 3 : std::string::npos;
+            if (bracket == std::string::npos)
+                continue;
+            std::string base = name.substr(0, bracket);
+            uniforms[base] = UniformInfo{location, type};
+            for (GLint element = 1; element < size; element++)
+            {
+                std::string elementName = base + "[" + std::to_string(element) + "]";
+                uniforms[elementName] = UniformInfo{glGetUniformLocation(ID, elementName.c_str()), type};
+            }
+        }
+    }
+
+    // binds the shared per-frame blocks (see rg/UniformBlocks.h) to their fixed binding points
+    void bindUniformBlocks()
+    {
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxLength);
+        std::vector<GLchar> nameBuffer(std::max(maxLength, 1));
+        for (GLint i = 0; i < count; i++)
+        {
+            glGetActiveUniformBlockName(ID, (GLuint)i, (GLsizei)nameBuffer.size(), nullptr, nameBuffer.data());
+            GLint binding = rg::uniformBlockBinding(nameBuffer.data());
+            if (binding >= 0)
+                glUniformBlockBinding(ID, (GLuint)i, (GLuint)binding);
+            else
+                std::cout << "WARNING::SHADER:: uniform block " << nameBuffer.data() << " has no binding point" << std::endl;
+        }
+    }
+
+    static std::string insertDefines(const std::string &code, const std::vector<std::string> &defines)
+    {
+        if (defines.empty() || code.empty())
+            return code;
+        std::string block;
+        for (const std::string &define : defines)
+            block += "#define " + define + "\n";
+        // the #version directive has to stay the first statement
+        size_t versionLine = code.find("#version");
+        size_t insertAt = versionLine == std::string::npos ? 0 : code.find('\n', versionLine);
+        if (insertAt == std::string::npos)
+            return code + "\n" + block;
+        if (versionLine != std::string::npos)
+            insertAt += 1;
+        return code.substr(0, insertAt) + block + code.substr(insertAt);
+    }
+
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
     void checkCompileErrors(GLuint shader, std::string type)
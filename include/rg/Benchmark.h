@@ -0,0 +1,341 @@
+#ifndef PROJECT_BASE_BENCHMARK_H
+#define PROJECT_BASE_BENCHMARK_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <rg/CommandLine.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// A repeatable frame time measurement. The camera follows a path file instead of the input, the clock advances
+// by a fixed timestep so every run renders the same frames, and the program state file is neither read nor
+// written. After the path ends the CPU and GPU time of every frame is written as CSV, and a summary with the
+// percentiles as JSON:
+//
+//   project_base --benchmark resources/benchmark/flythrough.path [--report out] [--headless]
+//                [--baseline last.json] [--threshold 10]
+//
+// With a baseline, a p50 or p95 that got worse by more than threshold percent fails the run. --record path
+// writes the camera of a normal interactive session as a path file, to replay it later.
+namespace rg {
+
+    struct BenchmarkOptions {
+        bool enabled = false;
+        std::string path;                   // the camera path to replay
+        std::string report = "benchmark";   // the report goes to report.csv and report.json
+        std::string baseline;               // an earlier report.json to compare against, if set
+        float threshold = 10.0f;            // percent a baseline percentile may get worse
+        float timestep = 1.0f / 60.0f;      // simulated seconds per frame
+        unsigned int warmup = 30;           // frames at the start of the path that aren't measured
+        std::string record;                 // writes the interactive camera here, if set
+    };
+
+    // parses argv[i], and its value at argv[i + 1] which then advances i
+    inline OptionResult parseBenchmarkOption(int argc, char **argv, int &i, BenchmarkOptions &options) {
+        if (std::strcmp(argv[i], "--benchmark") == 0 && i + 1 < argc) {
+            options.enabled = true;
+            options.path = argv[++i];
+        } else if (std::strcmp(argv[i], "--report") == 0 && i + 1 < argc) {
+            options.report = argv[++i];
+        } else if (std::strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) {
+            options.baseline = argv[++i];
+        } else if (std::strcmp(argv[i], "--threshold") == 0 && i + 1 < argc) {
+            char *end = nullptr;
+            options.threshold = std::strtof(argv[++i], &end);
+            if (*end != '\0' || options.threshold < 0.0f) {
+                std::cout << "Invalid threshold: " << argv[i] << std::endl;
+                return OPTION_INVALID;
+            }
+        } else if (std::strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            options.record = argv[++i];
+        } else {
+            return OPTION_UNKNOWN;
+        }
+        return OPTION_PARSED;
+    }
+
+    struct CameraKey {
+        float time;
+        glm::vec3 position;
+        float yaw, pitch;       // degrees, as in Camera
+    };
+
+    // camera keyframes, one per line as "time x y z yaw pitch", # starts a comment. positions and angles
+    // follow a Catmull-Rom spline through the keys, so a handful of them make a smooth flight.
+    class CameraPath {
+    public:
+        // false and a message when the file can't be read, is malformed or has fewer than two keys
+        bool load(const std::string &path) {
+            std::ifstream in(path);
+            if (!in) {
+                std::cout << "Failed to open camera path " << path << std::endl;
+                return false;
+            }
+            m_Keys.clear();
+            std::string line;
+            for (unsigned int number = 1; std::getline(in, line); ++number) {
+                line = line.substr(0, line.find('#'));
+                if (line.find_first_not_of(" \t\r") == std::string::npos)
+                    continue;
+                std::istringstream fields(line);
+                CameraKey key;
+                if (!(fields >> key.time >> key.position.x >> key.position.y >> key.position.z >> key.yaw >> key.pitch)
+                    || (!m_Keys.empty() && key.time <= m_Keys.back().time)) {
+                    std::cout << path << ":" << number << ": expected \"time x y z yaw pitch\" with increasing times" << std::endl;
+                    return false;
+                }
+                m_Keys.push_back(key);
+            }
+            if (m_Keys.size() < 2) {
+                std::cout << path << ": a camera path needs at least two keys" << std::endl;
+                return false;
+            }
+            return true;
+        }
+
+        bool save(const std::string &path) const {
+            std::ofstream out(path);
+            out << "# time x y z yaw pitch\n";
+            for (const CameraKey &key : m_Keys)
+                out << key.time << ' ' << key.position.x << ' ' << key.position.y << ' ' << key.position.z << ' '
+                    << key.yaw << ' ' << key.pitch << '\n';
+            return (bool) out;
+        }
+
+        void add(const CameraKey &key) {
+            m_Keys.push_back(key);
+        }
+
+        // the camera at time, held at the first and the last key outside the path
+        CameraKey sample(float time) const {
+            if (time <= m_Keys.front().time)
+                return m_Keys.front();
+            if (time >= m_Keys.back().time)
+                return m_Keys.back();
+            size_t segment = 0;
+            while (m_Keys[segment + 1].time < time)
+                segment++;
+            const CameraKey &k0 = m_Keys[segment == 0 ? 0 : segment - 1];
+            const CameraKey &k1 = m_Keys[segment];
+            const CameraKey &k2 = m_Keys[segment + 1];
+            const CameraKey &k3 = m_Keys[std::min(segment + 2, m_Keys.size() - 1)];
+            float u = (time - k1.time) / (k2.time - k1.time);
+
+            CameraKey key;
+            key.time = time;
+            key.position = catmullRom(k0.position, k1.position, k2.position, k3.position, u);
+            glm::vec3 angles = catmullRom(glm::vec3(k0.yaw, k0.pitch, 0.0f), glm::vec3(k1.yaw, k1.pitch, 0.0f),
+                                          glm::vec3(k2.yaw, k2.pitch, 0.0f), glm::vec3(k3.yaw, k3.pitch, 0.0f), u);
+            key.yaw = angles.x;
+            key.pitch = angles.y;
+            return key;
+        }
+
+        float duration() const { return m_Keys.empty() ? 0.0f : m_Keys.back().time; }
+        bool empty() const { return m_Keys.empty(); }
+        const CameraKey& back() const { return m_Keys.back(); }
+
+    private:
+        std::vector<CameraKey> m_Keys;
+
+        static glm::vec3 catmullRom(const glm::vec3 &p0, const glm::vec3 &p1, const glm::vec3 &p2, const glm::vec3 &p3, float u) {
+            float u2 = u * u, u3 = u2 * u;
+            return 0.5f * (2.0f * p1 + (p2 - p0) * u + (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * u2
+                           + (3.0f * p1 - p0 - 3.0f * p2 + p3) * u3);
+        }
+    };
+
+    struct FrameTimeSummary {
+        float mean = 0.0f, p50 = 0.0f, p95 = 0.0f, p99 = 0.0f, max = 0.0f;
+    };
+
+    // the CPU time of every frame from beginFrame to endFrame, and its GPU time between two timestamp queries.
+    // the queries are read back FRAME_LATENCY frames later, when the GPU is long done with them, so measuring
+    // doesn't stall the pipeline.
+    class FrameTimeRecorder {
+    public:
+        static const unsigned int FRAME_LATENCY = 4;
+
+        FrameTimeRecorder() {
+            glGenQueries(FRAME_LATENCY * 2, m_Queries);
+        }
+
+        ~FrameTimeRecorder() {
+            glDeleteQueries(FRAME_LATENCY * 2, m_Queries);
+        }
+
+        FrameTimeRecorder(const FrameTimeRecorder&) = delete;
+        FrameTimeRecorder& operator=(const FrameTimeRecorder&) = delete;
+
+        void beginFrame() {
+            unsigned int slot = m_CpuTimes.size() % FRAME_LATENCY;
+            if (m_CpuTimes.size() >= FRAME_LATENCY)
+                readBack(slot);
+            glQueryCounter(m_Queries[slot * 2], GL_TIMESTAMP);
+            m_FrameBegin = std::chrono::steady_clock::now();
+        }
+
+        void endFrame() {
+            unsigned int slot = m_CpuTimes.size() % FRAME_LATENCY;
+            glQueryCounter(m_Queries[slot * 2 + 1], GL_TIMESTAMP);
+            m_CpuTimes.push_back(std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - m_FrameBegin).count());
+        }
+
+        // reads the queries still in flight, waiting for the GPU
+        void finish() {
+            for (size_t frame = m_GpuTimes.size(); frame < m_CpuTimes.size(); ++frame)
+                readBack(frame % FRAME_LATENCY);
+        }
+
+        size_t frames() const { return m_GpuTimes.size(); }
+        const std::vector<float>& cpuTimes() const { return m_CpuTimes; }
+        const std::vector<float>& gpuTimes() const { return m_GpuTimes; }
+
+    private:
+        unsigned int m_Queries[FRAME_LATENCY * 2];
+        std::chrono::steady_clock::time_point m_FrameBegin;
+        std::vector<float> m_CpuTimes, m_GpuTimes;
+
+        void readBack(unsigned int slot) {
+            GLuint64 begin = 0, end = 0;
+            glGetQueryObjectui64v(m_Queries[slot * 2], GL_QUERY_RESULT, &begin);
+            glGetQueryObjectui64v(m_Queries[slot * 2 + 1], GL_QUERY_RESULT, &end);
+            m_GpuTimes.push_back((end - begin) / 1.0e6f);
+        }
+    };
+
+    // nearest rank percentiles
+    inline FrameTimeSummary summarizeFrameTimes(std::vector<float> times) {
+        FrameTimeSummary summary;
+        if (times.empty())
+            return summary;
+        std::sort(times.begin(), times.end());
+        auto percentile = [&](float p) {
+            size_t rank = (size_t) std::ceil(p / 100.0f * times.size());
+            return times[std::min(std::max<size_t>(rank, 1), times.size()) - 1];
+        };
+        for (float time : times)
+            summary.mean += time;
+        summary.mean /= times.size();
+        summary.p50 = percentile(50.0f);
+        summary.p95 = percentile(95.0f);
+        summary.p99 = percentile(99.0f);
+        summary.max = times.back();
+        return summary;
+    }
+
+    struct BenchmarkReport {
+        unsigned int frames = 0;
+        float timestep = 0.0f;
+        FrameTimeSummary cpu, gpu;
+        // frames that took more than twice the median, on the CPU or the GPU
+        unsigned int hitches = 0;
+    };
+
+    inline BenchmarkReport makeBenchmarkReport(const FrameTimeRecorder &recorder, float timestep) {
+        BenchmarkReport report;
+        report.frames = (unsigned int) recorder.frames();
+        report.timestep = timestep;
+        report.cpu = summarizeFrameTimes(recorder.cpuTimes());
+        report.gpu = summarizeFrameTimes(recorder.gpuTimes());
+        for (size_t frame = 0; frame < recorder.frames(); ++frame)
+            if (recorder.cpuTimes()[frame] > 2.0f * report.cpu.p50 || recorder.gpuTimes()[frame] > 2.0f * report.gpu.p50)
+                report.hitches++;
+        return report;
+    }
+
+    // prefix.csv with a line per frame and prefix.json with the summary, false when either can't be written
+    inline bool writeBenchmarkReport(const std::string &prefix, const FrameTimeRecorder &recorder, const BenchmarkReport &report) {
+        std::ofstream csv(prefix + ".csv");
+        csv << "frame,cpu_ms,gpu_ms\n" << std::fixed << std::setprecision(4);
+        for (size_t frame = 0; frame < recorder.frames(); ++frame)
+            csv << frame << ',' << recorder.cpuTimes()[frame] << ',' << recorder.gpuTimes()[frame] << '\n';
+
+        std::ofstream json(prefix + ".json");
+        auto summary = [&](const char *name, const FrameTimeSummary &times) {
+            json << "  \"" << name << "\": {\"mean\": " << times.mean << ", \"p50\": " << times.p50 << ", \"p95\": "
+                 << times.p95 << ", \"p99\": " << times.p99 << ", \"max\": " << times.max << "},\n";
+        };
+        json << "{\n" << std::fixed << std::setprecision(4)
+             << "  \"frames\": " << report.frames << ",\n"
+             << "  \"timestep\": " << report.timestep << ",\n";
+        summary("cpu_ms", report.cpu);
+        summary("gpu_ms", report.gpu);
+        json << "  \"hitches\": " << report.hitches << "\n}\n";
+        return csv.good() && json.good();
+    }
+
+    inline void printBenchmarkReport(const BenchmarkReport &report) {
+        auto line = [](const char *name, const FrameTimeSummary &times) {
+            std::cout << std::fixed << std::setprecision(2) << name << " mean " << times.mean << " p50 " << times.p50
+                      << " p95 " << times.p95 << " p99 " << times.p99 << " max " << times.max << " ms" << std::endl;
+        };
+        std::cout << report.frames << " frames, " << report.hitches << " hitches" << std::endl;
+        line("CPU", report.cpu);
+        line("GPU", report.gpu);
+    }
+
+    // the number after "key": inside the "section" object of a report written by writeBenchmarkReport
+    inline bool readReportValue(const std::string &json, const char *section, const char *key, float &value) {
+        size_t begin = json.find(std::string("\"") + section + "\"");
+        if (begin == std::string::npos)
+            return false;
+        size_t end = json.find('}', begin);
+        size_t found = json.find(std::string("\"") + key + "\":", begin);
+        if (found == std::string::npos || found > end)
+            return false;
+        value = std::strtof(json.c_str() + found + std::strlen(key) + 3, nullptr);
+        return true;
+    }
+
+    // false and a message per percentile that got worse than the baseline by more than threshold percent, or
+    // when the baseline can't be read
+    inline bool compareBenchmarkBaseline(const std::string &path, const BenchmarkReport &report, float threshold) {
+        std::ifstream in(path);
+        if (!in) {
+            std::cout << "Failed to open baseline " << path << std::endl;
+            return false;
+        }
+        std::stringstream text;
+        text << in.rdbuf();
+        const std::string json = text.str();
+
+        struct Check {
+            const char *section, *key;
+            float current;
+        } checks[] = {
+                {"cpu_ms", "p50", report.cpu.p50}, {"cpu_ms", "p95", report.cpu.p95},
+                {"gpu_ms", "p50", report.gpu.p50}, {"gpu_ms", "p95", report.gpu.p95},
+        };
+        bool passed = true;
+        for (const Check &check : checks) {
+            float baseline;
+            if (!readReportValue(json, check.section, check.key, baseline)) {
+                std::cout << "Baseline " << path << " has no " << check.section << " " << check.key << std::endl;
+                return false;
+            }
+            // differences below a twentieth of a millisecond are timer noise, not a regression
+            float limit = baseline * (1.0f + threshold / 100.0f) + 0.05f;
+            if (check.current > limit) {
+                std::cout << std::fixed << std::setprecision(2) << check.section << " " << check.key << " regressed: "
+                          << check.current << " ms against " << baseline << " ms in the baseline" << std::endl;
+                passed = false;
+            }
+        }
+        return passed;
+    }
+
+};
+
+#endif //PROJECT_BASE_BENCHMARK_H
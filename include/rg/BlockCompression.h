@@ -0,0 +1,471 @@
+#ifndef PROJECT_BASE_BLOCKCOMPRESSION_H
+#define PROJECT_BASE_BLOCKCOMPRESSION_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+// CPU block compression encoders used by the asset cooker.
+// Every format works on 4x4 texel blocks, partial blocks at the image border repeat the edge texels.
+//   BC1 - RGB, 8 bytes per block (4 bits per texel)
+//   BC3 - RGBA, BC4 alpha block followed by a BC1 color block, 16 bytes per block
+//   BC5 - RG, two BC4 blocks, 16 bytes per block (normal maps)
+//   BC7 - RGBA, 16 bytes per block, only mode 6 (one subset, 7.7.7.7 endpoints with p-bits, 4 bit indices)
+namespace rg {
+
+    enum class BlockFormat {
+        BC1,
+        BC3,
+        BC5,
+        BC7
+    };
+
+    // GL internal format enums, kept as plain numbers so the cooker doesn't need a GL header.
+    inline uint32_t blockFormatGLInternalFormat(BlockFormat format) {
+        switch (format) {
+            case BlockFormat::BC1: return 0x83F0; // GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+            case BlockFormat::BC3: return 0x83F3; // GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+            case BlockFormat::BC5: return 0x8DBD; // GL_COMPRESSED_RG_RGTC2
+            case BlockFormat::BC7: return 0x8E8C; // GL_COMPRESSED_RGBA_BPTC_UNORM
+        }
+        return 0;
+    }
+
+    inline uint32_t blockFormatGLBaseFormat(BlockFormat format) {
+        switch (format) {
+            case BlockFormat::BC1: return 0x1907; // GL_RGB
+            case BlockFormat::BC5: return 0x8227; // GL_RG
+            default: return 0x1908;               // GL_RGBA
+        }
+    }
+
+    inline size_t blockFormatBlockSize(BlockFormat format) {
+        return format == BlockFormat::BC1 ? 8 : 16;
+    }
+
+    // 8 bit RGBA image, the encoders and the mip chain builder always work on 4 channels.
+    struct ImageRGBA8 {
+        int width = 0;
+        int height = 0;
+        std::vector<unsigned char> texels;
+
+        const unsigned char* at(int x, int y) const {
+            x = std::min(std::max(x, 0), width - 1);
+            y = std::min(std::max(y, 0), height - 1);
+            return &texels[(size_t(y) * width + x) * 4];
+        }
+    };
+
+    inline ImageRGBA8 imageFromComponents(const unsigned char *data, int width, int height, int components) {
+        ImageRGBA8 image;
+        image.width = width;
+        image.height = height;
+        image.texels.resize(size_t(width) * height * 4);
+        for (size_t i = 0; i < size_t(width) * height; ++i) {
+            const unsigned char *src = data + i * components;
+            unsigned char *dst = &image.texels[i * 4];
+            // 1 and 2 components are gray and gray with alpha
+            dst[0] = src[0];
+            dst[1] = components > 2 ? src[1] : src[0];
+            dst[2] = components > 2 ? src[2] : src[0];
+            dst[3] = components == 2 ? src[1] : components > 3 ? src[3] : 255;
+        }
+        return image;
+    }
+
+    inline bool imageHasAlpha(const ImageRGBA8 &image) {
+        for (size_t i = 3; i < image.texels.size(); i += 4)
+            if (image.texels[i] != 255)
+                return true;
+        return false;
+    }
+
+    // 2x2 box filter, odd sizes repeat the last row/column.
+    inline ImageRGBA8 downsample(const ImageRGBA8 &image) {
+        ImageRGBA8 result;
+        result.width = std::max(1, image.width / 2);
+        result.height = std::max(1, image.height / 2);
+        result.texels.resize(size_t(result.width) * result.height * 4);
+        for (int y = 0; y < result.height; ++y) {
+            for (int x = 0; x < result.width; ++x) {
+                const unsigned char *a = image.at(2 * x, 2 * y);
+                const unsigned char *b = image.at(2 * x + 1, 2 * y);
+                const unsigned char *c = image.at(2 * x, 2 * y + 1);
+                const unsigned char *d = image.at(2 * x + 1, 2 * y + 1);
+                unsigned char *dst = &result.texels[(size_t(y) * result.width + x) * 4];
+                for (int i = 0; i < 4; ++i)
+                    dst[i] = (unsigned char) ((a[i] + b[i] + c[i] + d[i] + 2) / 4);
+            }
+        }
+        return result;
+    }
+
+    // the full chain down to 1x1, level 0 first.
+    inline std::vector<ImageRGBA8> buildMipChain(const ImageRGBA8 &base) {
+        std::vector<ImageRGBA8> levels;
+        levels.push_back(base);
+        while (levels.back().width > 1 || levels.back().height > 1)
+            levels.push_back(downsample(levels.back()));
+        return levels;
+    }
+
+    namespace detail {
+
+        inline int quantize(float value, int maxValue) {
+            return std::min(std::max(int(value * maxValue / 255.0f + 0.5f), 0), maxValue);
+        }
+
+        inline uint16_t packRGB565(const float color[3]) {
+            return uint16_t((quantize(color[0], 31) << 11) | (quantize(color[1], 63) << 5) | quantize(color[2], 31));
+        }
+
+        inline void unpackRGB565(uint16_t packed, float color[3]) {
+            int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+            color[0] = float((r << 3) | (r >> 2));
+            color[1] = float((g << 2) | (g >> 4));
+            color[2] = float((b << 3) | (b >> 2));
+        }
+
+        // principal axis of the block colors (power iteration on the covariance matrix), channels first..first+count
+        inline void principalAxis(const float texels[16][4], int channels, float mean[4], float axis[4]) {
+            for (int c = 0; c < channels; ++c) {
+                mean[c] = 0.0f;
+                for (int i = 0; i < 16; ++i)
+                    mean[c] += texels[i][c];
+                mean[c] /= 16.0f;
+            }
+            float covariance[4][4] = {};
+            for (int i = 0; i < 16; ++i)
+                for (int a = 0; a < channels; ++a)
+                    for (int b = 0; b < channels; ++b)
+                        covariance[a][b] += (texels[i][a] - mean[a]) * (texels[i][b] - mean[b]);
+            for (int c = 0; c < channels; ++c)
+                axis[c] = 1.0f;
+            for (int iteration = 0; iteration < 8; ++iteration) {
+                float next[4] = {};
+                float length = 0.0f;
+                for (int a = 0; a < channels; ++a) {
+                    for (int b = 0; b < channels; ++b)
+                        next[a] += covariance[a][b] * axis[b];
+                    length = std::max(length, std::fabs(next[a]));
+                }
+                if (length < 1e-6f)
+                    break;
+                for (int c = 0; c < channels; ++c)
+                    axis[c] = next[c] / length;
+            }
+        }
+
+        // endpoints at the extremes of the block projected on its principal axis.
+        inline void axisEndpoints(const float texels[16][4], int channels, float e0[4], float e1[4]) {
+            float mean[4], axis[4];
+            principalAxis(texels, channels, mean, axis);
+            float minT = 0.0f, maxT = 0.0f;
+            for (int i = 0; i < 16; ++i) {
+                float t = 0.0f;
+                for (int c = 0; c < channels; ++c)
+                    t += (texels[i][c] - mean[c]) * axis[c];
+                minT = std::min(minT, t);
+                maxT = std::max(maxT, t);
+            }
+            float lengthSquared = 0.0f;
+            for (int c = 0; c < channels; ++c)
+                lengthSquared += axis[c] * axis[c];
+            if (lengthSquared > 0.0f) {
+                minT /= lengthSquared;
+                maxT /= lengthSquared;
+            }
+            for (int c = 0; c < channels; ++c) {
+                e0[c] = std::min(std::max(mean[c] + axis[c] * maxT, 0.0f), 255.0f);
+                e1[c] = std::min(std::max(mean[c] + axis[c] * minT, 0.0f), 255.0f);
+            }
+        }
+
+        // picks the closest palette entry for every texel, returns the total squared error.
+        inline float selectIndices(const float texels[16][4], int channels, const float palette[][4], int paletteSize, int indices[16]) {
+            float total = 0.0f;
+            for (int i = 0; i < 16; ++i) {
+                float best = 1e30f;
+                for (int p = 0; p < paletteSize; ++p) {
+                    float error = 0.0f;
+                    for (int c = 0; c < channels; ++c) {
+                        float d = texels[i][c] - palette[p][c];
+                        error += d * d;
+                    }
+                    if (error < best) {
+                        best = error;
+                        indices[i] = p;
+                    }
+                }
+                total += best;
+            }
+            return total;
+        }
+
+        // least squares endpoints for fixed indices, weights[i] is how much of e1 texel i uses.
+        inline bool refineEndpoints(const float texels[16][4], int channels, const float weights[16], float e0[4], float e1[4]) {
+            float aa = 0.0f, bb = 0.0f, ab = 0.0f;
+            float ax[4] = {}, bx[4] = {};
+            for (int i = 0; i < 16; ++i) {
+                float b = weights[i], a = 1.0f - b;
+                aa += a * a;
+                bb += b * b;
+                ab += a * b;
+                for (int c = 0; c < channels; ++c) {
+                    ax[c] += a * texels[i][c];
+                    bx[c] += b * texels[i][c];
+                }
+            }
+            float det = aa * bb - ab * ab;
+            if (std::fabs(det) < 1e-6f)
+                return false;
+            for (int c = 0; c < channels; ++c) {
+                e0[c] = std::min(std::max((ax[c] * bb - bx[c] * ab) / det, 0.0f), 255.0f);
+                e1[c] = std::min(std::max((bx[c] * aa - ax[c] * ab) / det, 0.0f), 255.0f);
+            }
+            return true;
+        }
+
+        inline void fetchBlock(const ImageRGBA8 &image, int blockX, int blockY, float texels[16][4]) {
+            for (int y = 0; y < 4; ++y)
+                for (int x = 0; x < 4; ++x) {
+                    const unsigned char *texel = image.at(blockX * 4 + x, blockY * 4 + y);
+                    for (int c = 0; c < 4; ++c)
+                        texels[y * 4 + x][c] = texel[c];
+                }
+        }
+
+        inline float encodeBC1Endpoints(const float texels[16][4], uint16_t c0, uint16_t c1, int indices[16]) {
+            float palette[4][4] = {};
+            unpackRGB565(c0, palette[0]);
+            unpackRGB565(c1, palette[1]);
+            for (int c = 0; c < 3; ++c) {
+                palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+                palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+            }
+            return selectIndices(texels, 3, palette, c0 == c1 ? 1 : 4, indices);
+        }
+
+        inline void encodeBC1(const float texels[16][4], unsigned char out[8]) {
+            static const float weights[4] = {0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f};
+            float e0[4], e1[4];
+            axisEndpoints(texels, 3, e0, e1);
+            uint16_t c0 = packRGB565(e0), c1 = packRGB565(e1);
+            int indices[16];
+            float error = encodeBC1Endpoints(texels, c0, c1, indices);
+
+            // one least squares pass on the chosen indices, kept only if it helps
+            float w[16];
+            for (int i = 0; i < 16; ++i)
+                w[i] = weights[indices[i]];
+            if (c0 != c1 && refineEndpoints(texels, 3, w, e0, e1)) {
+                uint16_t r0 = packRGB565(e0), r1 = packRGB565(e1);
+                int refined[16];
+                float refinedError = encodeBC1Endpoints(texels, r0, r1, refined);
+                if (refinedError < error) {
+                    c0 = r0;
+                    c1 = r1;
+                    std::memcpy(indices, refined, sizeof(refined));
+                }
+            }
+
+            // four color mode needs c0 > c1, swapping the endpoints swaps index 0<->1 and 2<->3
+            if (c0 < c1) {
+                std::swap(c0, c1);
+                for (int i = 0; i < 16; ++i)
+                    indices[i] ^= 1;
+            }
+            uint32_t bits = 0;
+            if (c0 != c1)
+                for (int i = 0; i < 16; ++i)
+                    bits |= uint32_t(indices[i]) << (2 * i);
+            out[0] = uint8_t(c0 & 0xFF);
+            out[1] = uint8_t(c0 >> 8);
+            out[2] = uint8_t(c1 & 0xFF);
+            out[3] = uint8_t(c1 >> 8);
+            for (int i = 0; i < 4; ++i)
+                out[4 + i] = uint8_t(bits >> (8 * i));
+        }
+
+        // single channel block, 8 value mode (a0 > a1).
+        inline void encodeBC4(const float texels[16][4], int channel, unsigned char out[8]) {
+            float minValue = 255.0f, maxValue = 0.0f;
+            for (int i = 0; i < 16; ++i) {
+                minValue = std::min(minValue, texels[i][channel]);
+                maxValue = std::max(maxValue, texels[i][channel]);
+            }
+            int a0 = int(maxValue + 0.5f), a1 = int(minValue + 0.5f);
+            uint64_t bits = 0;
+            if (a0 != a1) {
+                float palette[8];
+                palette[0] = float(a0);
+                palette[1] = float(a1);
+                for (int i = 2; i < 8; ++i)
+                    palette[i] = float((8 - i) * a0 + (i - 1) * a1) / 7.0f;
+                for (int i = 0; i < 16; ++i) {
+                    int best = 0;
+                    float bestError = 1e30f;
+                    for (int p = 0; p < 8; ++p) {
+                        float error = std::fabs(texels[i][channel] - palette[p]);
+                        if (error < bestError) {
+                            bestError = error;
+                            best = p;
+                        }
+                    }
+                    bits |= uint64_t(best) << (3 * i);
+                }
+            }
+            out[0] = uint8_t(a0);
+            out[1] = uint8_t(a1);
+            for (int i = 0; i < 6; ++i)
+                out[2 + i] = uint8_t(bits >> (8 * i));
+        }
+
+        // BC7 mode 6: quantizes an endpoint to 7 bits per channel plus a shared p-bit, picking the better p-bit.
+        inline void quantizeBC7Endpoint(const float endpoint[4], int quantized[4], int &pbit) {
+            float bestError = 1e30f;
+            for (int p = 0; p < 2; ++p) {
+                int candidate[4];
+                float error = 0.0f;
+                for (int c = 0; c < 4; ++c) {
+                    candidate[c] = std::min(std::max(int((endpoint[c] - p) / 2.0f + 0.5f), 0), 127);
+                    float d = endpoint[c] - float((candidate[c] << 1) | p);
+                    error += d * d;
+                }
+                if (error < bestError) {
+                    bestError = error;
+                    pbit = p;
+                    std::memcpy(quantized, candidate, sizeof(candidate));
+                }
+            }
+        }
+
+        inline float encodeBC7Endpoints(const float texels[16][4], const int q0[4], int p0, const int q1[4], int p1, int indices[16]) {
+            static const int weights[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+            float palette[16][4];
+            for (int i = 0; i < 16; ++i)
+                for (int c = 0; c < 4; ++c) {
+                    int a = (q0[c] << 1) | p0, b = (q1[c] << 1) | p1;
+                    palette[i][c] = float(((64 - weights[i]) * a + weights[i] * b + 32) >> 6);
+                }
+            return selectIndices(texels, 4, palette, 16, indices);
+        }
+
+        inline void writeBits(unsigned char out[16], int &position, uint32_t value, int count) {
+            for (int i = 0; i < count; ++i, ++position)
+                if (value & (1u << i))
+                    out[position >> 3] |= uint8_t(1u << (position & 7));
+        }
+
+        inline void encodeBC7(const float texels[16][4], unsigned char out[16]) {
+            float e0[4], e1[4];
+            axisEndpoints(texels, 4, e0, e1);
+            int q0[4], q1[4], p0, p1;
+            quantizeBC7Endpoint(e0, q0, p0);
+            quantizeBC7Endpoint(e1, q1, p1);
+            int indices[16];
+            float error = encodeBC7Endpoints(texels, q0, p0, q1, p1, indices);
+
+            float w[16];
+            for (int i = 0; i < 16; ++i)
+                w[i] = float(indices[i]) / 15.0f;
+            if (refineEndpoints(texels, 4, w, e0, e1)) {
+                int r0[4], r1[4], rp0, rp1, refined[16];
+                quantizeBC7Endpoint(e0, r0, rp0);
+                quantizeBC7Endpoint(e1, r1, rp1);
+                float refinedError = encodeBC7Endpoints(texels, r0, rp0, r1, rp1, refined);
+                if (refinedError < error) {
+                    std::memcpy(q0, r0, sizeof(r0));
+                    std::memcpy(q1, r1, sizeof(r1));
+                    p0 = rp0;
+                    p1 = rp1;
+                    std::memcpy(indices, refined, sizeof(refined));
+                }
+            }
+
+            // the anchor texel (0) stores only 3 index bits, so its index has to be < 8
+            if (indices[0] >= 8) {
+                std::swap(q0, q1);
+                std::swap(p0, p1);
+                for (int i = 0; i < 16; ++i)
+                    indices[i] = 15 - indices[i];
+            }
+
+            std::memset(out, 0, 16);
+            int position = 0;
+            writeBits(out, position, 1u << 6, 7); // mode 6
+            for (int c = 0; c < 4; ++c) {
+                writeBits(out, position, uint32_t(q0[c]), 7);
+                writeBits(out, position, uint32_t(q1[c]), 7);
+            }
+            writeBits(out, position, uint32_t(p0), 1);
+            writeBits(out, position, uint32_t(p1), 1);
+            writeBits(out, position, uint32_t(indices[0]), 3);
+            for (int i = 1; i < 16; ++i)
+                writeBits(out, position, uint32_t(indices[i]), 4);
+        }
+
+        inline void encodeBlock(BlockFormat format, const float texels[16][4], unsigned char *out) {
+            switch (format) {
+                case BlockFormat::BC1:
+                    encodeBC1(texels, out);
+                    break;
+                case BlockFormat::BC3:
+                    encodeBC4(texels, 3, out);
+                    encodeBC1(texels, out + 8);
+                    break;
+                case BlockFormat::BC5:
+                    encodeBC4(texels, 0, out);
+                    encodeBC4(texels, 1, out + 8);
+                    break;
+                case BlockFormat::BC7:
+                    encodeBC7(texels, out);
+                    break;
+            }
+        }
+
+    }
+
+    inline size_t compressedLevelSize(BlockFormat format, int width, int height) {
+        return size_t((width + 3) / 4) * size_t((height + 3) / 4) * blockFormatBlockSize(format);
+    }
+
+    // compresses one image, block rows are spread over threadCount threads (0 means one per core).
+    inline std::vector<unsigned char> compressImage(const ImageRGBA8 &image, BlockFormat format, unsigned int threadCount = 0) {
+        const int blocksX = (image.width + 3) / 4;
+        const int blocksY = (image.height + 3) / 4;
+        const size_t blockSize = blockFormatBlockSize(format);
+        std::vector<unsigned char> result(size_t(blocksX) * blocksY * blockSize);
+
+        if (threadCount == 0)
+            threadCount = std::max(1u, std::thread::hardware_concurrency());
+        threadCount = std::min<unsigned int>(threadCount, unsigned(blocksY));
+
+        auto compressRows = [&](int firstRow, int lastRow) {
+            float texels[16][4];
+            for (int by = firstRow; by < lastRow; ++by)
+                for (int bx = 0; bx < blocksX; ++bx) {
+                    detail::fetchBlock(image, bx, by, texels);
+                    detail::encodeBlock(format, texels, &result[(size_t(by) * blocksX + bx) * blockSize]);
+                }
+        };
+
+        if (threadCount <= 1) {
+            compressRows(0, blocksY);
+            return result;
+        }
+        std::vector<std::thread> workers;
+        int rowsPerThread = (blocksY + int(threadCount) - 1) / int(threadCount);
+        for (int first = 0; first < blocksY; first += rowsPerThread)
+            workers.emplace_back(compressRows, first, std::min(blocksY, first + rowsPerThread));
+        for (std::thread &worker : workers)
+            worker.join();
+        return result;
+    }
+
+};
+
+#endif //PROJECT_BASE_BLOCKCOMPRESSION_H
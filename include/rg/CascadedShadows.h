@@ -0,0 +1,194 @@
+#ifndef PROJECT_BASE_CASCADEDSHADOWS_H
+#define PROJECT_BASE_CASCADEDSHADOWS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <rg/Culling.h>
+#include <rg/GLState.h>
+#include <rg/UniformBlocks.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <vector>
+
+// Cascaded shadow maps for the directional light. The camera frustum up to the shadow distance is split into
+// slices, and each slice gets an orthographic shadow map, a layer of one depth texture array.
+//
+// Each cascade covers the bounding sphere of its slice, whose size doesn't depend on where the camera looks.
+// Its center is snapped to whole shadow map texels in light space, so the shadow edges don't swim while the
+// camera moves. Only the depth range follows the scene: it reaches from the nearest caster in front of the
+// cascade to the slice or the farthest caster, whichever ends first.
+namespace rg {
+
+    // the practical split scheme: lambda blends logarithmic (1) and uniform (0) slice distances
+    inline void cascadeSplits(float nearPlane, float farPlane, unsigned int count, float lambda, float *splits) {
+        for (unsigned int i = 1; i <= count; ++i) {
+            float fraction = (float) i / count;
+            float logarithmic = nearPlane * std::pow(farPlane / nearPlane, fraction);
+            float uniform = nearPlane + (farPlane - nearPlane) * fraction;
+            splits[i - 1] = lambda * logarithmic + (1.0f - lambda) * uniform;
+        }
+    }
+
+    class CascadedShadowMap {
+    public:
+        static const unsigned int MAX_CASCADES = 4;
+        // texture unit of the cascades, below the shadow atlas
+        static const unsigned int TEXTURE_UNIT = 10;
+
+        explicit CascadedShadowMap(unsigned int size = 2048)
+                : m_Size(size), m_Block(CASCADES_BLOCK_BINDING) {
+            GLState &state = GLState::instance();
+            glGenTextures(1, &m_Texture);
+            state.bindTexture(GL_TEXTURE_2D_ARRAY, m_Texture);
+            glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, m_Size, m_Size, MAX_CASCADES, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+            // sampled through sampler2DArrayShadow, the linear filter gives 2x2 PCF
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+            // outside a cascade is unshadowed
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+            const float border[] = {1.0f, 1.0f, 1.0f, 1.0f};
+            glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, border);
+
+            glGenFramebuffers(1, &m_FBO);
+            state.bindFramebuffer(m_FBO);
+            glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_Texture, 0);
+            glDrawBuffer(GL_NONE);
+            glReadBuffer(GL_NONE);
+            state.bindFramebuffer(0);
+        }
+
+        ~CascadedShadowMap() {
+            GLState &state = GLState::instance();
+            state.textureDeleted(m_Texture);
+            glDeleteTextures(1, &m_Texture);
+            state.framebufferDeleted(m_FBO);
+            glDeleteFramebuffers(1, &m_FBO);
+        }
+
+        CascadedShadowMap(const CascadedShadowMap&) = delete;
+        CascadedShadowMap& operator=(const CascadedShadowMap&) = delete;
+
+        void clearCasters() {
+            m_Casters.clear();
+        }
+
+        // the world space bounding sphere of a caster, the depth range of the cascades is fitted to them
+        void addCaster(const glm::vec3 &center, float radius) {
+            m_Casters.push_back(glm::vec4(center, radius));
+        }
+
+        // fits count cascades to the camera frustum from nearPlane to shadowDistance for a light shining along
+        // direction, and uploads the Cascades block. count 0 turns the shadows off.
+        void update(const glm::mat4 &view, float fovY, float aspect, float nearPlane, float shadowDistance,
+                    unsigned int count, float lambda, const glm::vec3 &direction) {
+            m_Count = std::min(count, MAX_CASCADES);
+            float splits[MAX_CASCADES];
+            cascadeSplits(nearPlane, shadowDistance, m_Count, lambda, splits);
+
+            glm::vec3 lightDirection = glm::normalize(direction);
+            glm::vec3 up = std::abs(lightDirection.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+            // the light's rotation only, fixed in the world so the texel grid is too
+            glm::mat4 lightView = glm::lookAt(glm::vec3(0.0f), lightDirection, up);
+            glm::mat4 cameraToWorld = glm::inverse(view);
+
+            CascadesBlock block;
+            float sliceNear = nearPlane;
+            for (unsigned int cascade = 0; cascade < m_Count; ++cascade) {
+                glm::vec3 center;
+                float radius;
+                sliceSphere(sliceNear, splits[cascade], fovY, aspect, center, radius);
+                center = glm::vec3(cameraToWorld * glm::vec4(center, 1.0f));
+                // rounded up a little, so the texel size stays the same from frame to frame
+                radius = std::ceil(radius * 16.0f) / 16.0f;
+
+                // snapping moves the center by up to a texel, the half extent is a texel more than the radius so
+                // the sphere stays inside: extent = radius + texel with texel = 2 * extent / size
+                glm::vec3 lightCenter = glm::vec3(lightView * glm::vec4(center, 1.0f));
+                float extent = radius * m_Size / (m_Size - 2.0f);
+                float texel = 2.0f * extent / m_Size;
+                float x = std::floor(lightCenter.x / texel) * texel;
+                float y = std::floor(lightCenter.y / texel) * texel;
+
+                // depths along the light, -z in light space
+                float depthMin = -lightCenter.z - radius, depthMax = -lightCenter.z + radius;
+                float casterMin = FLT_MAX, casterMax = -FLT_MAX;
+                for (const glm::vec4 &caster : m_Casters) {
+                    glm::vec3 lightCaster = glm::vec3(lightView * glm::vec4(glm::vec3(caster), 1.0f));
+                    if (std::abs(lightCaster.x - x) > extent + caster.w || std::abs(lightCaster.y - y) > extent + caster.w)
+                        continue;
+                    casterMin = std::min(casterMin, -lightCaster.z - caster.w);
+                    casterMax = std::max(casterMax, -lightCaster.z + caster.w);
+                }
+                if (casterMin <= casterMax) {
+                    depthMin = std::min(depthMin, casterMin);
+                    depthMax = std::min(depthMax, casterMax);
+                }
+
+                m_Matrices[cascade] = glm::ortho(x - extent, x + extent, y - extent, y + extent, depthMin, std::max(depthMax, depthMin + 0.01f)) * lightView;
+                m_Frustums[cascade] = Frustum::fromMatrix(m_Matrices[cascade]);
+                block.matrices[cascade] = m_Matrices[cascade];
+                block.splits[cascade] = splits[cascade];
+                sliceNear = splits[cascade];
+            }
+            for (unsigned int cascade = m_Count; cascade < MAX_CASCADES; ++cascade) {
+                block.matrices[cascade] = glm::mat4(1.0f);
+                block.splits[cascade] = 0.0f;
+            }
+            block.count = (GLint) m_Count;
+            block.padding[0] = block.padding[1] = block.padding[2] = 0;
+            m_Block.update(block);
+        }
+
+        // binds and clears all layers for the one pass that draws every cascade. depth clamping keeps casters
+        // in front of the fitted range in the map instead of clipping them.
+        void begin() {
+            GLState &state = GLState::instance();
+            state.viewport(0, 0, m_Size, m_Size);
+            state.bindFramebuffer(m_FBO);
+            glClear(GL_DEPTH_BUFFER_BIT);
+            glEnable(GL_DEPTH_CLAMP);
+        }
+
+        void end() {
+            glDisable(GL_DEPTH_CLAMP);
+        }
+
+        unsigned int count() const { return m_Count; }
+        const Frustum* frustums() const { return m_Frustums; }
+        unsigned int texture() const { return m_Texture; }
+
+    private:
+        unsigned int m_Size;
+        unsigned int m_Texture = 0, m_FBO = 0;
+        unsigned int m_Count = 0;
+        UniformBuffer<CascadesBlock> m_Block;
+        glm::mat4 m_Matrices[MAX_CASCADES];
+        Frustum m_Frustums[MAX_CASCADES];
+        std::vector<glm::vec4> m_Casters;
+
+        // the sphere around the camera space slice between the two distances. it is placed on the view axis
+        // where it is smallest, so it only depends on the projection and the split.
+        static void sliceSphere(float nearDistance, float farDistance, float fovY, float aspect, glm::vec3 &center, float &radius) {
+            float tanY = std::tan(fovY * 0.5f), tanX = tanY * aspect;
+            // squared distance of a slice corner from the axis, per unit of depth
+            float spread = tanX * tanX + tanY * tanY;
+            // the center z that's equally far from the near and the far corners, clamped into the slice
+            float z = 0.5f * (nearDistance + farDistance) * (1.0f + spread);
+            z = std::min(std::max(z, nearDistance), farDistance);
+            float nearCorner = (z - nearDistance) * (z - nearDistance) + nearDistance * nearDistance * spread;
+            float farCorner = (farDistance - z) * (farDistance - z) + farDistance * farDistance * spread;
+            center = glm::vec3(0.0f, 0.0f, -z);
+            radius = std::sqrt(std::max(nearCorner, farCorner));
+        }
+    };
+
+};
+
+#endif //PROJECT_BASE_CASCADEDSHADOWS_H
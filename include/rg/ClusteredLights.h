@@ -0,0 +1,248 @@
+#ifndef PROJECT_BASE_CLUSTEREDLIGHTS_H
+#define PROJECT_BASE_CLUSTEREDLIGHTS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <rg/GLState.h>
+#include <rg/UniformBlocks.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Clustered forward lighting. The view frustum is split into a grid of clusters, x and y in screen space and z in
+// exponential depth slices. Every frame the lights are assigned to the clusters their sphere of influence
+// touches, on the CPU, and the result is uploaded as three texture buffers:
+//
+//   lights   RGBA32F  five texels per light, the std140 PointLight with the radius in the last w, then the
+//                     rg::ShadowAtlas slot of the light in x (-1 for an unshadowed light)
+//   ranges   RG32UI   per cluster the offset and the count of its entries in indices
+//   indices  R32UI    light indices, grouped by cluster
+//
+// 2.model_lighting.fs finds the cluster of a fragment from its view space position and only shades the lights
+// listed for it, so the cost per fragment follows the lights nearby instead of the lights in the scene.
+namespace rg {
+
+    // distance at which the brightest channel of the light falls below 5/256, past that it doesn't change an
+    // 8 bit pixel. FLT_MAX when the attenuation never gets there (constant only).
+    inline float pointLightRadius(const PointLightBlock &light) {
+        float brightest = 0.0f;
+        for (const glm::vec3 &color : {light.ambient, light.diffuse, light.specular})
+            brightest = std::max(brightest, std::max(color.x, std::max(color.y, color.z)));
+        // the attenuation denominator at which the light is that dim
+        float threshold = brightest * 256.0f / 5.0f;
+        if (threshold <= light.constant)
+            return 0.0f;
+        if (light.quadratic > 0.0f) {
+            float discriminant = light.linear * light.linear - 4.0f * light.quadratic * (light.constant - threshold);
+            return (-light.linear + std::sqrt(discriminant)) / (2.0f * light.quadratic);
+        }
+        if (light.linear > 0.0f)
+            return (threshold - light.constant) / light.linear;
+        return FLT_MAX;
+    }
+
+    struct ClusterStats {
+        unsigned int lights = 0;
+        unsigned int visibleLights = 0;     // lights that touch at least one cluster
+        unsigned int litClusters = 0;
+        unsigned int indices = 0;
+    };
+
+    struct ClusterLight {
+        PointLightBlock light;
+        glm::vec4 shadow;
+    };
+
+    class ClusteredLights {
+    public:
+        static const unsigned int GRID_X = 16, GRID_Y = 9, GRID_Z = 24;
+        static const unsigned int CLUSTER_COUNT = GRID_X * GRID_Y * GRID_Z;
+        // texture units of the three buffers, below the shadow cubemap on 15
+        static const unsigned int LIGHTS_UNIT = 12, RANGES_UNIT = 13, INDICES_UNIT = 14;
+
+        ClusteredLights()
+                : m_Block(CLUSTERS_BLOCK_BINDING) {
+            glGenBuffers(3, m_Buffers);
+            glGenTextures(3, m_Textures);
+            const GLenum formats[3] = {GL_RGBA32F, GL_RG32UI, GL_R32UI};
+            const unsigned int units[3] = {LIGHTS_UNIT, RANGES_UNIT, INDICES_UNIT};
+            for (int i = 0; i < 3; ++i) {
+                // a texture buffer needs storage before it is sampled, even an empty list gets one element
+                glBindBuffer(GL_TEXTURE_BUFFER, m_Buffers[i]);
+                glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+                GLState::instance().bindTexture(units[i], GL_TEXTURE_BUFFER, m_Textures[i]);
+                glTexBuffer(GL_TEXTURE_BUFFER, formats[i], m_Buffers[i]);
+            }
+            glBindBuffer(GL_TEXTURE_BUFFER, 0);
+        }
+
+        ~ClusteredLights() {
+            for (unsigned int texture : m_Textures)
+                GLState::instance().textureDeleted(texture);
+            glDeleteTextures(3, m_Textures);
+            glDeleteBuffers(3, m_Buffers);
+        }
+
+        ClusteredLights(const ClusteredLights&) = delete;
+        ClusteredLights& operator=(const ClusteredLights&) = delete;
+
+        void clear() {
+            m_Lights.clear();
+        }
+
+        // the radius is derived from the attenuation, see pointLightRadius. shadowSlot is the light's slot in
+        // the shadow atlas, if it has one.
+        void add(const PointLightBlock &light, int shadowSlot = -1) {
+            ClusterLight clusterLight;
+            clusterLight.light = light;
+            clusterLight.light.padding = pointLightRadius(light);
+            clusterLight.shadow = glm::vec4((float) shadowSlot, 0.0f, 0.0f, 0.0f);
+            m_Lights.push_back(clusterLight);
+        }
+
+        // assigns the lights added since clear to the clusters of the view and uploads the grid. nearPlane and
+        // farPlane are the ones of projection.
+        ClusterStats build(const glm::mat4 &view, const glm::mat4 &projection, float nearPlane, float farPlane) {
+            ClusterStats stats;
+            stats.lights = (unsigned int) m_Lights.size();
+            float sliceScale = GRID_Z / std::log(farPlane / nearPlane);
+            float sliceBias = -sliceScale * std::log(nearPlane);
+
+            // the cluster box of every light, then the counts per cluster
+            m_Counts.assign(CLUSTER_COUNT, 0);
+            m_Extents.clear();
+            for (const ClusterLight &light : m_Lights) {
+                Extent extent;
+                if (clusterExtent(light.light, view, projection, nearPlane, farPlane, sliceScale, sliceBias, extent)) {
+                    stats.visibleLights++;
+                    forEachCluster(extent, [&](unsigned int cluster) { m_Counts[cluster]++; });
+                } else {
+                    extent.empty = true;
+                }
+                m_Extents.push_back(extent);
+            }
+
+            // prefix sum into the ranges, then the indices are written at the running offsets
+            m_Ranges.resize(CLUSTER_COUNT * 2);
+            uint32_t offset = 0;
+            for (unsigned int cluster = 0; cluster < CLUSTER_COUNT; ++cluster) {
+                m_Ranges[cluster * 2] = offset;
+                m_Ranges[cluster * 2 + 1] = m_Counts[cluster];
+                stats.litClusters += m_Counts[cluster] != 0;
+                m_Counts[cluster] = offset;
+                offset += m_Ranges[cluster * 2 + 1];
+            }
+            // at least the 16 bytes upload() allocates for an empty list
+            m_Indices.resize(std::max<uint32_t>(offset, 4));
+            for (uint32_t light = 0; light < m_Extents.size(); ++light)
+                if (!m_Extents[light].empty)
+                    forEachCluster(m_Extents[light], [&](unsigned int cluster) { m_Indices[m_Counts[cluster]++] = light; });
+            stats.indices = offset;
+
+            upload(0, m_Lights.data(), m_Lights.size() * sizeof(ClusterLight));
+            upload(1, m_Ranges.data(), m_Ranges.size() * sizeof(uint32_t));
+            upload(2, m_Indices.data(), m_Indices.size() * sizeof(uint32_t));
+
+            ClustersBlock block;
+            block.grid.x = GRID_X;
+            block.grid.y = GRID_Y;
+            block.grid.z = GRID_Z;
+            block.grid.w = stats.lights;
+            block.depth = glm::vec4(nearPlane, farPlane, sliceScale, sliceBias);
+            m_Block.update(block);
+            return stats;
+        }
+
+        // binds the three buffers to their units, the samplers of the programs point there
+        void bind() {
+            GLState &state = GLState::instance();
+            state.bindTexture(LIGHTS_UNIT, GL_TEXTURE_BUFFER, m_Textures[0]);
+            state.bindTexture(RANGES_UNIT, GL_TEXTURE_BUFFER, m_Textures[1]);
+            state.bindTexture(INDICES_UNIT, GL_TEXTURE_BUFFER, m_Textures[2]);
+        }
+
+    private:
+        // inclusive cluster coordinates a light touches
+        struct Extent {
+            int x0 = 0, x1 = 0, y0 = 0, y1 = 0, z0 = 0, z1 = 0;
+            bool empty = false;
+        };
+
+        UniformBuffer<ClustersBlock> m_Block;
+        unsigned int m_Buffers[3] = {0, 0, 0};
+        unsigned int m_Textures[3] = {0, 0, 0};
+        std::vector<ClusterLight> m_Lights;
+        std::vector<Extent> m_Extents;
+        std::vector<uint32_t> m_Counts, m_Ranges, m_Indices;
+
+        // the clusters overlapped by the screen rectangle and the depth range of the light's sphere. the
+        // rectangle comes from the corners of the sphere's view space box, a sphere reaching behind the near
+        // plane covers the whole screen. false when the light doesn't touch the frustum.
+        static bool clusterExtent(const PointLightBlock &light, const glm::mat4 &view, const glm::mat4 &projection,
+                                  float nearPlane, float farPlane, float sliceScale, float sliceBias, Extent &extent) {
+            float radius = light.padding;
+            if (radius <= 0.0f)
+                return false;
+            glm::vec3 center = glm::vec3(view * glm::vec4(light.position, 1.0f));
+            float depthMin = -center.z - radius, depthMax = -center.z + radius;
+            if (depthMax < nearPlane || depthMin > farPlane)
+                return false;
+            extent.z0 = slice(std::max(depthMin, nearPlane), sliceScale, sliceBias);
+            extent.z1 = slice(std::min(depthMax, farPlane), sliceScale, sliceBias);
+
+            if (depthMin <= nearPlane) {
+                extent.x0 = extent.y0 = 0;
+                extent.x1 = GRID_X - 1;
+                extent.y1 = GRID_Y - 1;
+                return true;
+            }
+            glm::vec2 ndcMin(FLT_MAX), ndcMax(-FLT_MAX);
+            for (int corner = 0; corner < 8; ++corner) {
+                glm::vec3 offset((corner & 1) ? radius : -radius, (corner & 2) ? radius : -radius,
+                                 (corner & 4) ? radius : -radius);
+                glm::vec4 clip = projection * glm::vec4(center + offset, 1.0f);
+                glm::vec2 ndc = glm::vec2(clip.x, clip.y) * (1.0f / clip.w);
+                ndcMin = glm::min(ndcMin, ndc);
+                ndcMax = glm::max(ndcMax, ndc);
+            }
+            if (ndcMax.x < -1.0f || ndcMin.x > 1.0f || ndcMax.y < -1.0f || ndcMin.y > 1.0f)
+                return false;
+            extent.x0 = tile(ndcMin.x, GRID_X);
+            extent.x1 = tile(ndcMax.x, GRID_X);
+            extent.y0 = tile(ndcMin.y, GRID_Y);
+            extent.y1 = tile(ndcMax.y, GRID_Y);
+            return true;
+        }
+
+        // the same mapping as clusterIndex in 2.model_lighting.fs
+        static int slice(float depth, float sliceScale, float sliceBias) {
+            return std::min(std::max((int) std::floor(std::log(depth) * sliceScale + sliceBias), 0), (int) GRID_Z - 1);
+        }
+
+        static int tile(float ndc, unsigned int tiles) {
+            return std::min(std::max((int) std::floor((ndc * 0.5f + 0.5f) * tiles), 0), (int) tiles - 1);
+        }
+
+        template<typename Visit>
+        static void forEachCluster(const Extent &extent, Visit visit) {
+            for (int z = extent.z0; z <= extent.z1; ++z)
+                for (int y = extent.y0; y <= extent.y1; ++y)
+                    for (int x = extent.x0; x <= extent.x1; ++x)
+                        visit((unsigned int) (x + GRID_X * (y + GRID_Y * z)));
+        }
+
+        // orphans the buffer every frame, so the upload doesn't wait for the draws of the last one
+        void upload(int buffer, const void *data, size_t size) {
+            glBindBuffer(GL_TEXTURE_BUFFER, m_Buffers[buffer]);
+            glBufferData(GL_TEXTURE_BUFFER, std::max<size_t>(size, 16), size ? data : nullptr, GL_STREAM_DRAW);
+            glBindBuffer(GL_TEXTURE_BUFFER, 0);
+        }
+    };
+
+};
+
+#endif //PROJECT_BASE_CLUSTEREDLIGHTS_H
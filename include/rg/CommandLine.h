@@ -0,0 +1,39 @@
+#ifndef PROJECT_BASE_COMMANDLINE_H
+#define PROJECT_BASE_COMMANDLINE_H
+
+#include <cstdlib>
+#include <iostream>
+
+// What the command line parsers of the modules share. main hands every argument to each module's parseXOption
+// in turn until one of them knows it.
+namespace rg {
+
+    enum OptionResult {
+        OPTION_UNKNOWN,     // not an option of this module, try the next one
+        OPTION_PARSED,      // consumed, with its value if it has one
+        OPTION_INVALID      // malformed, a message was printed
+    };
+
+    // whether argv[i] is followed by a value, a message otherwise
+    inline bool hasOptionValue(int argc, char **argv, int i) {
+        if (i + 1 < argc)
+            return true;
+        std::cout << "Missing value for " << argv[i] << std::endl;
+        return false;
+    }
+
+    // a positive count, false and a message otherwise
+    inline bool parseCount(const char *option, const char *text, unsigned int &count) {
+        char *end = nullptr;
+        long value = std::strtol(text, &end, 10);
+        if (*end != '\0' || value <= 0) {
+            std::cout << "Invalid " << option << ": " << text << std::endl;
+            return false;
+        }
+        count = (unsigned int) value;
+        return true;
+    }
+
+};
+
+#endif //PROJECT_BASE_COMMANDLINE_H
@@ -0,0 +1,313 @@
+#ifndef PROJECT_BASE_COOKEDMODEL_H
+#define PROJECT_BASE_COOKEDMODEL_H
+
+#include <rg/MappedFile.h>
+#include <rg/ModelImporter.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Binary model format written by the asset_cooker tool (and by Model itself after an Assimp import).
+// Layout, all offsets in bytes from the start of the file, every block 16 byte aligned:
+//   CookedModelHeader
+//   CookedMeshRecord[meshCount]
+//   CookedMaterialRecord[materialCount]
+//   CookedTextureRecord[textureCount]
+//   string table (type and path of every texture and the material library name, not null terminated)
+//   Vertex[vertexCount]         - uploaded as is with glBufferData
+//   unsigned int[indexCount]    - uploaded as is with glBufferData
+// The file is memory mapped at load time so the vertex and index blobs go to the driver without an extra copy.
+namespace rg {
+
+    const char COOKED_MODEL_MAGIC[4] = {'R', 'G', 'M', 'D'};
+    // bump whenever the layout or the import post-processing changes, old files are then treated as stale.
+    const uint32_t COOKED_MODEL_VERSION = 3;
+
+    struct CookedModelHeader {
+        char magic[4];
+        uint32_t version;
+        uint32_t vertexStride;      // sizeof(Vertex) at cook time
+        uint32_t meshCount;
+        uint32_t materialCount;
+        uint32_t textureCount;
+        uint32_t vertexCount;
+        uint32_t indexCount;
+        uint64_t sourceSize;        // size and modification time of the source file, used for the staleness check
+        int64_t sourceMtime;
+        uint64_t materialLibrarySize;   // same for the material library of an .obj (its materials and texture paths)
+        int64_t materialLibraryMtime;
+        uint32_t materialLibraryOffset; // its name relative to the model directory in the string table, length 0 without one
+        uint32_t materialLibraryLength;
+        uint32_t importFlags;           // MODEL_IMPORT_FLAGS at cook time
+        float boundsMin[3];
+        float boundsMax[3];
+        uint64_t meshOffset;
+        uint64_t materialOffset;
+        uint64_t textureOffset;
+        uint64_t stringOffset;
+        uint64_t vertexOffset;
+        uint64_t indexOffset;
+    };
+
+    struct CookedMeshRecord {
+        uint32_t firstVertex;
+        uint32_t vertexCount;
+        uint32_t firstIndex;
+        uint32_t indexCount;
+        uint32_t material;
+        float boundsMin[3];
+        float boundsMax[3];
+        uint32_t sourceVertexCount;     // MeshOptimizationStats of the import, reported at load time
+        float acmrBefore;
+        float acmrAfter;
+    };
+
+    struct CookedMaterialRecord {
+        uint32_t firstTexture;
+        uint32_t textureCount;
+    };
+
+    struct CookedTextureRecord {
+        uint32_t typeOffset;    // relative to the string table
+        uint32_t typeLength;
+        uint32_t pathOffset;
+        uint32_t pathLength;
+    };
+
+    inline std::string cookedModelPath(std::string const &sourcePath) {
+        return sourcePath + ".rgm";
+    }
+
+    inline std::string cookedModelDirectory(std::string const &sourcePath) {
+        return sourcePath.substr(0, sourcePath.find_last_of('/'));
+    }
+
+    inline uint64_t alignCookedOffset(uint64_t offset) {
+        return (offset + 15) & ~uint64_t(15);
+    }
+
+    // typed view over a mapped cooked model. All pointers point into the mapping and are only valid while it is open.
+    class CookedModelView {
+    public:
+        // validates the header, every block range against the size of the mapping and every record's range against
+        // its block. Index values aren't checked here, see indicesInRange.
+        bool open(const MappedFile &file) {
+            m_Data = file.data();
+            if (!m_Data || file.size() < sizeof(CookedModelHeader))
+                return false;
+            m_Header = reinterpret_cast<const CookedModelHeader*>(m_Data);
+            if (std::memcmp(m_Header->magic, COOKED_MODEL_MAGIC, 4) != 0
+                || m_Header->version != COOKED_MODEL_VERSION
+                || m_Header->vertexStride != sizeof(Vertex))
+                return false;
+            const uint64_t size = file.size();
+            // the string table ends where the vertices begin
+            if (!fits(m_Header->meshOffset, uint64_t(m_Header->meshCount) * sizeof(CookedMeshRecord), size)
+                || !fits(m_Header->materialOffset, uint64_t(m_Header->materialCount) * sizeof(CookedMaterialRecord), size)
+                || !fits(m_Header->textureOffset, uint64_t(m_Header->textureCount) * sizeof(CookedTextureRecord), size)
+                || m_Header->stringOffset > m_Header->vertexOffset
+                || !fits(m_Header->vertexOffset, uint64_t(m_Header->vertexCount) * sizeof(Vertex), size)
+                || !fits(m_Header->indexOffset, uint64_t(m_Header->indexCount) * sizeof(unsigned int), size))
+                return false;
+            const uint64_t stringSize = m_Header->vertexOffset - m_Header->stringOffset;
+            if (!fits(m_Header->materialLibraryOffset, m_Header->materialLibraryLength, stringSize))
+                return false;
+            for (uint32_t i = 0; i < m_Header->meshCount; ++i) {
+                const CookedMeshRecord &mesh = meshes()[i];
+                if (!fits(mesh.firstVertex, mesh.vertexCount, m_Header->vertexCount)
+                    || !fits(mesh.firstIndex, mesh.indexCount, m_Header->indexCount))
+                    return false;
+            }
+            for (uint32_t i = 0; i < m_Header->materialCount; ++i) {
+                const CookedMaterialRecord &material = materials()[i];
+                if (!fits(material.firstTexture, material.textureCount, m_Header->textureCount))
+                    return false;
+            }
+            for (uint32_t i = 0; i < m_Header->textureCount; ++i) {
+                const CookedTextureRecord &texture = textures()[i];
+                if (!fits(texture.typeOffset, texture.typeLength, stringSize)
+                    || !fits(texture.pathOffset, texture.pathLength, stringSize))
+                    return false;
+            }
+            return true;
+        }
+
+        // true when every index of the mesh refers to one of its vertices. Not part of open() because it reads the
+        // whole index blob, the loader checks the meshes it is about to upload.
+        bool indicesInRange(const CookedMeshRecord &mesh) const {
+            const unsigned int *index = indices() + mesh.firstIndex;
+            for (uint32_t i = 0; i < mesh.indexCount; ++i)
+                if (index[i] >= mesh.vertexCount)
+                    return false;
+            return true;
+        }
+
+        const CookedModelHeader& header() const { return *m_Header; }
+        const CookedMeshRecord* meshes() const { return at<CookedMeshRecord>(m_Header->meshOffset); }
+        const CookedMaterialRecord* materials() const { return at<CookedMaterialRecord>(m_Header->materialOffset); }
+        const CookedTextureRecord* textures() const { return at<CookedTextureRecord>(m_Header->textureOffset); }
+        const Vertex* vertices() const { return at<Vertex>(m_Header->vertexOffset); }
+        const unsigned int* indices() const { return at<unsigned int>(m_Header->indexOffset); }
+
+        // offset and length of a record open() validated
+        std::string string(uint32_t offset, uint32_t length) const {
+            return std::string(reinterpret_cast<const char*>(m_Data + m_Header->stringOffset + offset), length);
+        }
+
+    private:
+        const unsigned char *m_Data = nullptr;
+        const CookedModelHeader *m_Header = nullptr;
+
+        template<typename T>
+        const T* at(uint64_t offset) const {
+            return reinterpret_cast<const T*>(m_Data + offset);
+        }
+
+        static bool fits(uint64_t offset, uint64_t length, uint64_t size) {
+            return offset <= size && length <= size - offset;
+        }
+    };
+
+    // a cooked file is fresh when it was written by this version of the cooker with the same import flags, from the
+    // source file and its material library as they are now.
+    inline bool isCookedModelFresh(std::string const &cookedPath, std::string const &sourcePath) {
+        uint64_t sourceSize;
+        int64_t sourceMtime;
+        if (!statFile(sourcePath, sourceSize, sourceMtime))
+            return false;
+        std::ifstream in(cookedPath, std::ios::binary);
+        CookedModelHeader header;
+        if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)))
+            return false;
+        if (std::memcmp(header.magic, COOKED_MODEL_MAGIC, 4) != 0
+            || header.version != COOKED_MODEL_VERSION
+            || header.vertexStride != sizeof(Vertex)
+            || header.importFlags != MODEL_IMPORT_FLAGS
+            || header.sourceSize != sourceSize
+            || header.sourceMtime != sourceMtime)
+            return false;
+        if (header.materialLibraryLength == 0)
+            return true;
+        // the name is read from the cooked file instead of scanning the source again
+        std::string library(header.materialLibraryLength, '\0');
+        if (!in.seekg(header.stringOffset + header.materialLibraryOffset) || !in.read(&library[0], library.size()))
+            return false;
+        uint64_t librarySize = 0;
+        int64_t libraryMtime = 0;
+        if (!statFile(cookedModelDirectory(sourcePath) + '/' + library, librarySize, libraryMtime))
+            librarySize = libraryMtime = 0;
+        return header.materialLibrarySize == librarySize
+            && header.materialLibraryMtime == libraryMtime;
+    }
+
+    inline bool writeCookedModel(std::string const &cookedPath, std::string const &sourcePath, const ImportedModel &model) {
+        CookedModelHeader header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, COOKED_MODEL_MAGIC, 4);
+        header.version = COOKED_MODEL_VERSION;
+        header.vertexStride = sizeof(Vertex);
+        header.importFlags = MODEL_IMPORT_FLAGS;
+        if (!statFile(sourcePath, header.sourceSize, header.sourceMtime))
+            return false;
+        for (int i = 0; i < 3; ++i) {
+            header.boundsMin[i] = model.boundsMin[i];
+            header.boundsMax[i] = model.boundsMax[i];
+        }
+
+        std::vector<CookedMeshRecord> meshes;
+        for (const ImportedMesh &mesh : model.meshes) {
+            CookedMeshRecord record;
+            record.firstVertex = header.vertexCount;
+            record.vertexCount = (uint32_t) mesh.vertices.size();
+            record.firstIndex = header.indexCount;
+            record.indexCount = (uint32_t) mesh.indices.size();
+            record.material = mesh.material;
+            record.sourceVertexCount = mesh.optimization.vertexCountBefore;
+            record.acmrBefore = mesh.optimization.acmrBefore;
+            record.acmrAfter = mesh.optimization.acmrAfter;
+            for (int i = 0; i < 3; ++i) {
+                record.boundsMin[i] = mesh.boundsMin[i];
+                record.boundsMax[i] = mesh.boundsMax[i];
+            }
+            header.vertexCount += record.vertexCount;
+            header.indexCount += record.indexCount;
+            meshes.push_back(record);
+        }
+
+        std::vector<CookedMaterialRecord> materials;
+        std::vector<CookedTextureRecord> textures;
+        std::string strings;
+        for (const ImportedMaterial &material : model.materials) {
+            CookedMaterialRecord record;
+            record.firstTexture = (uint32_t) textures.size();
+            record.textureCount = (uint32_t) material.textures.size();
+            for (const ImportedTexture &texture : material.textures) {
+                CookedTextureRecord textureRecord;
+                textureRecord.typeOffset = (uint32_t) strings.size();
+                textureRecord.typeLength = (uint32_t) texture.type.size();
+                strings += texture.type;
+                textureRecord.pathOffset = (uint32_t) strings.size();
+                textureRecord.pathLength = (uint32_t) texture.path.size();
+                strings += texture.path;
+                textures.push_back(textureRecord);
+            }
+            materials.push_back(record);
+        }
+        // a missing library stays stamped 0 and 0, so creating it makes the file stale
+        std::string library = objMaterialLibrary(sourcePath);
+        if (!library.empty()) {
+            statFile(cookedModelDirectory(sourcePath) + '/' + library, header.materialLibrarySize, header.materialLibraryMtime);
+            header.materialLibraryOffset = (uint32_t) strings.size();
+            header.materialLibraryLength = (uint32_t) library.size();
+            strings += library;
+        }
+        header.meshCount = (uint32_t) meshes.size();
+        header.materialCount = (uint32_t) materials.size();
+        header.textureCount = (uint32_t) textures.size();
+
+        header.meshOffset = alignCookedOffset(sizeof(header));
+        header.materialOffset = alignCookedOffset(header.meshOffset + meshes.size() * sizeof(CookedMeshRecord));
+        header.textureOffset = alignCookedOffset(header.materialOffset + materials.size() * sizeof(CookedMaterialRecord));
+        header.stringOffset = alignCookedOffset(header.textureOffset + textures.size() * sizeof(CookedTextureRecord));
+        header.vertexOffset = alignCookedOffset(header.stringOffset + strings.size());
+        header.indexOffset = alignCookedOffset(header.vertexOffset + uint64_t(header.vertexCount) * sizeof(Vertex));
+
+        // write to a temporary file first so a crashed cook never leaves a half written file that looks valid.
+        std::string tmpPath = cookedPath + ".tmp";
+        std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!out)
+            return false;
+        auto writeAt = [&out](uint64_t offset, const void *data, size_t size) {
+            static const char padding[16] = {};
+            uint64_t position = (uint64_t) out.tellp();
+            if (offset > position)
+                out.write(padding, offset - position);
+            if (size)
+                out.write(static_cast<const char*>(data), size);
+        };
+        writeAt(0, &header, sizeof(header));
+        writeAt(header.meshOffset, meshes.data(), meshes.size() * sizeof(CookedMeshRecord));
+        writeAt(header.materialOffset, materials.data(), materials.size() * sizeof(CookedMaterialRecord));
+        writeAt(header.textureOffset, textures.data(), textures.size() * sizeof(CookedTextureRecord));
+        writeAt(header.stringOffset, strings.data(), strings.size());
+        writeAt(header.vertexOffset, nullptr, 0);
+        for (const ImportedMesh &mesh : model.meshes)
+            out.write(reinterpret_cast<const char*>(mesh.vertices.data()), mesh.vertices.size() * sizeof(Vertex));
+        writeAt(header.indexOffset, nullptr, 0);
+        for (const ImportedMesh &mesh : model.meshes)
+            out.write(reinterpret_cast<const char*>(mesh.indices.data()), mesh.indices.size() * sizeof(unsigned int));
+        out.close();
+        if (!out) {
+            std::remove(tmpPath.c_str());
+            return false;
+        }
+        return std::rename(tmpPath.c_str(), cookedPath.c_str()) == 0;
+    }
+
+};
+
+#endif //PROJECT_BASE_COOKEDMODEL_H
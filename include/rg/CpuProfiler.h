@@ -0,0 +1,245 @@
+#ifndef PROJECT_BASE_CPUPROFILER_H
+#define PROJECT_BASE_CPUPROFILER_H
+
+#include <rg/CommandLine.h>
+
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#ifdef RG_CPU_PROFILER
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#endif
+
+// Scoped CPU zones, written out as a Chrome trace (chrome://tracing, ui.perfetto.dev) when the program exits:
+//
+//   RG_PROFILE_ZONE("Load model");        // until the end of the enclosing block
+//   RG_PROFILE_BEGIN("Matrices"); ... RG_PROFILE_END();
+//   RG_PROFILE_THREAD("Image decode");    // names the calling thread in the trace
+//
+// The zones only exist in builds configured with -DRG_CPU_PROFILER=ON, otherwise the macros expand to nothing
+// and none of the profiler is compiled. Every thread records into its own buffer, a list of fixed size chunks
+// only that thread writes to. A finished zone is one store into the current chunk and a release of the chunk's
+// count, no locks and no allocation except a new chunk every CHUNK_EVENTS zones.
+//
+//   project_base --trace startup.json      (trace.json by default)
+namespace rg {
+
+    struct CpuTraceOptions {
+        std::string path = "trace.json";
+    };
+
+    // parses argv[i], and its value at argv[i + 1] which then advances i
+    inline OptionResult parseCpuTraceOption(int argc, char **argv, int &i, CpuTraceOptions &options) {
+        if (std::strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            options.path = argv[++i];
+#ifndef RG_CPU_PROFILER
+            std::cout << "Built without RG_CPU_PROFILER, --trace writes nothing" << std::endl;
+#endif
+            return OPTION_PARSED;
+        }
+        return OPTION_UNKNOWN;
+    }
+
+#ifdef RG_CPU_PROFILER
+
+    class CpuProfiler {
+    public:
+        static const unsigned int CHUNK_EVENTS = 4096;
+        // per thread, about 100 MB. zones past it are counted and dropped.
+        static const unsigned int MAX_CHUNKS = 1024;
+        // zones nested deeper are not recorded
+        static const unsigned int MAX_DEPTH = 64;
+
+        static CpuProfiler& instance() {
+            static CpuProfiler profiler;
+            return profiler;
+        }
+
+        void begin(const char *name) {
+            ThreadBuffer &thread = threadBuffer();
+            if (thread.depth < MAX_DEPTH)
+                thread.open[thread.depth] = OpenZone{name, now()};
+            thread.depth++;
+        }
+
+        void end() {
+            ThreadBuffer &thread = threadBuffer();
+            if (thread.depth == 0)
+                return;
+            if (--thread.depth < MAX_DEPTH)
+                record(thread, thread.open[thread.depth], now());
+        }
+
+        // name has to outlive the profiler
+        void setThreadName(const char *name) {
+            threadBuffer().name.store(name, std::memory_order_release);
+        }
+
+        // writes the zones recorded so far, threads can keep recording meanwhile
+        bool writeTrace(const std::string &path) const {
+            FILE *file = std::fopen(path.c_str(), "w");
+            if (!file)
+                return false;
+            std::fprintf(file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+            const char *separator = "";
+            for (ThreadBuffer *thread = m_Threads.load(std::memory_order_acquire); thread; thread = thread->nextThread) {
+                const char *name = thread->name.load(std::memory_order_acquire);
+                std::fprintf(file, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %u, \"args\": {\"name\": \"",
+                             separator, thread->id);
+                writeEscaped(file, name ? name : "Thread");
+                std::fprintf(file, "\"}}");
+                separator = ",\n";
+                for (const Chunk *chunk = thread->head; chunk; chunk = chunk->next.load(std::memory_order_acquire)) {
+                    unsigned int count = chunk->count.load(std::memory_order_acquire);
+                    for (unsigned int i = 0; i < count; ++i) {
+                        const Event &event = chunk->events[i];
+                        std::fprintf(file, ",\n{\"name\": \"");
+                        writeEscaped(file, event.name);
+                        std::fprintf(file, "\", \"ph\": \"X\", \"pid\": 1, \"tid\": %u, \"ts\": %.3f, \"dur\": %.3f}",
+                                     thread->id, event.begin / 1000.0, (event.end - event.begin) / 1000.0);
+                    }
+                }
+                uint64_t dropped = thread->dropped.load(std::memory_order_relaxed);
+                if (dropped)
+                    std::cout << "CPU profiler dropped " << dropped << " zones of thread " << thread->id << std::endl;
+            }
+            std::fprintf(file, "\n]}\n");
+            return std::fclose(file) == 0;
+        }
+
+    private:
+        // nanoseconds since the profiler started
+        struct Event {
+            const char *name;
+            int64_t begin, end;
+        };
+
+        struct Chunk {
+            Event events[CHUNK_EVENTS];
+            std::atomic<unsigned int> count{0};
+            std::atomic<Chunk*> next{nullptr};
+        };
+
+        struct OpenZone {
+            const char *name;
+            int64_t begin;
+        };
+
+        struct ThreadBuffer {
+            unsigned int id = 0;
+            std::atomic<const char*> name{nullptr};
+            Chunk *head = nullptr, *tail = nullptr;
+            unsigned int chunks = 0;
+            std::atomic<uint64_t> dropped{0};
+            OpenZone open[MAX_DEPTH];
+            unsigned int depth = 0;
+            ThreadBuffer *nextThread = nullptr;
+        };
+
+        std::chrono::steady_clock::time_point m_Start = std::chrono::steady_clock::now();
+        std::atomic<ThreadBuffer*> m_Threads{nullptr};
+        std::atomic<unsigned int> m_NextThreadId{1};
+
+        CpuProfiler() = default;
+
+        int64_t now() const {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_Start).count();
+        }
+
+        // the calling thread's buffer, pushed onto the thread list without a lock the first time. buffers are
+        // never freed: a thread may still record while static destructors run, and the trace needs them.
+        ThreadBuffer& threadBuffer() {
+            thread_local ThreadBuffer *buffer = nullptr;
+            if (!buffer) {
+                buffer = new ThreadBuffer();
+                buffer->id = m_NextThreadId.fetch_add(1, std::memory_order_relaxed);
+                buffer->head = buffer->tail = new Chunk();
+                buffer->chunks = 1;
+                buffer->nextThread = m_Threads.load(std::memory_order_relaxed);
+                while (!m_Threads.compare_exchange_weak(buffer->nextThread, buffer, std::memory_order_release,
+                                                        std::memory_order_relaxed)) {}
+            }
+            return *buffer;
+        }
+
+        // only the owning thread writes to its chunks, the release of the count publishes the event to writeTrace
+        static void record(ThreadBuffer &thread, const OpenZone &zone, int64_t end) {
+            Chunk *chunk = thread.tail;
+            unsigned int count = chunk->count.load(std::memory_order_relaxed);
+            if (count == CHUNK_EVENTS) {
+                if (thread.chunks == MAX_CHUNKS) {
+                    thread.dropped.fetch_add(1, std::memory_order_relaxed);
+                    return;
+                }
+                Chunk *next = new Chunk();
+                chunk->next.store(next, std::memory_order_release);
+                thread.tail = chunk = next;
+                thread.chunks++;
+                count = 0;
+            }
+            chunk->events[count] = Event{zone.name, zone.begin, end};
+            chunk->count.store(count + 1, std::memory_order_release);
+        }
+
+        static void writeEscaped(FILE *file, const char *text) {
+            for (; *text; ++text) {
+                if (*text == '"' || *text == '\\')
+                    std::fputc('\\', file);
+                std::fputc(*text, file);
+            }
+        }
+    };
+
+    class CpuZone {
+    public:
+        explicit CpuZone(const char *name) {
+            CpuProfiler::instance().begin(name);
+        }
+
+        ~CpuZone() {
+            CpuProfiler::instance().end();
+        }
+
+        CpuZone(const CpuZone&) = delete;
+        CpuZone& operator=(const CpuZone&) = delete;
+    };
+
+    // true when the trace was written
+    inline bool writeCpuTrace(const CpuTraceOptions &options) {
+        if (!CpuProfiler::instance().writeTrace(options.path)) {
+            std::cout << "Failed to write the CPU trace " << options.path << std::endl;
+            return false;
+        }
+        std::cout << "CPU trace written to " << options.path << std::endl;
+        return true;
+    }
+
+#else
+
+    inline bool writeCpuTrace(const CpuTraceOptions &) {
+        return true;
+    }
+
+#endif
+
+};
+
+#ifdef RG_CPU_PROFILER
+#define RG_PROFILE_CONCAT_(a, b) a##b
+#define RG_PROFILE_CONCAT(a, b) RG_PROFILE_CONCAT_(a, b)
+#define RG_PROFILE_ZONE(name) rg::CpuZone RG_PROFILE_CONCAT(cpuZone, __LINE__)(name)
+#define RG_PROFILE_BEGIN(name) rg::CpuProfiler::instance().begin(name)
+#define RG_PROFILE_END() rg::CpuProfiler::instance().end()
+#define RG_PROFILE_THREAD(name) rg::CpuProfiler::instance().setThreadName(name)
+#else
+#define RG_PROFILE_ZONE(name) do {} while (0)
+#define RG_PROFILE_BEGIN(name) do {} while (0)
+#define RG_PROFILE_END() do {} while (0)
+#define RG_PROFILE_THREAD(name) do {} while (0)
+#endif
+
+#endif //PROJECT_BASE_CPUPROFILER_H
@@ -0,0 +1,156 @@
+#ifndef PROJECT_BASE_CULLING_H
+#define PROJECT_BASE_CULLING_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define RG_CULLING_SSE 1
+#endif
+
+// Bounding sphere culling. Spheres are collected in world space as a structure of arrays and tested four at a
+// time with SSE (a scalar loop elsewhere), the result is the list of indices that survive.
+namespace rg {
+
+    // planes point inwards, a point p is inside when dot(plane.xyz, p) + plane.w >= 0 for every plane
+    struct Frustum {
+        glm::vec4 planes[6];
+
+        // Gribb/Hartmann: the planes are sums and differences of the rows of the view-projection matrix
+        static Frustum fromMatrix(const glm::mat4 &viewProjection) {
+            glm::vec4 rows[4];
+            for (int i = 0; i < 4; ++i)
+                rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+            Frustum frustum;
+            frustum.planes[0] = rows[3] + rows[0];  // left
+            frustum.planes[1] = rows[3] - rows[0];  // right
+            frustum.planes[2] = rows[3] + rows[1];  // bottom
+            frustum.planes[3] = rows[3] - rows[1];  // top
+            frustum.planes[4] = rows[3] + rows[2];  // near
+            frustum.planes[5] = rows[3] - rows[2];  // far
+            for (glm::vec4 &plane : frustum.planes)
+                plane = plane * (1.0f / glm::length(glm::vec3(plane)));
+            return frustum;
+        }
+    };
+
+    // single sphere test, for the odd object that isn't worth a batch
+    inline bool sphereInFrustum(const Frustum &frustum, const glm::vec3 &center, float radius) {
+        for (const glm::vec4 &plane : frustum.planes)
+            if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+                return false;
+        return true;
+    }
+
+    // the sphere around a mesh's object space bounds, moved by transform. the radius grows with the largest
+    // axis scale, so non-uniform scales stay conservative.
+    inline void transformSphere(const glm::mat4 &transform, const glm::vec3 &center, float radius,
+                                glm::vec3 &worldCenter, float &worldRadius) {
+        worldCenter = glm::vec3(transform * glm::vec4(center, 1.0f));
+        float scale = std::max(glm::length(glm::vec3(transform[0])),
+                               std::max(glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2]))));
+        worldRadius = radius * scale;
+    }
+
+    class SphereBatch {
+    public:
+        void clear() {
+            m_X.clear();
+            m_Y.clear();
+            m_Z.clear();
+            m_Radius.clear();
+        }
+
+        void add(const glm::vec3 &center, float radius) {
+            m_X.push_back(center.x);
+            m_Y.push_back(center.y);
+            m_Z.push_back(center.z);
+            m_Radius.push_back(radius);
+        }
+
+        size_t size() const { return m_X.size(); }
+
+        // indices of the spheres that are at least partly inside the frustum
+        void cull(const Frustum &frustum, std::vector<uint32_t> &visible) {
+            visible.clear();
+            size_t count = size();
+            pad();
+#ifdef RG_CULLING_SSE
+            for (size_t i = 0; i < count; i += 4) {
+                __m128 x = _mm_loadu_ps(&m_X[i]), y = _mm_loadu_ps(&m_Y[i]), z = _mm_loadu_ps(&m_Z[i]);
+                __m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&m_Radius[i]));
+                __m128 inside = _mm_cmpeq_ps(x, x);
+                for (const glm::vec4 &plane : frustum.planes) {
+                    __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(plane.x)), _mm_mul_ps(y, _mm_set1_ps(plane.y))),
+                                                 _mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(plane.z)), _mm_set1_ps(plane.w)));
+                    inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negativeRadius));
+                }
+                appendVisible(_mm_movemask_ps(inside), i, count, visible);
+            }
+#else
+            for (size_t i = 0; i < count; ++i) {
+                bool inside = true;
+                for (const glm::vec4 &plane : frustum.planes)
+                    inside = inside && plane.x * m_X[i] + plane.y * m_Y[i] + plane.z * m_Z[i] + plane.w >= -m_Radius[i];
+                if (inside)
+                    visible.push_back((uint32_t) i);
+            }
+#endif
+            unpad(count);
+        }
+
+        // indices of the spheres that reach into the sphere around center, e.g. the range of a point light
+        void cull(const glm::vec3 &center, float range, std::vector<uint32_t> &visible) {
+            visible.clear();
+            size_t count = size();
+            pad();
+#ifdef RG_CULLING_SSE
+            for (size_t i = 0; i < count; i += 4) {
+                __m128 dx = _mm_sub_ps(_mm_loadu_ps(&m_X[i]), _mm_set1_ps(center.x));
+                __m128 dy = _mm_sub_ps(_mm_loadu_ps(&m_Y[i]), _mm_set1_ps(center.y));
+                __m128 dz = _mm_sub_ps(_mm_loadu_ps(&m_Z[i]), _mm_set1_ps(center.z));
+                __m128 reach = _mm_add_ps(_mm_loadu_ps(&m_Radius[i]), _mm_set1_ps(range));
+                __m128 distance2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+                appendVisible(_mm_movemask_ps(_mm_cmple_ps(distance2, _mm_mul_ps(reach, reach))), i, count, visible);
+            }
+#else
+            for (size_t i = 0; i < count; ++i) {
+                glm::vec3 d = glm::vec3(m_X[i], m_Y[i], m_Z[i]) - center;
+                float reach = m_Radius[i] + range;
+                if (glm::dot(d, d) <= reach * reach)
+                    visible.push_back((uint32_t) i);
+            }
+#endif
+            unpad(count);
+        }
+
+    private:
+        std::vector<float> m_X, m_Y, m_Z, m_Radius;
+
+        // rounds the arrays up to a whole group of four, the extra lanes are ignored by appendVisible
+        void pad() {
+            while (m_X.size() % 4)
+                add(glm::vec3(0.0f), 0.0f);
+        }
+
+        void unpad(size_t count) {
+            m_X.resize(count);
+            m_Y.resize(count);
+            m_Z.resize(count);
+            m_Radius.resize(count);
+        }
+
+        static void appendVisible(int mask, size_t first, size_t count, std::vector<uint32_t> &visible) {
+            for (int lane = 0; lane < 4 && first + lane < count; ++lane)
+                if (mask & (1 << lane))
+                    visible.push_back((uint32_t) (first + lane));
+        }
+    };
+
+};
+
+#endif //PROJECT_BASE_CULLING_H
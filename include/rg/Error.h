@@ -11,21 +11,14 @@
 #define LOG(stream) stream << "[" << __FILE__ << ", " << __func__ << ", " << __LINE__ << "] "
 #define BREAK_IF_FALSE(x) if (!(x)) __builtin_trap()
 #define ASSERT(x, msg) do { if (!(x)) { std::cerr << msg << '\n'; BREAK_IF_FALSE(false); } } while(0)
-#define GLCALL(x) \
-do{ rg::clearAllOpenGlErrors(); x; BREAK_IF_FALSE(rg::wasPreviousOpenGLCallSuccessful(__FILE__, __LINE__, #x)); } while (0)
+// GL errors aren't polled with glGetError after each call, which waits for the GPU. builds configured with
+// -DRG_GL_INSTRUMENTATION report them through KHR_debug, see rg/GLInstrumentation.h
 
 namespace rg {
 
     
-void clearAllOpenGlErrors();
 const char* openGLErrorToString(GLenum error);
-bool wasPreviousOpenGLCallSuccessful(const char* file, int line, const char* call);
 
-    void clearAllOpenGlErrors() {
-        while (glGetError() != GL_NO_ERROR) {
-            ;
-        }
-    }
     const char* openGLErrorToString(GLenum error) {
         switch(error) {
             case GL_NO_ERROR: return "GL_NO_ERROR";
@@ -37,18 +30,6 @@ bool wasPreviousOpenGLCallSuccessful(const char* file, int line, const char* cal
         ASSERT(false, "Passed something that is not an error code");
         return "THIS_SHOULD_NEVER_HAPPEN";
     }
-    bool wasPreviousOpenGLCallSuccessful(const char* file, int line, const char* call) {
-        bool success = true;
-        while (GLenum error = glGetError()) {
-            std::cerr << "[OpenGL error] " << error << " " << openGLErrorToString(error)
-            << "\nFile: " << file
-            << "\nLine: " << line
-            << "\nCall: " << call
-            << "\n\n";
-            success = false;
-        }
-        return success;
-    }
 
 };
 #endif //PROJECT_BASE_ERROR_H
@@ -0,0 +1,70 @@
+#ifndef PROJECT_BASE_GLEXTENSIONS_H
+#define PROJECT_BASE_GLEXTENSIONS_H
+
+#include <glad/glad.h>
+
+#include <cstring>
+#include <string>
+#include <unordered_set>
+
+// glad is generated for core 3.3 without extensions, tokens of the extensions we use are defined here.
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#define GL_COMPRESSED_RGBA_S3TC_DXT1_EXT 0x83F1
+#define GL_COMPRESSED_RGBA_S3TC_DXT3_EXT 0x83F2
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_RGBA_BPTC_UNORM
+#define GL_COMPRESSED_RGBA_BPTC_UNORM 0x8E8C
+#endif
+
+namespace rg {
+
+    // queries the extension list of the current context once, must be called with a context current.
+    inline bool hasGLExtension(const char *name) {
+        static std::unordered_set<std::string> extensions;
+        static bool queried = false;
+        if (!queried) {
+            GLint count = 0;
+            glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+            for (GLint i = 0; i < count; ++i)
+                extensions.insert(reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i)));
+            queried = true;
+        }
+        return extensions.count(name) != 0;
+    }
+
+    inline bool hasGLVersion(int major, int minor) {
+        return GLVersion.major > major || (GLVersion.major == major && GLVersion.minor >= minor);
+    }
+
+    // the shader define that enables writing gl_Layer from a vertex shader (see shadow.vs), nullptr when the
+    // driver can't and layered targets need a geometry shader or one pass per layer
+    inline const char* vertexLayerDefine() {
+        if (hasGLExtension("GL_ARB_shader_viewport_layer_array"))
+            return "VERTEX_LAYER_ARB";
+        if (hasGLExtension("GL_AMD_vertex_shader_layer"))
+            return "VERTEX_LAYER_AMD";
+        return nullptr;
+    }
+
+    // whether textures of the given compressed internal format can be uploaded with glCompressedTexImage2D.
+    inline bool isCompressedFormatSupported(GLenum internalFormat) {
+        switch (internalFormat) {
+            case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+            case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+            case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
+            case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+                return hasGLExtension("GL_EXT_texture_compression_s3tc");
+            case GL_COMPRESSED_RED_RGTC1:
+            case GL_COMPRESSED_RG_RGTC2:
+                return true; // core since 3.0
+            case GL_COMPRESSED_RGBA_BPTC_UNORM:
+                return hasGLVersion(4, 2) || hasGLExtension("GL_ARB_texture_compression_bptc");
+        }
+        return false;
+    }
+
+};
+
+#endif //PROJECT_BASE_GLEXTENSIONS_H
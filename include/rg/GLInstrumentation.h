@@ -0,0 +1,438 @@
+#ifndef PROJECT_BASE_GLINSTRUMENTATION_H
+#define PROJECT_BASE_GLINSTRUMENTATION_H
+
+#include <glad/glad.h>
+
+#include <rg/GLExtensions.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#ifndef GL_DEBUG_OUTPUT
+#define GL_DEBUG_OUTPUT 0x92E0
+#define GL_DEBUG_TYPE_ERROR 0x824C
+#define GL_DEBUG_SEVERITY_HIGH 0x9146
+#define GL_DEBUG_SEVERITY_MEDIUM 0x9147
+#define GL_DEBUG_SEVERITY_NOTIFICATION 0x826B
+#endif
+
+// Counts of what the program asks from GL, per frame and per pass, in builds configured with
+// -DRG_GL_INSTRUMENTATION=ON. install() swaps glad's pointers of the draw, upload and state entry points for
+// wrappers that count and forward, so every caller is counted (ImGui's backend too) without wrapping the call
+// sites in a macro. Errors come from KHR_debug output: asynchronous, so the driver reports them when it gets to them
+// instead of every checked call waiting for glGetError. An asynchronous message can't be tied to the call that
+// caused it, so it is reported with the frame it arrived in but no call site.
+//
+// Without the option every method is an empty inline and the wrappers aren't compiled.
+namespace rg {
+
+    struct GLCallStats {
+        unsigned int drawCalls = 0;
+        uint64_t triangles = 0;         // across all instances
+        unsigned int stateChanges = 0;  // binds, enables and the fixed function state that reached GL
+        unsigned int bufferUploads = 0;
+        unsigned int textureUploads = 0;
+        uint64_t uploadBytes = 0;
+
+        GLCallStats operator-(const GLCallStats &other) const {
+            GLCallStats difference;
+            difference.drawCalls = drawCalls - other.drawCalls;
+            difference.triangles = triangles - other.triangles;
+            difference.stateChanges = stateChanges - other.stateChanges;
+            difference.bufferUploads = bufferUploads - other.bufferUploads;
+            difference.textureUploads = textureUploads - other.textureUploads;
+            difference.uploadBytes = uploadBytes - other.uploadBytes;
+            return difference;
+        }
+
+        void add(const GLCallStats &other) {
+            drawCalls += other.drawCalls;
+            triangles += other.triangles;
+            stateChanges += other.stateChanges;
+            bufferUploads += other.bufferUploads;
+            textureUploads += other.textureUploads;
+            uploadBytes += other.uploadBytes;
+        }
+    };
+
+    struct GLPassStats {
+        const char *name;
+        GLCallStats stats;      // including the passes nested in it
+    };
+
+    class GLInstrumentation {
+    public:
+        static GLInstrumentation& instance() {
+            static GLInstrumentation instrumentation;
+            return instrumentation;
+        }
+
+        // call once with the context current and glad loaded, load resolves the KHR_debug entry points glad's
+        // core 3.3 profile doesn't have. installing twice would make the wrappers forward to themselves.
+        void install(GLADloadproc load) {
+#ifdef RG_GL_INSTRUMENTATION
+            if (m_Installed)
+                return;
+            m_Installed = true;
+            installWrappers();
+            installDebugOutput(load);
+#endif
+        }
+
+        // starts counting a new frame, the finished one stays readable through lastFrame() and lastFramePasses()
+        void beginFrame() {
+#ifdef RG_GL_INSTRUMENTATION
+            m_LastFrame = m_Frame;
+            m_LastPasses.swap(m_Passes);
+            m_Frame = GLCallStats();
+            m_Passes.clear();
+            m_Open.clear();
+            m_LastDebugMessages = m_DebugMessages.exchange(0, std::memory_order_relaxed);
+#endif
+        }
+
+        // name has to outlive the frame, a pass that runs more than once a frame is summed up
+        void beginPass(const char *name) {
+#ifdef RG_GL_INSTRUMENTATION
+            m_Open.push_back(OpenPass{name, m_Frame});
+#endif
+        }
+
+        void endPass() {
+#ifdef RG_GL_INSTRUMENTATION
+            if (m_Open.empty())
+                return;
+            const OpenPass &open = m_Open.back();
+            GLCallStats stats = m_Frame - open.start;
+            bool found = false;
+            for (GLPassStats &pass : m_Passes)
+                if (std::strcmp(pass.name, open.name) == 0) {
+                    pass.stats.add(stats);
+                    found = true;
+                }
+            if (!found)
+                m_Passes.push_back(GLPassStats{open.name, stats});
+            m_Open.pop_back();
+#endif
+        }
+
+        static bool enabled() {
+#ifdef RG_GL_INSTRUMENTATION
+            return true;
+#else
+            return false;
+#endif
+        }
+
+        bool debugOutput() const { return m_DebugOutput; }
+        const GLCallStats& lastFrame() const { return m_LastFrame; }
+        const std::vector<GLPassStats>& lastFramePasses() const { return m_LastPasses; }
+        // debug messages of error type or high and medium severity during the last frame
+        unsigned int lastFrameDebugMessages() const { return m_LastDebugMessages; }
+
+    private:
+        struct OpenPass {
+            const char *name;
+            GLCallStats start;
+        };
+
+        GLCallStats m_Frame, m_LastFrame;
+        std::vector<GLPassStats> m_Passes, m_LastPasses;
+        std::vector<OpenPass> m_Open;
+        bool m_Installed = false;
+        bool m_DebugOutput = false;
+        // the debug callback may run on a driver thread
+        std::atomic<unsigned int> m_DebugMessages{0};
+        unsigned int m_LastDebugMessages = 0;
+
+        GLInstrumentation() = default;
+
+#ifdef RG_GL_INSTRUMENTATION
+        // the entry points glad loaded, the wrappers forward to them
+        struct Real {
+            PFNGLDRAWARRAYSPROC drawArrays;
+            PFNGLDRAWARRAYSINSTANCEDPROC drawArraysInstanced;
+            PFNGLDRAWELEMENTSPROC drawElements;
+            PFNGLDRAWELEMENTSINSTANCEDPROC drawElementsInstanced;
+            PFNGLDRAWELEMENTSBASEVERTEXPROC drawElementsBaseVertex;
+            PFNGLDRAWELEMENTSINSTANCEDBASEVERTEXPROC drawElementsInstancedBaseVertex;
+            PFNGLBUFFERDATAPROC bufferData;
+            PFNGLBUFFERSUBDATAPROC bufferSubData;
+            PFNGLTEXIMAGE2DPROC texImage2D;
+            PFNGLTEXIMAGE3DPROC texImage3D;
+            PFNGLTEXSUBIMAGE2DPROC texSubImage2D;
+            PFNGLCOMPRESSEDTEXIMAGE2DPROC compressedTexImage2D;
+            PFNGLUSEPROGRAMPROC useProgram;
+            PFNGLBINDVERTEXARRAYPROC bindVertexArray;
+            PFNGLBINDTEXTUREPROC bindTexture;
+            PFNGLACTIVETEXTUREPROC activeTexture;
+            PFNGLBINDFRAMEBUFFERPROC bindFramebuffer;
+            PFNGLBINDBUFFERPROC bindBuffer;
+            PFNGLENABLEPROC enable;
+            PFNGLDISABLEPROC disable;
+            PFNGLVIEWPORTPROC viewport;
+            PFNGLSCISSORPROC scissor;
+            PFNGLDEPTHFUNCPROC depthFunc;
+            PFNGLCULLFACEPROC cullFace;
+            PFNGLBLENDFUNCPROC blendFunc;
+        };
+
+        static Real& real() {
+            static Real functions;
+            return functions;
+        }
+
+        static GLCallStats& frame() {
+            return instance().m_Frame;
+        }
+
+        static uint64_t triangles(GLenum mode, GLsizei count) {
+            switch (mode) {
+                case GL_TRIANGLES: return (uint64_t) count / 3;
+                case GL_TRIANGLE_STRIP:
+                case GL_TRIANGLE_FAN: return count > 2 ? (uint64_t) count - 2 : 0;
+            }
+            return 0;
+        }
+
+        static void countDraw(GLenum mode, GLsizei count, GLsizei instances) {
+            GLCallStats &stats = frame();
+            stats.drawCalls++;
+            stats.triangles += triangles(mode, count) * (uint64_t) instances;
+        }
+
+        // ignores the unpack alignment, good enough for counting
+        static uint64_t pixelBytes(GLenum format, GLenum type) {
+            unsigned int components = 4;
+            switch (format) {
+                case GL_RED: case GL_DEPTH_COMPONENT: case GL_RED_INTEGER: components = 1; break;
+                case GL_RG: case GL_RG_INTEGER: components = 2; break;
+                case GL_RGB: case GL_BGR: case GL_RGB_INTEGER: components = 3; break;
+                case GL_DEPTH_STENCIL: return type == GL_FLOAT_32_UNSIGNED_INT_24_8_REV ? 8 : 4;
+            }
+            switch (type) {
+                case GL_UNSIGNED_BYTE: case GL_BYTE: return components;
+                case GL_UNSIGNED_SHORT: case GL_SHORT: case GL_HALF_FLOAT: return components * 2;
+                case GL_UNSIGNED_INT_8_8_8_8: case GL_UNSIGNED_INT_8_8_8_8_REV: case GL_UNSIGNED_INT_2_10_10_10_REV: return 4;
+            }
+            return components * 4;
+        }
+
+        static void countBufferUpload(GLsizeiptr size, const void *data) {
+            // glBufferData without data only allocates or orphans
+            if (!data)
+                return;
+            GLCallStats &stats = frame();
+            stats.bufferUploads++;
+            stats.uploadBytes += (uint64_t) size;
+        }
+
+        static void countTextureUpload(uint64_t bytes, const void *pixels) {
+            // without pixels (or from a bound unpack buffer) nothing comes from the client
+            if (!pixels)
+                return;
+            GLCallStats &stats = frame();
+            stats.textureUploads++;
+            stats.uploadBytes += bytes;
+        }
+
+        static void countStateChange() {
+            frame().stateChanges++;
+        }
+
+        static void APIENTRY drawArrays(GLenum mode, GLint first, GLsizei count) {
+            countDraw(mode, count, 1);
+            real().drawArrays(mode, first, count);
+        }
+
+        static void APIENTRY drawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instances) {
+            countDraw(mode, count, instances);
+            real().drawArraysInstanced(mode, first, count, instances);
+        }
+
+        static void APIENTRY drawElements(GLenum mode, GLsizei count, GLenum type, const void *indices) {
+            countDraw(mode, count, 1);
+            real().drawElements(mode, count, type, indices);
+        }
+
+        static void APIENTRY drawElementsInstanced(GLenum mode, GLsizei count, GLenum type, const void *indices, GLsizei instances) {
+            countDraw(mode, count, instances);
+            real().drawElementsInstanced(mode, count, type, indices, instances);
+        }
+
+        static void APIENTRY drawElementsBaseVertex(GLenum mode, GLsizei count, GLenum type, const void *indices, GLint baseVertex) {
+            countDraw(mode, count, 1);
+            real().drawElementsBaseVertex(mode, count, type, indices, baseVertex);
+        }
+
+        static void APIENTRY drawElementsInstancedBaseVertex(GLenum mode, GLsizei count, GLenum type, const void *indices,
+                                                             GLsizei instances, GLint baseVertex) {
+            countDraw(mode, count, instances);
+            real().drawElementsInstancedBaseVertex(mode, count, type, indices, instances, baseVertex);
+        }
+
+        static void APIENTRY bufferData(GLenum target, GLsizeiptr size, const void *data, GLenum usage) {
+            countBufferUpload(size, data);
+            real().bufferData(target, size, data, usage);
+        }
+
+        static void APIENTRY bufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void *data) {
+            countBufferUpload(size, data);
+            real().bufferSubData(target, offset, size, data);
+        }
+
+        static void APIENTRY texImage2D(GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height,
+                                        GLint border, GLenum format, GLenum type, const void *pixels) {
+            countTextureUpload((uint64_t) width * height * pixelBytes(format, type), pixels);
+            real().texImage2D(target, level, internalFormat, width, height, border, format, type, pixels);
+        }
+
+        static void APIENTRY texImage3D(GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height,
+                                        GLsizei depth, GLint border, GLenum format, GLenum type, const void *pixels) {
+            countTextureUpload((uint64_t) width * height * depth * pixelBytes(format, type), pixels);
+            real().texImage3D(target, level, internalFormat, width, height, depth, border, format, type, pixels);
+        }
+
+        static void APIENTRY texSubImage2D(GLenum target, GLint level, GLint x, GLint y, GLsizei width, GLsizei height,
+                                           GLenum format, GLenum type, const void *pixels) {
+            countTextureUpload((uint64_t) width * height * pixelBytes(format, type), pixels);
+            real().texSubImage2D(target, level, x, y, width, height, format, type, pixels);
+        }
+
+        static void APIENTRY compressedTexImage2D(GLenum target, GLint level, GLenum internalFormat, GLsizei width,
+                                                  GLsizei height, GLint border, GLsizei imageSize, const void *data) {
+            countTextureUpload((uint64_t) imageSize, data);
+            real().compressedTexImage2D(target, level, internalFormat, width, height, border, imageSize, data);
+        }
+
+        static void APIENTRY useProgram(GLuint program) {
+            countStateChange();
+            real().useProgram(program);
+        }
+
+        static void APIENTRY bindVertexArray(GLuint vao) {
+            countStateChange();
+            real().bindVertexArray(vao);
+        }
+
+        static void APIENTRY bindTexture(GLenum target, GLuint texture) {
+            countStateChange();
+            real().bindTexture(target, texture);
+        }
+
+        static void APIENTRY activeTexture(GLenum unit) {
+            countStateChange();
+            real().activeTexture(unit);
+        }
+
+        static void APIENTRY bindFramebuffer(GLenum target, GLuint framebuffer) {
+            countStateChange();
+            real().bindFramebuffer(target, framebuffer);
+        }
+
+        static void APIENTRY bindBuffer(GLenum target, GLuint buffer) {
+            countStateChange();
+            real().bindBuffer(target, buffer);
+        }
+
+        static void APIENTRY enable(GLenum capability) {
+            countStateChange();
+            real().enable(capability);
+        }
+
+        static void APIENTRY disable(GLenum capability) {
+            countStateChange();
+            real().disable(capability);
+        }
+
+        static void APIENTRY viewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+            countStateChange();
+            real().viewport(x, y, width, height);
+        }
+
+        static void APIENTRY scissor(GLint x, GLint y, GLsizei width, GLsizei height) {
+            countStateChange();
+            real().scissor(x, y, width, height);
+        }
+
+        static void APIENTRY depthFunc(GLenum function) {
+            countStateChange();
+            real().depthFunc(function);
+        }
+
+        static void APIENTRY cullFace(GLenum face) {
+            countStateChange();
+            real().cullFace(face);
+        }
+
+        static void APIENTRY blendFunc(GLenum source, GLenum destination) {
+            countStateChange();
+            real().blendFunc(source, destination);
+        }
+
+        void installWrappers() {
+            Real &functions = real();
+#define RG_GL_WRAP(name, wrapper) functions.wrapper = glad_##name; glad_##name = &GLInstrumentation::wrapper
+            RG_GL_WRAP(glDrawArrays, drawArrays);
+            RG_GL_WRAP(glDrawArraysInstanced, drawArraysInstanced);
+            RG_GL_WRAP(glDrawElements, drawElements);
+            RG_GL_WRAP(glDrawElementsInstanced, drawElementsInstanced);
+            RG_GL_WRAP(glDrawElementsBaseVertex, drawElementsBaseVertex);
+            RG_GL_WRAP(glDrawElementsInstancedBaseVertex, drawElementsInstancedBaseVertex);
+            RG_GL_WRAP(glBufferData, bufferData);
+            RG_GL_WRAP(glBufferSubData, bufferSubData);
+            RG_GL_WRAP(glTexImage2D, texImage2D);
+            RG_GL_WRAP(glTexImage3D, texImage3D);
+            RG_GL_WRAP(glTexSubImage2D, texSubImage2D);
+            RG_GL_WRAP(glCompressedTexImage2D, compressedTexImage2D);
+            RG_GL_WRAP(glUseProgram, useProgram);
+            RG_GL_WRAP(glBindVertexArray, bindVertexArray);
+            RG_GL_WRAP(glBindTexture, bindTexture);
+            RG_GL_WRAP(glActiveTexture, activeTexture);
+            RG_GL_WRAP(glBindFramebuffer, bindFramebuffer);
+            RG_GL_WRAP(glBindBuffer, bindBuffer);
+            RG_GL_WRAP(glEnable, enable);
+            RG_GL_WRAP(glDisable, disable);
+            RG_GL_WRAP(glViewport, viewport);
+            RG_GL_WRAP(glScissor, scissor);
+            RG_GL_WRAP(glDepthFunc, depthFunc);
+            RG_GL_WRAP(glCullFace, cullFace);
+            RG_GL_WRAP(glBlendFunc, blendFunc);
+#undef RG_GL_WRAP
+        }
+
+        static void APIENTRY debugMessage(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length,
+                                          const GLchar *message, const void *user) {
+            if (type != GL_DEBUG_TYPE_ERROR && severity != GL_DEBUG_SEVERITY_HIGH && severity != GL_DEBUG_SEVERITY_MEDIUM)
+                return;
+            GLInstrumentation &instrumentation = *(GLInstrumentation*) user;
+            instrumentation.m_DebugMessages.fetch_add(1, std::memory_order_relaxed);
+            std::cerr << "[OpenGL " << (type == GL_DEBUG_TYPE_ERROR ? "error" : "warning") << "] " << message << '\n';
+        }
+
+        // debug output without GL_DEBUG_OUTPUT_SYNCHRONOUS, the driver doesn't have to serialize for it. contexts
+        // created without the debug flag may report less.
+        void installDebugOutput(GLADloadproc load) {
+            if (!load || (!hasGLVersion(4, 3) && !hasGLExtension("GL_KHR_debug"))) {
+                std::cout << "KHR_debug isn't available, GL errors aren't reported" << std::endl;
+                return;
+            }
+            typedef void (APIENTRY *DebugMessageCallback)(GLDEBUGPROC callback, const void *user);
+            auto debugMessageCallback = (DebugMessageCallback) load("glDebugMessageCallback");
+            if (!debugMessageCallback)
+                debugMessageCallback = (DebugMessageCallback) load("glDebugMessageCallbackKHR");
+            if (!debugMessageCallback)
+                return;
+            debugMessageCallback(&GLInstrumentation::debugMessage, this);
+            real().enable(GL_DEBUG_OUTPUT);
+            m_DebugOutput = true;
+        }
+#endif
+    };
+
+};
+
+#endif //PROJECT_BASE_GLINSTRUMENTATION_H
@@ -0,0 +1,227 @@
+#ifndef PROJECT_BASE_GLSTATE_H
+#define PROJECT_BASE_GLSTATE_H
+
+#include <glad/glad.h>
+
+// Shadow copy of the GL state the renderer changes per draw. Binds and enables go through it and are only
+// passed on to the driver when they change something, the rest are counted as elided. The copy is only right
+// while nothing calls GL behind its back: code that does (ImGui) is followed by invalidate(), and deleted
+// objects are reported so a reused name isn't taken for the one still "bound".
+namespace rg {
+
+    struct GLStateStats {
+        unsigned int issued = 0;
+        unsigned int elided = 0;
+    };
+
+    class GLState {
+    public:
+        static const unsigned int MAX_TEXTURE_UNITS = 32;
+
+        static GLState& instance() {
+            static GLState state;
+            return state;
+        }
+
+        // starts counting a new frame, the counts of the finished one stay readable through lastFrame()
+        void beginFrame() {
+            m_LastFrame = m_Frame;
+            m_Frame = GLStateStats();
+        }
+
+        const GLStateStats& lastFrame() const { return m_LastFrame; }
+
+        // forgets everything, the next call of each kind reaches the driver again
+        void invalidate() {
+            m_Program = m_VertexArray = m_Framebuffer = UNKNOWN;
+            m_ActiveUnit = UNKNOWN;
+            for (auto &unit : m_Textures)
+                for (unsigned int &texture : unit)
+                    texture = UNKNOWN;
+            for (int &enabled : m_Capabilities)
+                enabled = -1;
+            m_CullFace = m_DepthFunc = UNKNOWN;
+            m_ViewportValid = false;
+        }
+
+        void useProgram(unsigned int program) {
+            if (changed(m_Program, program))
+                glUseProgram(program);
+        }
+
+        void bindVertexArray(unsigned int vertexArray) {
+            if (changed(m_VertexArray, vertexArray))
+                glBindVertexArray(vertexArray);
+        }
+
+        // 0 stands for the framebuffer frames are presented from, see setDefaultFramebuffer
+        void bindFramebuffer(unsigned int framebuffer) {
+            if (framebuffer == 0)
+                framebuffer = m_DefaultFramebuffer;
+            if (changed(m_Framebuffer, framebuffer))
+                glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        }
+
+        // a headless context has no window framebuffer, it renders into an FBO that binding 0 is redirected to
+        void setDefaultFramebuffer(unsigned int framebuffer) {
+            m_DefaultFramebuffer = framebuffer;
+            m_Framebuffer = UNKNOWN;
+        }
+
+        // unit is the index (0, 1, ...), not GL_TEXTUREi
+        void activeTexture(unsigned int unit) {
+            if (changed(m_ActiveUnit, unit))
+                glActiveTexture(GL_TEXTURE0 + unit);
+        }
+
+        // binds the texture to unit, switching the active unit only when the binding changes
+        void bindTexture(unsigned int unit, GLenum target, unsigned int texture) {
+            int slot = targetSlot(target);
+            if (unit >= MAX_TEXTURE_UNITS || slot < 0) {
+                activeTexture(unit);
+                issue();
+                glBindTexture(target, texture);
+                return;
+            }
+            if (m_Textures[unit][slot] == texture) {
+                m_Frame.elided++;
+                return;
+            }
+            activeTexture(unit);
+            m_Textures[unit][slot] = texture;
+            issue();
+            glBindTexture(target, texture);
+        }
+
+        // binds on whatever unit is active, for creating and uploading textures
+        void bindTexture(GLenum target, unsigned int texture) {
+            bindTexture(m_ActiveUnit == UNKNOWN ? 0 : m_ActiveUnit, target, texture);
+        }
+
+        void enable(GLenum capability) {
+            setCapability(capability, true);
+        }
+
+        void disable(GLenum capability) {
+            setCapability(capability, false);
+        }
+
+        void cullFace(GLenum mode) {
+            if (changed(m_CullFace, mode))
+                glCullFace(mode);
+        }
+
+        void depthFunc(GLenum func) {
+            if (changed(m_DepthFunc, func))
+                glDepthFunc(func);
+        }
+
+        void viewport(int x, int y, int width, int height) {
+            if (m_ViewportValid && m_Viewport[0] == x && m_Viewport[1] == y && m_Viewport[2] == width && m_Viewport[3] == height) {
+                m_Frame.elided++;
+                return;
+            }
+            m_Viewport[0] = x;
+            m_Viewport[1] = y;
+            m_Viewport[2] = width;
+            m_Viewport[3] = height;
+            m_ViewportValid = true;
+            issue();
+            glViewport(x, y, width, height);
+        }
+
+        // GL unbinds deleted objects, a new object may get the same name
+        void textureDeleted(unsigned int texture) {
+            for (auto &unit : m_Textures)
+                for (unsigned int &bound : unit)
+                    if (bound == texture)
+                        bound = 0;
+        }
+
+        void vertexArrayDeleted(unsigned int vertexArray) {
+            if (m_VertexArray == vertexArray)
+                m_VertexArray = 0;
+        }
+
+        void framebufferDeleted(unsigned int framebuffer) {
+            if (m_Framebuffer == framebuffer)
+                m_Framebuffer = 0;
+            if (m_DefaultFramebuffer == framebuffer)
+                m_DefaultFramebuffer = 0;
+        }
+
+    private:
+        static const unsigned int UNKNOWN = 0xffffffffu;
+        static const unsigned int TARGET_COUNT = 4;
+        static const unsigned int CAPABILITY_COUNT = 5;
+
+        unsigned int m_Program = UNKNOWN, m_VertexArray = UNKNOWN, m_Framebuffer = UNKNOWN;
+        unsigned int m_DefaultFramebuffer = 0;
+        unsigned int m_ActiveUnit = UNKNOWN;
+        unsigned int m_Textures[MAX_TEXTURE_UNITS][TARGET_COUNT];
+        int m_Capabilities[CAPABILITY_COUNT];     // -1 unknown, 0 disabled, 1 enabled
+        unsigned int m_CullFace = UNKNOWN, m_DepthFunc = UNKNOWN;
+        int m_Viewport[4] = {0, 0, 0, 0};
+        bool m_ViewportValid = false;
+        GLStateStats m_Frame, m_LastFrame;
+
+        GLState() {
+            invalidate();
+        }
+
+        void issue() {
+            m_Frame.issued++;
+        }
+
+        // updates the shadow copy, true when the call has to reach the driver
+        bool changed(unsigned int &current, unsigned int value) {
+            if (current == value) {
+                m_Frame.elided++;
+                return false;
+            }
+            current = value;
+            issue();
+            return true;
+        }
+
+        static int targetSlot(GLenum target) {
+            switch (target) {
+                case GL_TEXTURE_2D: return 0;
+                case GL_TEXTURE_CUBE_MAP: return 1;
+                case GL_TEXTURE_2D_ARRAY: return 2;
+                case GL_TEXTURE_BUFFER: return 3;
+                default: return -1;
+            }
+        }
+
+        static int capabilitySlot(GLenum capability) {
+            switch (capability) {
+                case GL_DEPTH_TEST: return 0;
+                case GL_CULL_FACE: return 1;
+                case GL_BLEND: return 2;
+                case GL_STENCIL_TEST: return 3;
+                case GL_SCISSOR_TEST: return 4;
+                default: return -1;
+            }
+        }
+
+        void setCapability(GLenum capability, bool enabled) {
+            int slot = capabilitySlot(capability);
+            if (slot >= 0) {
+                if (m_Capabilities[slot] == (int) enabled) {
+                    m_Frame.elided++;
+                    return;
+                }
+                m_Capabilities[slot] = (int) enabled;
+            }
+            issue();
+            if (enabled)
+                glEnable(capability);
+            else
+                glDisable(capability);
+        }
+    };
+
+};
+
+#endif //PROJECT_BASE_GLSTATE_H
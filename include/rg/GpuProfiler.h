@@ -0,0 +1,167 @@
+#ifndef PROJECT_BASE_GPUPROFILER_H
+#define PROJECT_BASE_GPUPROFILER_H
+
+#include <glad/glad.h>
+
+#include <cstring>
+#include <vector>
+
+// GPU time per render pass. begin and end put a GL_TIMESTAMP query into the command stream, so scopes can nest
+// and the measured time is what the GPU spent between the two points. The queries of a frame are read back
+// FRAMES_IN_FLIGHT frames later; if the GPU hasn't finished that frame yet its results are dropped instead of
+// waiting, so the profiler never stalls the pipeline.
+//
+//   rg::GpuProfiler &profiler = rg::GpuProfiler::instance();
+//   profiler.beginFrame();
+//   profiler.begin("Shadows");
+//   ...
+//   profiler.end();
+//
+// Every scope keeps the average over the last AVERAGE_FRAMES frames it was read back for. A scope that didn't run
+// in a frame counts as 0 for it, so the averages of the passes that only run now and then are what they cost a
+// frame.
+namespace rg {
+
+    struct GpuScopeTiming {
+        const char *name;
+        unsigned int depth;     // of nesting, 0 for the outermost scopes
+        float averageMs;
+        float lastMs;
+    };
+
+    class GpuProfiler {
+    public:
+        static const unsigned int FRAMES_IN_FLIGHT = 3;
+        static const unsigned int AVERAGE_FRAMES = 60;
+
+        static GpuProfiler& instance() {
+            static GpuProfiler profiler;
+            return profiler;
+        }
+
+        // reads back the frame that used this frame's queries before, if the GPU is done with it
+        void beginFrame() {
+            m_Slot = (m_Slot + 1) % FRAMES_IN_FLIGHT;
+            Frame &frame = m_Frames[m_Slot];
+            if (frame.usedQueries > 0) {
+                GLint available = 0;
+                glGetQueryObjectiv(frame.queries[frame.usedQueries - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+                if (available)
+                    readBack(frame);
+                else
+                    m_DroppedFrames++;
+            }
+            frame.scopes.clear();
+            frame.usedQueries = 0;
+            m_Stack.clear();
+        }
+
+        // name has to outlive the profiler, scopes are told apart by it
+        void begin(const char *name) {
+            Frame &frame = m_Frames[m_Slot];
+            Scope scope;
+            scope.timing = timingIndex(name, (unsigned int) m_Stack.size());
+            scope.beginQuery = nextQuery(frame);
+            scope.endQuery = 0;
+            glQueryCounter(frame.queries[scope.beginQuery], GL_TIMESTAMP);
+            m_Stack.push_back((unsigned int) frame.scopes.size());
+            frame.scopes.push_back(scope);
+        }
+
+        void end() {
+            Frame &frame = m_Frames[m_Slot];
+            Scope &scope = frame.scopes[m_Stack.back()];
+            m_Stack.pop_back();
+            scope.endQuery = nextQuery(frame);
+            glQueryCounter(frame.queries[scope.endQuery], GL_TIMESTAMP);
+        }
+
+        // in the order the scopes first ran
+        const std::vector<GpuScopeTiming>& timings() const { return m_Timings; }
+        // frames whose results weren't ready in time
+        unsigned int droppedFrames() const { return m_DroppedFrames; }
+
+        // deletes the queries, the profiler can't be used after it
+        void shutdown() {
+            for (Frame &frame : m_Frames) {
+                if (!frame.queries.empty())
+                    glDeleteQueries((GLsizei) frame.queries.size(), frame.queries.data());
+                frame.queries.clear();
+                frame.scopes.clear();
+            }
+        }
+
+    private:
+        struct Scope {
+            unsigned int timing;
+            unsigned int beginQuery, endQuery;
+        };
+
+        struct Frame {
+            std::vector<unsigned int> queries;
+            unsigned int usedQueries = 0;
+            std::vector<Scope> scopes;
+        };
+
+        // the samples of one timing, a ring of the last AVERAGE_FRAMES
+        struct History {
+            float samples[AVERAGE_FRAMES] = {};
+            unsigned int next = 0, count = 0;
+            float sum = 0.0f;
+        };
+
+        Frame m_Frames[FRAMES_IN_FLIGHT];
+        unsigned int m_Slot = 0;
+        std::vector<unsigned int> m_Stack;
+        std::vector<GpuScopeTiming> m_Timings;
+        std::vector<History> m_Histories;
+        std::vector<float> m_FrameTimes;
+        unsigned int m_DroppedFrames = 0;
+
+        GpuProfiler() = default;
+
+        unsigned int timingIndex(const char *name, unsigned int depth) {
+            for (unsigned int i = 0; i < m_Timings.size(); ++i)
+                if (m_Timings[i].name == name || std::strcmp(m_Timings[i].name, name) == 0)
+                    return i;
+            m_Timings.push_back(GpuScopeTiming{name, depth, 0.0f, 0.0f});
+            m_Histories.emplace_back();
+            return (unsigned int) m_Timings.size() - 1;
+        }
+
+        // the queries of a frame are generated once and reused by every frame in the same slot
+        static unsigned int nextQuery(Frame &frame) {
+            if (frame.usedQueries == frame.queries.size()) {
+                frame.queries.push_back(0);
+                glGenQueries(1, &frame.queries.back());
+            }
+            return frame.usedQueries++;
+        }
+
+        // the queries of a frame finish in order, once the last one is available they all are
+        void readBack(const Frame &frame) {
+            m_FrameTimes.assign(m_Timings.size(), 0.0f);
+            for (const Scope &scope : frame.scopes) {
+                // a scope that was never ended, no query ends on index 0
+                if (scope.endQuery == 0)
+                    continue;
+                GLuint64 begin = 0, end = 0;
+                glGetQueryObjectui64v(frame.queries[scope.beginQuery], GL_QUERY_RESULT, &begin);
+                glGetQueryObjectui64v(frame.queries[scope.endQuery], GL_QUERY_RESULT, &end);
+                m_FrameTimes[scope.timing] += (end - begin) / 1.0e6f;
+            }
+            for (unsigned int i = 0; i < m_Timings.size(); ++i) {
+                History &history = m_Histories[i];
+                history.sum += m_FrameTimes[i] - history.samples[history.next];
+                history.samples[history.next] = m_FrameTimes[i];
+                history.next = (history.next + 1) % AVERAGE_FRAMES;
+                history.count = history.count < AVERAGE_FRAMES ? history.count + 1 : AVERAGE_FRAMES;
+                m_Timings[i].lastMs = m_FrameTimes[i];
+                m_Timings[i].averageMs = history.sum / history.count;
+            }
+        }
+    };
+
+};
+
+#endif //PROJECT_BASE_GPUPROFILER_H
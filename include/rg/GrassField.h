@@ -0,0 +1,108 @@
+#ifndef PROJECT_BASE_GRASSFIELD_H
+#define PROJECT_BASE_GRASSFIELD_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <rg/GLState.h>
+#include <rg/VertexPacking.h>
+
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+// Instanced grass: every blade is one instance of the blade quad, placed by a 16 byte per-instance record
+// that grass.vs (GRASS_INSTANCED) turns into a world position without any per-blade work on the CPU.
+namespace rg {
+
+    struct GrassInstance {
+        float position[3];      // world position of the blade's origin
+        uint16_t rotation;      // half float, radians around +y
+        uint16_t scale;         // half float, uniform
+    };
+
+    inline GrassInstance makeGrassInstance(const glm::vec3 &position, float rotation, float scale) {
+        GrassInstance instance;
+        instance.position[0] = position.x;
+        instance.position[1] = position.y;
+        instance.position[2] = position.z;
+        instance.rotation = floatToHalf(rotation);
+        instance.scale = floatToHalf(scale);
+        return instance;
+    }
+
+    // scatters blades uniformly over the square [-halfExtent, halfExtent]^2 at height y, density is in blades
+    // per square unit. blades within exclusionRadius of the center are skipped. the seed is fixed so the field
+    // looks the same on every run.
+    inline void scatterGrass(std::vector<GrassInstance> &out, float halfExtent, float y, float density,
+                             float exclusionRadius, float minScale, float maxScale, uint32_t seed = 1234) {
+        size_t count = (size_t) std::max(0.0f, density * 4.0f * halfExtent * halfExtent);
+        std::mt19937 random(seed);
+        std::uniform_real_distribution<float> coordinate(-halfExtent, halfExtent);
+        std::uniform_real_distribution<float> angle(0.0f, 6.2831853f);
+        std::uniform_real_distribution<float> scale(minScale, maxScale);
+        out.reserve(out.size() + count);
+        for (size_t i = 0; i < count; ++i) {
+            float x = coordinate(random), z = coordinate(random);
+            float rotation = angle(random), bladeScale = scale(random);
+            if (x * x + z * z < exclusionRadius * exclusionRadius)
+                continue;
+            out.push_back(makeGrassInstance(glm::vec3(x, y, z), rotation, bladeScale));
+        }
+    }
+
+    // owns the per-instance buffer and adds its attributes to the VAO of the blade quad.
+    class GrassField {
+    public:
+        static const unsigned int INSTANCE_POSITION_LOCATION = 3;
+        static const unsigned int INSTANCE_ROTATION_SCALE_LOCATION = 4;
+
+        ~GrassField() {
+            if (m_InstanceVBO)
+                glDeleteBuffers(1, &m_InstanceVBO);
+        }
+
+        void setup(unsigned int bladeVAO, unsigned int bladeVertexCount) {
+            m_VAO = bladeVAO;
+            m_VertexCount = bladeVertexCount;
+            glGenBuffers(1, &m_InstanceVBO);
+            GLState::instance().bindVertexArray(m_VAO);
+            glBindBuffer(GL_ARRAY_BUFFER, m_InstanceVBO);
+            glEnableVertexAttribArray(INSTANCE_POSITION_LOCATION);
+            glVertexAttribPointer(INSTANCE_POSITION_LOCATION, 3, GL_FLOAT, GL_FALSE, sizeof(GrassInstance),
+                                  (void*)offsetof(GrassInstance, position));
+            glVertexAttribDivisor(INSTANCE_POSITION_LOCATION, 1);
+            glEnableVertexAttribArray(INSTANCE_ROTATION_SCALE_LOCATION);
+            glVertexAttribPointer(INSTANCE_ROTATION_SCALE_LOCATION, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(GrassInstance),
+                                  (void*)offsetof(GrassInstance, rotation));
+            glVertexAttribDivisor(INSTANCE_ROTATION_SCALE_LOCATION, 1);
+            GLState::instance().bindVertexArray(0);
+        }
+
+        void setInstances(const std::vector<GrassInstance> &instances) {
+            glBindBuffer(GL_ARRAY_BUFFER, m_InstanceVBO);
+            glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(GrassInstance), instances.data(), GL_STATIC_DRAW);
+            m_InstanceCount = (unsigned int) instances.size();
+        }
+
+        // one draw call for the whole field, the caller binds the shader and the blade texture
+        void draw() const {
+            if (m_InstanceCount == 0)
+                return;
+            GLState::instance().bindVertexArray(m_VAO);
+            glDrawArraysInstanced(GL_TRIANGLES, 0, m_VertexCount, m_InstanceCount);
+        }
+
+        unsigned int instanceCount() const { return m_InstanceCount; }
+
+    private:
+        unsigned int m_VAO = 0;
+        unsigned int m_VertexCount = 0;
+        unsigned int m_InstanceVBO = 0;
+        unsigned int m_InstanceCount = 0;
+    };
+
+};
+
+#endif //PROJECT_BASE_GRASSFIELD_H
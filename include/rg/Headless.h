@@ -0,0 +1,199 @@
+#ifndef PROJECT_BASE_HEADLESS_H
+#define PROJECT_BASE_HEADLESS_H
+
+#include <glad/glad.h>
+
+#include <rg/CommandLine.h>
+#include <rg/GLState.h>
+
+#ifdef RG_HAVE_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Running without a display, for CI and the perf machines. The GL context comes from EGL without any surface
+// (EGL_MESA_platform_surfaceless where available, so Mesa's llvmpipe works without a GPU), frames go to an
+// offscreen framebuffer instead of a window, and the program stops after a fixed number of frames.
+//
+//   project_base --headless [--frames N] [--screenshot out.ppm]
+//
+// EGL is only compiled in when CMake finds it (RG_HAVE_EGL), without it --headless fails at startup.
+namespace rg {
+
+    struct HeadlessOptions {
+        bool enabled = false;
+        unsigned int frames = 300;
+        std::string screenshot;     // the last frame is written here as a binary PPM, if set
+    };
+
+    // parses argv[i], and its value at argv[i + 1] which then advances i
+    inline OptionResult parseHeadlessOption(int argc, char **argv, int &i, HeadlessOptions &options) {
+        if (std::strcmp(argv[i], "--headless") == 0) {
+            options.enabled = true;
+        } else if (std::strcmp(argv[i], "--frames") == 0) {
+            if (!hasOptionValue(argc, argv, i) || !parseCount("frame count", argv[++i], options.frames))
+                return OPTION_INVALID;
+        } else if (std::strcmp(argv[i], "--screenshot") == 0) {
+            if (!hasOptionValue(argc, argv, i))
+                return OPTION_INVALID;
+            options.screenshot = argv[++i];
+        } else {
+            return OPTION_UNKNOWN;
+        }
+        return OPTION_PARSED;
+    }
+
+    // a core profile context current on the calling thread, without any surface
+    class HeadlessContext {
+    public:
+        HeadlessContext() = default;
+
+        ~HeadlessContext() {
+#ifdef RG_HAVE_EGL
+            if (m_Display != EGL_NO_DISPLAY) {
+                eglMakeCurrent(m_Display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+                if (m_Context != EGL_NO_CONTEXT)
+                    eglDestroyContext(m_Display, m_Context);
+                eglTerminate(m_Display);
+            }
+#endif
+        }
+
+        HeadlessContext(const HeadlessContext&) = delete;
+        HeadlessContext& operator=(const HeadlessContext&) = delete;
+
+        // creates the context and loads the GL functions through glad, false and a message when either fails.
+        // debug asks for a debug context, which reports everything through KHR_debug.
+        bool create(int major, int minor, bool debug = false) {
+#ifdef RG_HAVE_EGL
+            // the surfaceless platform needs no display server at all, the default display is the fallback
+            auto getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+            const char *clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+            if (getPlatformDisplay && clientExtensions && std::strstr(clientExtensions, "EGL_MESA_platform_surfaceless"))
+                m_Display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+            if (m_Display == EGL_NO_DISPLAY)
+                m_Display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+            if (m_Display == EGL_NO_DISPLAY || !eglInitialize(m_Display, nullptr, nullptr)) {
+                std::cout << "Failed to initialize EGL" << std::endl;
+                m_Display = EGL_NO_DISPLAY;
+                return false;
+            }
+            const char *extensions = eglQueryString(m_Display, EGL_EXTENSIONS);
+            if (!extensions || !std::strstr(extensions, "EGL_KHR_surfaceless_context")) {
+                std::cout << "EGL display has no EGL_KHR_surfaceless_context" << std::endl;
+                return false;
+            }
+            if (!eglBindAPI(EGL_OPENGL_API)) {
+                std::cout << "EGL can't create desktop OpenGL contexts" << std::endl;
+                return false;
+            }
+            const EGLint configAttributes[] = {EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE};
+            EGLConfig config;
+            EGLint configCount = 0;
+            if (!eglChooseConfig(m_Display, configAttributes, &config, 1, &configCount) || configCount == 0) {
+                std::cout << "No EGL config for desktop OpenGL" << std::endl;
+                return false;
+            }
+            // the debug attribute is EGL 1.5, it's only passed when asked for
+            const EGLint contextAttributes[] = {
+                    EGL_CONTEXT_MAJOR_VERSION, major,
+                    EGL_CONTEXT_MINOR_VERSION, minor,
+                    EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+                    debug ? EGL_CONTEXT_OPENGL_DEBUG : EGL_NONE, EGL_TRUE,
+                    EGL_NONE
+            };
+            m_Context = eglCreateContext(m_Display, config, EGL_NO_CONTEXT, contextAttributes);
+            if (m_Context == EGL_NO_CONTEXT || !eglMakeCurrent(m_Display, EGL_NO_SURFACE, EGL_NO_SURFACE, m_Context)) {
+                std::cout << "Failed to create a surfaceless OpenGL " << major << "." << minor << " context" << std::endl;
+                return false;
+            }
+            if (!gladLoadGLLoader((GLADloadproc) eglGetProcAddress)) {
+                std::cout << "Failed to initialize GLAD" << std::endl;
+                return false;
+            }
+            return true;
+#else
+            std::cout << "Built without EGL, headless mode isn't available" << std::endl;
+            return false;
+#endif
+        }
+
+        // resolves GL entry points glad doesn't load, nullptr without EGL
+        GLADloadproc loader() const {
+#ifdef RG_HAVE_EGL
+            return (GLADloadproc) eglGetProcAddress;
+#else
+            return nullptr;
+#endif
+        }
+
+    private:
+#ifdef RG_HAVE_EGL
+        EGLDisplay m_Display = EGL_NO_DISPLAY;
+        EGLContext m_Context = EGL_NO_CONTEXT;
+#endif
+    };
+
+    // the color and depth buffers a headless run renders into, made the target of bindFramebuffer(0)
+    class OffscreenTarget {
+    public:
+        OffscreenTarget(unsigned int width, unsigned int height)
+                : m_Width(width), m_Height(height) {
+            glGenRenderbuffers(2, m_Renderbuffers);
+            glBindRenderbuffer(GL_RENDERBUFFER, m_Renderbuffers[0]);
+            glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+            glBindRenderbuffer(GL_RENDERBUFFER, m_Renderbuffers[1]);
+            glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+            glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+            glGenFramebuffers(1, &m_FBO);
+            GLState &state = GLState::instance();
+            state.setDefaultFramebuffer(m_FBO);
+            state.bindFramebuffer(0);
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_Renderbuffers[0]);
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, m_Renderbuffers[1]);
+            m_Complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+        }
+
+        ~OffscreenTarget() {
+            GLState::instance().framebufferDeleted(m_FBO);
+            glDeleteFramebuffers(1, &m_FBO);
+            glDeleteRenderbuffers(2, m_Renderbuffers);
+        }
+
+        OffscreenTarget(const OffscreenTarget&) = delete;
+        OffscreenTarget& operator=(const OffscreenTarget&) = delete;
+
+        bool complete() const { return m_Complete; }
+
+        // reads the color buffer back and writes it top row first, false when the file can't be written
+        bool writePPM(const std::string &path) {
+            std::vector<unsigned char> pixels(m_Width * m_Height * 3);
+            GLState::instance().bindFramebuffer(0);
+            glPixelStorei(GL_PACK_ALIGNMENT, 1);
+            glReadPixels(0, 0, m_Width, m_Height, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+            FILE *file = std::fopen(path.c_str(), "wb");
+            if (!file)
+                return false;
+            std::fprintf(file, "P6\n%u %u\n255\n", m_Width, m_Height);
+            for (unsigned int row = m_Height; row-- > 0;)
+                std::fwrite(&pixels[row * m_Width * 3], 1, m_Width * 3, file);
+            return std::fclose(file) == 0;
+        }
+
+    private:
+        unsigned int m_Width, m_Height;
+        unsigned int m_FBO = 0;
+        unsigned int m_Renderbuffers[2] = {0, 0};
+        bool m_Complete = false;
+    };
+
+};
+
+#endif //PROJECT_BASE_HEADLESS_H
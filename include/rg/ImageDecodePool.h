@@ -0,0 +1,185 @@
+#ifndef PROJECT_BASE_IMAGEDECODEPOOL_H
+#define PROJECT_BASE_IMAGEDECODEPOOL_H
+
+#include <stb_image.h>
+
+#include <rg/CpuProfiler.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace rg {
+
+    struct DecodedImage {
+        std::string path;
+        unsigned char *data = nullptr;  // nullptr when decoding failed
+        int width = 0;
+        int height = 0;
+        int components = 0;
+    };
+
+    // Decodes images with stb_image on a pool of worker threads.
+    // Jobs are queued from the GL thread together with an upload callback, and the callback runs back on
+    // the GL thread (inside uploadReady/finish) once the image is decoded, so no GL call ever leaves that thread.
+    // Vertical flipping is a per job option: stbi_set_flip_vertically_on_load is global and not thread safe,
+    // so the pool leaves it off and flips the rows itself.
+    class ImageDecodePool {
+    public:
+        typedef std::function<void(const DecodedImage&)> UploadCallback;
+
+        static ImageDecodePool& instance() {
+            static ImageDecodePool pool;
+            return pool;
+        }
+
+        explicit ImageDecodePool(unsigned int threadCount = 0) {
+            if (threadCount == 0)
+                threadCount = std::max(1u, std::thread::hardware_concurrency());
+            for (unsigned int i = 0; i < threadCount; ++i)
+                m_Workers.emplace_back(&ImageDecodePool::workerLoop, this);
+        }
+
+        ImageDecodePool(const ImageDecodePool&) = delete;
+        ImageDecodePool& operator=(const ImageDecodePool&) = delete;
+
+        ~ImageDecodePool() {
+            {
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                m_Stopping = true;
+                m_Jobs.clear();
+            }
+            m_JobReady.notify_all();
+            for (std::thread &worker : m_Workers)
+                worker.join();
+            // results nobody uploaded, the GL context is most likely gone by now
+            for (Result &result : m_Results)
+                stbi_image_free(result.image.data);
+        }
+
+        void submit(std::string const &path, bool flipVertically, UploadCallback onDecoded) {
+            {
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                m_Jobs.push_back(Job{path, flipVertically, std::move(onDecoded)});
+                ++m_Outstanding;
+            }
+            m_JobReady.notify_one();
+        }
+
+        // uploads every image decoded so far without waiting for the rest, returns how many were uploaded.
+        unsigned int uploadReady() {
+            unsigned int uploaded = 0;
+            Result result;
+            while (popResult(result, false)) {
+                upload(result);
+                ++uploaded;
+            }
+            return uploaded;
+        }
+
+        // blocks until every submitted image is decoded and uploaded, uploading each one as soon as it arrives.
+        void finish() {
+            Result result;
+            while (popResult(result, true))
+                upload(result);
+        }
+
+        size_t outstanding() {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            return m_Outstanding;
+        }
+
+    private:
+        struct Job {
+            std::string path;
+            bool flipVertically;
+            UploadCallback callback;
+        };
+
+        struct Result {
+            DecodedImage image;
+            UploadCallback callback;
+        };
+
+        std::mutex m_Mutex;
+        std::condition_variable m_JobReady;
+        std::condition_variable m_ResultReady;
+        std::deque<Job> m_Jobs;
+        std::deque<Result> m_Results;
+        std::vector<std::thread> m_Workers;
+        size_t m_Outstanding = 0;   // submitted but not uploaded yet
+        bool m_Stopping = false;
+
+        bool popResult(Result &result, bool wait) {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            if (wait)
+                m_ResultReady.wait(lock, [this] { return !m_Results.empty() || m_Outstanding == 0; });
+            if (m_Results.empty())
+                return false;
+            result = std::move(m_Results.front());
+            m_Results.pop_front();
+            return true;
+        }
+
+        void upload(Result &result) {
+            RG_PROFILE_ZONE("Upload image");
+            result.callback(result.image);
+            stbi_image_free(result.image.data);
+            result.image.data = nullptr;
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            --m_Outstanding;
+        }
+
+        void workerLoop() {
+            RG_PROFILE_THREAD("Image decode");
+            for (;;) {
+                Job job;
+                {
+                    std::unique_lock<std::mutex> lock(m_Mutex);
+                    m_JobReady.wait(lock, [this] { return m_Stopping || !m_Jobs.empty(); });
+                    if (m_Stopping)
+                        return;
+                    job = std::move(m_Jobs.front());
+                    m_Jobs.pop_front();
+                }
+
+                Result result;
+                RG_PROFILE_BEGIN("Decode image");
+                result.image.path = job.path;
+                result.image.data = stbi_load(job.path.c_str(), &result.image.width, &result.image.height,
+                                              &result.image.components, 0);
+                if (result.image.data && job.flipVertically)
+                    flipRows(result.image);
+                RG_PROFILE_END();
+                result.callback = std::move(job.callback);
+
+                {
+                    std::lock_guard<std::mutex> lock(m_Mutex);
+                    m_Results.push_back(std::move(result));
+                }
+                m_ResultReady.notify_one();
+            }
+        }
+
+        static void flipRows(DecodedImage &image) {
+            size_t rowSize = size_t(image.width) * image.components;
+            std::vector<unsigned char> row(rowSize);
+            for (int y = 0; y < image.height / 2; ++y) {
+                unsigned char *top = image.data + size_t(y) * rowSize;
+                unsigned char *bottom = image.data + size_t(image.height - 1 - y) * rowSize;
+                std::memcpy(row.data(), top, rowSize);
+                std::memcpy(top, bottom, rowSize);
+                std::memcpy(bottom, row.data(), rowSize);
+            }
+        }
+    };
+
+};
+
+#endif //PROJECT_BASE_IMAGEDECODEPOOL_H
@@ -0,0 +1,150 @@
+#ifndef PROJECT_BASE_KTXFILE_H
+#define PROJECT_BASE_KTXFILE_H
+
+#include <rg/BlockCompression.h>
+#include <rg/MappedFile.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// KTX 1.1 container (https://registry.khronos.org/KTX/specs/1.0/ktxspec.v1.html) holding a block compressed
+// texture with its whole precomputed mip chain, written by the asset cooker next to the source image.
+namespace rg {
+
+    const unsigned char KTX_IDENTIFIER[12] = {0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n'};
+    const uint32_t KTX_ENDIANNESS = 0x04030201;
+
+    struct KtxHeader {
+        unsigned char identifier[12];
+        uint32_t endianness;
+        uint32_t glType;                // 0 for compressed textures
+        uint32_t glTypeSize;
+        uint32_t glFormat;              // 0 for compressed textures
+        uint32_t glInternalFormat;
+        uint32_t glBaseInternalFormat;
+        uint32_t pixelWidth;
+        uint32_t pixelHeight;
+        uint32_t pixelDepth;
+        uint32_t numberOfArrayElements;
+        uint32_t numberOfFaces;
+        uint32_t numberOfMipmapLevels;
+        uint32_t bytesOfKeyValueData;
+    };
+
+    inline std::string compressedTexturePath(std::string const &imagePath) {
+        return imagePath + ".ktx";
+    }
+
+    // the .ktx of an image is fresh when it is at least as new as the image. glInternalFormat is the format stored
+    // in it, the asset cooker also treats one its options wouldn't choose as stale.
+    inline bool isCompressedTextureFresh(std::string const &imagePath, uint32_t &glInternalFormat) {
+        std::string ktxPath = compressedTexturePath(imagePath);
+        uint64_t imageSize, ktxSize;
+        int64_t imageMtime, ktxMtime;
+        if (!statFile(ktxPath, ktxSize, ktxMtime) || !statFile(imagePath, imageSize, imageMtime) || ktxMtime < imageMtime)
+            return false;
+        std::ifstream in(ktxPath, std::ios::binary);
+        KtxHeader header;
+        if (!in.read(reinterpret_cast<char*>(&header), sizeof(header))
+            || std::memcmp(header.identifier, KTX_IDENTIFIER, sizeof(KTX_IDENTIFIER)) != 0)
+            return false;
+        glInternalFormat = header.glInternalFormat;
+        return true;
+    }
+
+    struct CompressedLevel {
+        int width;
+        int height;
+        std::vector<unsigned char> data;
+    };
+
+    inline bool writeKtx(std::string const &path, BlockFormat format, const std::vector<CompressedLevel> &levels) {
+        if (levels.empty())
+            return false;
+        KtxHeader header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.identifier, KTX_IDENTIFIER, sizeof(KTX_IDENTIFIER));
+        header.endianness = KTX_ENDIANNESS;
+        header.glTypeSize = 1;
+        header.glInternalFormat = blockFormatGLInternalFormat(format);
+        header.glBaseInternalFormat = blockFormatGLBaseFormat(format);
+        header.pixelWidth = (uint32_t) levels[0].width;
+        header.pixelHeight = (uint32_t) levels[0].height;
+        header.numberOfFaces = 1;
+        header.numberOfMipmapLevels = (uint32_t) levels.size();
+
+        std::string tmpPath = path + ".tmp";
+        std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!out)
+            return false;
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        for (const CompressedLevel &level : levels) {
+            // block data is always a multiple of 8 bytes, so no mip padding is needed
+            uint32_t imageSize = (uint32_t) level.data.size();
+            out.write(reinterpret_cast<const char*>(&imageSize), sizeof(imageSize));
+            out.write(reinterpret_cast<const char*>(level.data.data()), level.data.size());
+        }
+        out.close();
+        if (!out) {
+            std::remove(tmpPath.c_str());
+            return false;
+        }
+        return std::rename(tmpPath.c_str(), path.c_str()) == 0;
+    }
+
+    // view over a mapped KTX file, levels point into the mapping.
+    class KtxView {
+    public:
+        struct Level {
+            int width;
+            int height;
+            const unsigned char *data;
+            uint32_t size;
+        };
+
+        bool open(const MappedFile &file) {
+            const unsigned char *data = file.data();
+            if (!data || file.size() < sizeof(KtxHeader))
+                return false;
+            std::memcpy(&m_Header, data, sizeof(KtxHeader));
+            if (std::memcmp(m_Header.identifier, KTX_IDENTIFIER, sizeof(KTX_IDENTIFIER)) != 0
+                || m_Header.endianness != KTX_ENDIANNESS
+                || m_Header.glType != 0 || m_Header.numberOfFaces != 1
+                || m_Header.numberOfArrayElements != 0 || m_Header.pixelDepth != 0)
+                return false;
+
+            uint64_t offset = sizeof(KtxHeader) + uint64_t(m_Header.bytesOfKeyValueData);
+            int width = (int) m_Header.pixelWidth, height = (int) m_Header.pixelHeight;
+            uint32_t levelCount = std::max<uint32_t>(1, m_Header.numberOfMipmapLevels);
+            m_Levels.clear();
+            for (uint32_t i = 0; i < levelCount; ++i) {
+                uint32_t imageSize;
+                if (offset + sizeof(imageSize) > file.size())
+                    return false;
+                std::memcpy(&imageSize, data + offset, sizeof(imageSize));
+                offset += sizeof(imageSize);
+                if (offset + imageSize > file.size())
+                    return false;
+                m_Levels.push_back(Level{width, height, data + offset, imageSize});
+                offset += (imageSize + 3) & ~3u;
+                width = std::max(1, width / 2);
+                height = std::max(1, height / 2);
+            }
+            return true;
+        }
+
+        const KtxHeader& header() const { return m_Header; }
+        const std::vector<Level>& levels() const { return m_Levels; }
+
+    private:
+        KtxHeader m_Header;
+        std::vector<Level> m_Levels;
+    };
+
+};
+
+#endif //PROJECT_BASE_KTXFILE_H
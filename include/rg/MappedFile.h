@@ -0,0 +1,70 @@
+#ifndef PROJECT_BASE_MAPPEDFILE_H
+#define PROJECT_BASE_MAPPEDFILE_H
+
+#include <cstdint>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace rg {
+
+    inline bool statFile(std::string const &path, uint64_t &size, int64_t &mtime) {
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0)
+            return false;
+        size = (uint64_t) st.st_size;
+        mtime = (int64_t) st.st_mtime;
+        return true;
+    }
+
+    // read only memory mapping of a whole file, unmapped on destruction.
+    class MappedFile {
+    public:
+        MappedFile() = default;
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+        ~MappedFile() {
+            close();
+        }
+
+        bool open(std::string const &path) {
+            close();
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0)
+                return false;
+            struct stat st;
+            if (fstat(fd, &st) != 0 || st.st_size == 0) {
+                ::close(fd);
+                return false;
+            }
+            void *mapping = mmap(nullptr, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            // the mapping keeps its own reference to the file
+            ::close(fd);
+            if (mapping == MAP_FAILED)
+                return false;
+            m_Data = static_cast<const unsigned char*>(mapping);
+            m_Size = (size_t) st.st_size;
+            return true;
+        }
+
+        void close() {
+            if (m_Data)
+                munmap(const_cast<unsigned char*>(m_Data), m_Size);
+            m_Data = nullptr;
+            m_Size = 0;
+        }
+
+        const unsigned char* data() const { return m_Data; }
+        size_t size() const { return m_Size; }
+
+    private:
+        const unsigned char *m_Data = nullptr;
+        size_t m_Size = 0;
+    };
+
+};
+
+#endif //PROJECT_BASE_MAPPEDFILE_H
@@ -0,0 +1,305 @@
+#ifndef PROJECT_BASE_MESHOPTIMIZER_H
+#define PROJECT_BASE_MESHOPTIMIZER_H
+
+#include <learnopengl/mesh.h>
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Post-import optimization of indexed triangle meshes, run once when a model is imported (and cooked):
+//   1. weld bitwise identical vertices (Assimp emits one vertex per face corner for most formats)
+//   2. reorder triangles for the post-transform vertex cache (Forsyth, "Linear-Speed Vertex Cache Optimisation")
+//   3. reorder clusters of triangles front to back from the mesh center to reduce overdraw
+//   4. renumber vertices in the order the index buffer first references them, for vertex fetch locality
+namespace rg {
+
+    // FIFO size used to report ACMR, close to the post-transform cache of current GPUs.
+    const unsigned int VERTEX_CACHE_REPORT_SIZE = 16;
+    // an overdraw reordering is thrown away if it costs more than this much ACMR over the cache optimized order.
+    const float OVERDRAW_ACMR_THRESHOLD = 1.05f;
+
+    struct MeshOptimizationStats {
+        uint32_t vertexCountBefore = 0;
+        uint32_t vertexCountAfter = 0;
+        float acmrBefore = 0.0f;    // average cache miss ratio, transformed vertices per triangle (0.5 - 3.0)
+        float acmrAfter = 0.0f;
+    };
+
+    // simulates a FIFO post-transform cache and returns the number of vertex shader invocations per triangle.
+    inline float analyzeVertexCache(const std::vector<unsigned int> &indices, size_t vertexCount,
+                                    unsigned int cacheSize = VERTEX_CACHE_REPORT_SIZE) {
+        if (indices.size() < 3)
+            return 0.0f;
+        // a vertex is in the cache when it was transformed less than cacheSize misses ago
+        std::vector<uint32_t> insertedAt(vertexCount, 0);
+        uint32_t misses = 0;
+        for (unsigned int index : indices) {
+            if (insertedAt[index] == 0 || misses - insertedAt[index] >= cacheSize) {
+                ++misses;
+                insertedAt[index] = misses;
+            }
+        }
+        return float(misses) / float(indices.size() / 3);
+    }
+
+    namespace detail {
+
+        inline uint32_t hashVertex(const Vertex &vertex) {
+            uint32_t words[sizeof(Vertex) / 4];
+            std::memcpy(words, &vertex, sizeof(words));
+            uint32_t hash = 2166136261u;
+            for (uint32_t word : words)
+                hash = (hash ^ word) * 16777619u;
+            return hash;
+        }
+
+        struct VertexHash {
+            size_t operator()(const Vertex &vertex) const { return hashVertex(vertex); }
+        };
+
+        struct VertexEqual {
+            bool operator()(const Vertex &a, const Vertex &b) const { return std::memcmp(&a, &b, sizeof(Vertex)) == 0; }
+        };
+
+        const int FORSYTH_CACHE_SIZE = 32;
+
+        inline float forsythVertexScore(int cachePosition, unsigned int remainingTriangles) {
+            if (remainingTriangles == 0)
+                return -1.0f;
+            float score = 0.0f;
+            if (cachePosition >= 0) {
+                // the last triangle's vertices get a fixed score so its neighbours aren't favoured over strips
+                if (cachePosition < 3)
+                    score = 0.75f;
+                else
+                    score = std::pow(1.0f - float(cachePosition - 3) / float(FORSYTH_CACHE_SIZE - 3), 1.5f);
+            }
+            // boost vertices with few remaining triangles, so lone triangles don't get left behind
+            return score + 2.0f / std::sqrt(float(remainingTriangles));
+        }
+
+        struct TriangleCluster {
+            size_t first;
+            size_t count;
+            float sortKey;
+        };
+
+    }
+
+    // welds bitwise identical vertices and rewrites the indices, returns the new vertex count.
+    inline size_t weldVertices(std::vector<Vertex> &vertices, std::vector<unsigned int> &indices) {
+        std::unordered_map<Vertex, unsigned int, detail::VertexHash, detail::VertexEqual> unique;
+        unique.reserve(vertices.size());
+        std::vector<unsigned int> remap(vertices.size());
+        std::vector<Vertex> welded;
+        welded.reserve(vertices.size());
+        for (size_t i = 0; i < vertices.size(); ++i) {
+            auto inserted = unique.insert(std::make_pair(vertices[i], (unsigned int) welded.size()));
+            if (inserted.second)
+                welded.push_back(vertices[i]);
+            remap[i] = inserted.first->second;
+        }
+        for (unsigned int &index : indices)
+            index = remap[index];
+        vertices.swap(welded);
+        return vertices.size();
+    }
+
+    // greedy triangle reordering after Tom Forsyth: always emit the triangle whose vertices score highest given
+    // an LRU model of the cache, only the triangles touching the cache are rescored after every emit.
+    inline void optimizeVertexCache(std::vector<unsigned int> &indices, size_t vertexCount) {
+        const size_t triangleCount = indices.size() / 3;
+        if (triangleCount == 0)
+            return;
+
+        // vertex -> triangle adjacency, the live part of every list shrinks as triangles are emitted
+        std::vector<unsigned int> remaining(vertexCount, 0);
+        for (unsigned int index : indices)
+            ++remaining[index];
+        std::vector<size_t> adjacencyOffset(vertexCount + 1, 0);
+        for (size_t i = 0; i < vertexCount; ++i)
+            adjacencyOffset[i + 1] = adjacencyOffset[i] + remaining[i];
+        std::vector<unsigned int> adjacency(indices.size());
+        std::vector<size_t> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+        for (size_t i = 0; i < indices.size(); ++i)
+            adjacency[fill[indices[i]]++] = (unsigned int) (i / 3);
+
+        std::vector<int> cachePosition(vertexCount, -1);
+        std::vector<float> vertexScore(vertexCount);
+        for (size_t i = 0; i < vertexCount; ++i)
+            vertexScore[i] = detail::forsythVertexScore(-1, remaining[i]);
+        std::vector<float> triangleScore(triangleCount);
+        for (size_t t = 0; t < triangleCount; ++t)
+            triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+        std::vector<bool> emitted(triangleCount, false);
+
+        std::vector<unsigned int> cache, nextCache;
+        std::vector<unsigned int> result;
+        result.reserve(indices.size());
+        size_t cursor = 0;
+        long best = -1;
+        for (size_t emittedCount = 0; emittedCount < triangleCount; ++emittedCount) {
+            if (best < 0) {
+                // dead end, nothing in the cache has triangles left: continue with the next triangle in input order
+                while (emitted[cursor])
+                    ++cursor;
+                best = (long) cursor;
+            }
+            const unsigned int *triangle = &indices[size_t(best) * 3];
+            emitted[best] = true;
+            for (int k = 0; k < 3; ++k) {
+                unsigned int v = triangle[k];
+                result.push_back(v);
+                // remove the triangle from the live part of the adjacency list
+                size_t begin = adjacencyOffset[v], end = begin + remaining[v];
+                for (size_t a = begin; a < end; ++a) {
+                    if (adjacency[a] == (unsigned int) best) {
+                        std::swap(adjacency[a], adjacency[end - 1]);
+                        break;
+                    }
+                }
+                --remaining[v];
+            }
+
+            // move the triangle's vertices to the front of the cache
+            nextCache.assign(triangle, triangle + 3);
+            for (unsigned int v : cache)
+                if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+                    nextCache.push_back(v);
+            for (size_t i = 0; i < nextCache.size(); ++i)
+                cachePosition[nextCache[i]] = i < size_t(detail::FORSYTH_CACHE_SIZE) ? int(i) : -1;
+
+            // rescore everything that was or is in the cache and pick the best triangle among their neighbours
+            for (unsigned int v : nextCache) {
+                float score = detail::forsythVertexScore(cachePosition[v], remaining[v]);
+                float delta = score - vertexScore[v];
+                vertexScore[v] = score;
+                for (size_t a = adjacencyOffset[v]; a < adjacencyOffset[v] + remaining[v]; ++a)
+                    triangleScore[adjacency[a]] += delta;
+            }
+            if (nextCache.size() > size_t(detail::FORSYTH_CACHE_SIZE))
+                nextCache.resize(detail::FORSYTH_CACHE_SIZE);
+            best = -1;
+            float bestScore = -1.0f;
+            for (unsigned int v : nextCache) {
+                for (size_t a = adjacencyOffset[v]; a < adjacencyOffset[v] + remaining[v]; ++a) {
+                    if (triangleScore[adjacency[a]] > bestScore) {
+                        bestScore = triangleScore[adjacency[a]];
+                        best = (long) adjacency[a];
+                    }
+                }
+            }
+            cache.swap(nextCache);
+        }
+        indices.swap(result);
+    }
+
+    // splits the (cache optimized) triangle order into clusters wherever the FIFO cache starts over, and sorts the
+    // clusters so the ones facing away from the mesh center, which tend to occlude the rest, are drawn first.
+    // keeps the input order when the reordering would cost more than OVERDRAW_ACMR_THRESHOLD of the ACMR.
+    inline void optimizeOverdraw(std::vector<unsigned int> &indices, const std::vector<Vertex> &vertices) {
+        const size_t triangleCount = indices.size() / 3;
+        if (triangleCount < 2)
+            return;
+
+        std::vector<detail::TriangleCluster> clusters;
+        std::vector<uint32_t> insertedAt(vertices.size(), 0);
+        uint32_t misses = 0;
+        for (size_t t = 0; t < triangleCount; ++t) {
+            int triangleMisses = 0;
+            for (int k = 0; k < 3; ++k) {
+                unsigned int index = indices[t * 3 + k];
+                if (insertedAt[index] == 0 || misses - insertedAt[index] >= VERTEX_CACHE_REPORT_SIZE) {
+                    ++misses;
+                    ++triangleMisses;
+                    insertedAt[index] = misses;
+                }
+            }
+            if (t == 0 || triangleMisses == 3)
+                clusters.push_back(detail::TriangleCluster{t, 0, 0.0f});
+            ++clusters.back().count;
+        }
+        if (clusters.size() < 2)
+            return;
+
+        glm::vec3 meshCenter(0.0f);
+        for (const Vertex &vertex : vertices)
+            meshCenter += vertex.Position;
+        meshCenter /= float(vertices.size());
+
+        for (detail::TriangleCluster &cluster : clusters) {
+            glm::vec3 center(0.0f), normal(0.0f);
+            float area = 0.0f;
+            for (size_t t = cluster.first; t < cluster.first + cluster.count; ++t) {
+                const glm::vec3 &a = vertices[indices[t * 3]].Position;
+                const glm::vec3 &b = vertices[indices[t * 3 + 1]].Position;
+                const glm::vec3 &c = vertices[indices[t * 3 + 2]].Position;
+                glm::vec3 n = glm::cross(b - a, c - a);     // length is twice the area
+                float triangleArea = glm::length(n);
+                center += (a + b + c) * (triangleArea / 3.0f);
+                normal += n;
+                area += triangleArea;
+            }
+            float normalLength = glm::length(normal);
+            if (area > 0.0f && normalLength > 0.0f)
+                cluster.sortKey = glm::dot(center / area - meshCenter, normal / normalLength);
+        }
+        std::stable_sort(clusters.begin(), clusters.end(),
+                         [](const detail::TriangleCluster &a, const detail::TriangleCluster &b) { return a.sortKey > b.sortKey; });
+
+        std::vector<unsigned int> sorted;
+        sorted.reserve(indices.size());
+        for (const detail::TriangleCluster &cluster : clusters)
+            sorted.insert(sorted.end(), indices.begin() + cluster.first * 3, indices.begin() + (cluster.first + cluster.count) * 3);
+        if (analyzeVertexCache(sorted, vertices.size()) <= analyzeVertexCache(indices, vertices.size()) * OVERDRAW_ACMR_THRESHOLD)
+            indices.swap(sorted);
+    }
+
+    // renumbers the vertices in the order of their first use in the index buffer and drops unreferenced ones.
+    inline void optimizeVertexFetch(std::vector<Vertex> &vertices, std::vector<unsigned int> &indices) {
+        const unsigned int unused = ~0u;
+        std::vector<unsigned int> remap(vertices.size(), unused);
+        std::vector<Vertex> ordered;
+        ordered.reserve(vertices.size());
+        for (unsigned int &index : indices) {
+            if (remap[index] == unused) {
+                remap[index] = (unsigned int) ordered.size();
+                ordered.push_back(vertices[index]);
+            }
+            index = remap[index];
+        }
+        vertices.swap(ordered);
+    }
+
+    // runs the whole optimization stage on an indexed triangle list.
+    inline MeshOptimizationStats optimizeMesh(std::vector<Vertex> &vertices, std::vector<unsigned int> &indices) {
+        MeshOptimizationStats stats;
+        stats.vertexCountBefore = (uint32_t) vertices.size();
+        stats.acmrBefore = analyzeVertexCache(indices, vertices.size());
+        weldVertices(vertices, indices);
+        optimizeVertexCache(indices, vertices.size());
+        optimizeOverdraw(indices, vertices);
+        optimizeVertexFetch(vertices, indices);
+        stats.vertexCountAfter = (uint32_t) vertices.size();
+        stats.acmrAfter = analyzeVertexCache(indices, vertices.size());
+        return stats;
+    }
+
+    inline void reportMeshOptimization(std::string const &name, const MeshOptimizationStats &stats) {
+        std::cout << "MESH::OPTIMIZE:: " << name << ": " << stats.vertexCountBefore << " -> " << stats.vertexCountAfter
+                  << " vertices, ACMR " << std::fixed << std::setprecision(3) << stats.acmrBefore << " -> " << stats.acmrAfter
+                  << std::defaultfloat << std::endl;
+    }
+
+};
+
+#endif //PROJECT_BASE_MESHOPTIMIZER_H
@@ -0,0 +1,180 @@
+#ifndef PROJECT_BASE_MODELIMPORTER_H
+#define PROJECT_BASE_MODELIMPORTER_H
+
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/mesh.h>
+#include <rg/CpuProfiler.h>
+#include <rg/MeshOptimizer.h>
+
+#include <cfloat>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace rg {
+
+    // CPU side description of a model: everything Model needs to create its meshes, without touching OpenGL.
+    // Produced either by Assimp (importModel) or by reading a cooked file (see rg/CookedModel.h).
+    struct ImportedTexture {
+        std::string type;   // texture_diffuse, texture_specular, ...
+        std::string path;   // relative to the model directory
+    };
+
+    struct ImportedMaterial {
+        std::vector<ImportedTexture> textures;
+    };
+
+    struct ImportedMesh {
+        std::vector<Vertex> vertices;
+        std::vector<unsigned int> indices;
+        unsigned int material = 0;
+        glm::vec3 boundsMin = glm::vec3(FLT_MAX);
+        glm::vec3 boundsMax = glm::vec3(-FLT_MAX);
+        MeshOptimizationStats optimization;
+    };
+
+    struct ImportedModel {
+        std::vector<ImportedMesh> meshes;
+        std::vector<ImportedMaterial> materials;
+        glm::vec3 boundsMin = glm::vec3(FLT_MAX);
+        glm::vec3 boundsMax = glm::vec3(-FLT_MAX);
+    };
+
+    // the Assimp post-processing steps every model is imported with, recorded in cooked files
+    const unsigned int MODEL_IMPORT_FLAGS = aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace;
+
+    // the material library an .obj file references with mtllib, relative to the model directory.
+    // empty for other formats and for an .obj without one.
+    inline std::string objMaterialLibrary(std::string const &path) {
+        if (path.size() < 4 || path.compare(path.size() - 4, 4, ".obj") != 0)
+            return std::string();
+        std::ifstream in(path);
+        std::string line;
+        while (std::getline(in, line)) {
+            if (line.compare(0, 7, "mtllib ") != 0)
+                continue;
+            size_t begin = line.find_first_not_of(" \t", 7);
+            size_t end = line.find_last_not_of(" \t\r");
+            if (begin != std::string::npos)
+                return line.substr(begin, end - begin + 1);
+        }
+        return std::string();
+    }
+
+    inline void importNode(aiNode *node, const aiScene *scene, ImportedModel &model);
+    inline ImportedMesh importMesh(aiMesh *mesh);
+    inline ImportedMaterial importMaterial(aiMaterial *material);
+
+    // reads a model with Assimp and flattens its node hierarchy into a list of meshes and a material table.
+    inline bool importModel(std::string const &path, ImportedModel &model) {
+        RG_PROFILE_ZONE("Assimp import");
+        Assimp::Importer importer;
+        const aiScene* scene = importer.ReadFile(path, MODEL_IMPORT_FLAGS);
+        // check for errors
+        if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
+        {
+            std::cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << std::endl;
+            return false;
+        }
+
+        for (unsigned int i = 0; i < scene->mNumMaterials; ++i) {
+            model.materials.push_back(importMaterial(scene->mMaterials[i]));
+        }
+        importNode(scene->mRootNode, scene, model);
+
+        for (const ImportedMesh &mesh : model.meshes) {
+            model.boundsMin = glm::min(model.boundsMin, mesh.boundsMin);
+            model.boundsMax = glm::max(model.boundsMax, mesh.boundsMax);
+        }
+        return true;
+    }
+
+    // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
+    inline void importNode(aiNode *node, const aiScene *scene, ImportedModel &model) {
+        for (unsigned int i = 0; i < node->mNumMeshes; i++) {
+            // the node object only contains indices to index the actual objects in the scene.
+            // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
+            aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
+            model.meshes.push_back(importMesh(mesh));
+        }
+        for (unsigned int i = 0; i < node->mNumChildren; i++) {
+            importNode(node->mChildren[i], scene, model);
+        }
+    }
+
+    inline ImportedMesh importMesh(aiMesh *mesh) {
+        ImportedMesh result;
+        result.material = mesh->mMaterialIndex;
+        result.vertices.reserve(mesh->mNumVertices);
+
+        // walk through each of the mesh's vertices
+        for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
+            Vertex vertex;
+            // zero the attributes Assimp has no data for, the optimizer welds vertices by their bytes
+            vertex.Normal = vertex.Tangent = vertex.Bitangent = glm::vec3(0.0f);
+            vertex.Position = glm::vec3(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
+            if (mesh->HasNormals())
+                vertex.Normal = glm::vec3(mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z);
+            // texture coordinates, we only ever use the first set (0).
+            if (mesh->mTextureCoords[0]) {
+                vertex.TexCoords = glm::vec2(mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y);
+                vertex.Tangent = glm::vec3(mesh->mTangents[i].x, mesh->mTangents[i].y, mesh->mTangents[i].z);
+                vertex.Bitangent = glm::vec3(mesh->mBitangents[i].x, mesh->mBitangents[i].y, mesh->mBitangents[i].z);
+            } else {
+                vertex.TexCoords = glm::vec2(0.0f, 0.0f);
+            }
+            result.boundsMin = glm::min(result.boundsMin, vertex.Position);
+            result.boundsMax = glm::max(result.boundsMax, vertex.Position);
+            result.vertices.push_back(vertex);
+        }
+        // now walk through each of the mesh's faces (a face is a mesh its triangle) and retrieve the corresponding vertex indices.
+        for (unsigned int i = 0; i < mesh->mNumFaces; i++) {
+            aiFace face = mesh->mFaces[i];
+            for (unsigned int j = 0; j < face.mNumIndices; j++)
+                result.indices.push_back(face.mIndices[j]);
+        }
+        // Assimp only welds and reorders with aiProcess_JoinIdenticalVertices/ImproveCacheLocality, we do it ourselves
+        // (see rg/MeshOptimizer.h) so the result is the same for every source format.
+        result.optimization = optimizeMesh(result.vertices, result.indices);
+        return result;
+    }
+
+    inline void importMaterialTextures(aiMaterial *material, aiTextureType type, std::string typeName, ImportedMaterial &result) {
+        for (unsigned int i = 0; i < material->GetTextureCount(type); i++) {
+            aiString str;
+            material->GetTexture(type, i, &str);
+            ImportedTexture texture;
+            texture.type = typeName;
+            texture.path = str.C_Str();
+            result.textures.push_back(texture);
+        }
+    }
+
+    // we assume a convention for sampler names in the shaders. Each diffuse texture should be named
+    // as 'texture_diffuseN' where N is a sequential number ranging from 1 to MAX_SAMPLER_NUMBER.
+    // Same applies to other texture as the following list summarizes:
+    // diffuse: texture_diffuseN
+    // specular: texture_specularN
+    // normal: texture_normalN
+    inline ImportedMaterial importMaterial(aiMaterial *material) {
+        ImportedMaterial result;
+        // 1. diffuse maps
+        importMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse", result);
+        // 2. specular maps
+        importMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular", result);
+        // 3. normal maps
+        importMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal", result);
+        // 4. height maps
+        importMaterialTextures(material, aiTextureType_AMBIENT, "texture_height", result);
+        return result;
+    }
+
+};
+
+#endif //PROJECT_BASE_MODELIMPORTER_H
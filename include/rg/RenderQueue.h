@@ -0,0 +1,354 @@
+#ifndef PROJECT_BASE_RENDERQUEUE_H
+#define PROJECT_BASE_RENDERQUEUE_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/mesh.h>
+#include <learnopengl/model.h>
+#include <learnopengl/shader.h>
+#include <rg/CpuProfiler.h>
+#include <rg/Culling.h>
+#include <rg/GLState.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <unordered_map>
+#include <vector>
+
+// Draws of a pass are submitted as packets and executed sorted by a 64 bit key instead of in submission order,
+// so the program, the textures and the VAO only change where the key does. Consecutive packets of the same
+// pipeline and mesh are merged into one instanced draw when the pipeline has an INSTANCED variant.
+//
+//   63       52 51              32 31                      8 7       0
+//   | pipeline | material         | mesh                    | depth   |
+namespace rg {
+
+    // a program and the way it receives the model matrix: the model uniform for single draws and, if set, an
+    // INSTANCED variant that reads it from the per-instance attribute (see Mesh::setupInstanceAttributes).
+    // layers > 1 draws every packet that many times as consecutive instances, the programs pick the target layer
+    // from gl_InstanceID % layers (the LAYERED_FACES shadow variants).
+    struct Pipeline {
+        Shader *shader = nullptr;
+        Shader *instancedShader = nullptr;
+        UniformHandle<glm::mat4> model;
+        unsigned int layers = 1;
+
+        explicit Pipeline(Shader &shader, Shader *instancedShader = nullptr, unsigned int layers = 1)
+                : shader(&shader), instancedShader(instancedShader), model(shader.uniform<glm::mat4>("model")),
+                  layers(layers) {}
+    };
+
+    struct DrawPacket {
+        Pipeline *pipeline;
+        Mesh *mesh;
+        glm::mat4 transform;
+    };
+
+    // what a flush did, next to what drawing the same packets in submission order would have cost
+    struct RenderQueueStats {
+        unsigned int culled = 0;        // packets dropped by cull before they were sorted
+        unsigned int packets = 0;
+        unsigned int drawCalls = 0;
+        unsigned int instancedDrawCalls = 0;
+        unsigned int programChanges = 0;
+        unsigned int materialChanges = 0;
+        unsigned int vaoChanges = 0;
+        unsigned int unsortedProgramChanges = 0;
+        unsigned int unsortedMaterialChanges = 0;
+        unsigned int unsortedVaoChanges = 0;
+
+        unsigned int savedDrawCalls() const {
+            return packets - drawCalls;
+        }
+
+        // sums the flushes of a pass that is drawn in several parts, e.g. the faces of a shadow cubemap
+        void add(const RenderQueueStats &other) {
+            culled += other.culled;
+            packets += other.packets;
+            drawCalls += other.drawCalls;
+            instancedDrawCalls += other.instancedDrawCalls;
+            programChanges += other.programChanges;
+            materialChanges += other.materialChanges;
+            vaoChanges += other.vaoChanges;
+            unsortedProgramChanges += other.unsortedProgramChanges;
+            unsortedMaterialChanges += other.unsortedMaterialChanges;
+            unsortedVaoChanges += other.unsortedVaoChanges;
+        }
+
+        int savedStateChanges() const {
+            return (int) (unsortedProgramChanges + unsortedMaterialChanges + unsortedVaoChanges)
+                   - (int) (programChanges + materialChanges + vaoChanges);
+        }
+    };
+
+    struct SortEntry {
+        uint64_t key;
+        uint32_t packet;
+    };
+
+    // LSD radix sort on the key, one pass per byte. bytes every key shares (the unused pipeline bits, a pass
+    // drawing a single material, ...) are skipped, so a typical flush does three or four passes.
+    inline void radixSort(std::vector<SortEntry> &entries, std::vector<SortEntry> &scratch) {
+        if (entries.size() < 2)
+            return;
+        scratch.resize(entries.size());
+        for (unsigned int shift = 0; shift < 64; shift += 8) {
+            size_t histogram[256] = {};
+            for (const SortEntry &entry : entries)
+                histogram[(entry.key >> shift) & 0xff]++;
+            if (histogram[(entries[0].key >> shift) & 0xff] == entries.size())
+                continue;
+            size_t offset = 0;
+            for (size_t &count : histogram) {
+                size_t bucketSize = count;
+                count = offset;
+                offset += bucketSize;
+            }
+            for (const SortEntry &entry : entries)
+                scratch[histogram[(entry.key >> shift) & 0xff]++] = entry;
+            entries.swap(scratch);
+        }
+    }
+
+    inline bool sameTextures(const Mesh &a, const Mesh &b) {
+        if (a.textures.size() != b.textures.size())
+            return false;
+        for (size_t i = 0; i < a.textures.size(); ++i)
+            if (a.textures[i].id != b.textures[i].id)
+                return false;
+        return true;
+    }
+
+    class RenderQueue {
+    public:
+        RenderQueue() = default;
+
+        ~RenderQueue() {
+            if (m_InstanceVBO)
+                glDeleteBuffers(1, &m_InstanceVBO);
+        }
+
+        RenderQueue(const RenderQueue&) = delete;
+        RenderQueue& operator=(const RenderQueue&) = delete;
+
+        // starts a pass, the depth bits sort the packets of a mesh front to back from viewPosition up to farPlane
+        void begin(const glm::vec3 &viewPosition, float farPlane) {
+            m_Packets.clear();
+            m_Culled = 0;
+            m_ViewPosition = viewPosition;
+            m_FarPlane = farPlane;
+        }
+
+        void submit(Pipeline &pipeline, Mesh &mesh, const glm::mat4 &transform) {
+            m_Packets.push_back(DrawPacket{&pipeline, &mesh, transform});
+        }
+
+        void submit(Pipeline &pipeline, Model &model, const glm::mat4 &transform) {
+            for (Mesh &mesh : model.meshes)
+                submit(pipeline, mesh, transform);
+        }
+
+        // drops the submitted packets whose world space bounding sphere is outside the frustum
+        void cull(const Frustum &frustum) {
+            cullPackets([&](std::vector<uint32_t> &visible) { m_Spheres.cull(frustum, visible); });
+        }
+
+        // drops the submitted packets that are outside all of the frustums, e.g. the cascades of a shadow map
+        void cull(const Frustum *frustums, unsigned int count) {
+            cullPackets([&](std::vector<uint32_t> &visible) {
+                visible.clear();
+                for (unsigned int i = 0; i < count; ++i) {
+                    m_Spheres.cull(frustums[i], m_FrustumVisible);
+                    m_Merged.clear();
+                    std::set_union(visible.begin(), visible.end(), m_FrustumVisible.begin(), m_FrustumVisible.end(),
+                                   std::back_inserter(m_Merged));
+                    visible.swap(m_Merged);
+                }
+            });
+        }
+
+        // drops the submitted packets out of reach of the sphere around center, e.g. a point light's range
+        void cull(const glm::vec3 &center, float range) {
+            cullPackets([&](std::vector<uint32_t> &visible) { m_Spheres.cull(center, range, visible); });
+        }
+
+        // sorts and draws everything submitted since begin. the last VAO and textures stay bound like after Mesh::Draw,
+        // instanced runs point the instance attributes of their VAO into the queue's buffer.
+        RenderQueueStats flush() {
+            RG_PROFILE_ZONE("RenderQueue::flush");
+            RenderQueueStats stats;
+            stats.culled = m_Culled;
+            stats.packets = (unsigned int) m_Packets.size();
+            countUnsortedStateChanges(stats);
+
+            m_Entries.clear();
+            for (uint32_t i = 0; i < m_Packets.size(); ++i)
+                m_Entries.push_back(SortEntry{sortKey(m_Packets[i]), i});
+            radixSort(m_Entries, m_Scratch);
+
+            buildRuns();
+            if (!m_Instances.empty()) {
+                if (!m_InstanceVBO)
+                    glGenBuffers(1, &m_InstanceVBO);
+                glBindBuffer(GL_ARRAY_BUFFER, m_InstanceVBO);
+                glBufferData(GL_ARRAY_BUFFER, m_Instances.size() * sizeof(glm::mat4), m_Instances.data(), GL_STREAM_DRAW);
+            }
+
+            Shader *boundShader = nullptr;
+            const Mesh *materialMesh = nullptr, *boundsMesh = nullptr;
+            unsigned int boundVAO = 0;
+            bool vaoBound = false;
+            for (const Run &run : m_Runs) {
+                const DrawPacket &first = m_Packets[m_Entries[run.begin].packet];
+                Mesh &mesh = *first.mesh;
+                Shader &shader = run.instanced ? *first.pipeline->instancedShader : *first.pipeline->shader;
+                if (&shader != boundShader) {
+                    shader.use();
+                    boundShader = &shader;
+                    // samplers and bounds are program state
+                    materialMesh = boundsMesh = nullptr;
+                    stats.programChanges++;
+                }
+                if (!materialMesh || !sameTextures(*materialMesh, mesh)) {
+                    mesh.bindTextures(shader);
+                    stats.materialChanges++;
+                }
+                materialMesh = &mesh;
+                if (&mesh != boundsMesh) {
+                    mesh.bindBounds(shader);
+                    boundsMesh = &mesh;
+                }
+                if (!vaoBound || mesh.VAO != boundVAO) {
+                    GLState::instance().bindVertexArray(mesh.VAO);
+                    boundVAO = mesh.VAO;
+                    vaoBound = true;
+                    stats.vaoChanges++;
+                }
+
+                if (run.instanced) {
+                    glBindBuffer(GL_ARRAY_BUFFER, m_InstanceVBO);
+                    Mesh::setupInstanceAttributes(run.firstInstance * sizeof(glm::mat4), first.pipeline->layers);
+                    mesh.DrawElements(run.count * first.pipeline->layers);
+                    stats.drawCalls++;
+                    stats.instancedDrawCalls++;
+                } else {
+                    for (size_t i = run.begin; i < run.begin + run.count; ++i) {
+                        first.pipeline->model.set(m_Packets[m_Entries[i].packet].transform);
+                        mesh.DrawElements(first.pipeline->layers);
+                        stats.drawCalls++;
+                    }
+                }
+            }
+
+            m_Packets.clear();
+            m_Culled = 0;
+            return stats;
+        }
+
+    private:
+        static const unsigned int PIPELINE_BITS = 12, MATERIAL_BITS = 20, MESH_BITS = 24, DEPTH_BITS = 8;
+
+        // packets sharing pipeline and mesh, drawn with one instanced call when the pipeline allows it
+        struct Run {
+            size_t begin;
+            unsigned int count;
+            bool instanced;
+            size_t firstInstance;
+        };
+
+        std::vector<DrawPacket> m_Packets;
+        std::vector<SortEntry> m_Entries, m_Scratch;
+        std::vector<Run> m_Runs;
+        std::vector<glm::mat4> m_Instances;
+        unsigned int m_InstanceVBO = 0;
+        SphereBatch m_Spheres;
+        std::vector<uint32_t> m_Visible, m_FrustumVisible, m_Merged;
+        unsigned int m_Culled = 0;
+        glm::vec3 m_ViewPosition = glm::vec3(0.0f);
+        float m_FarPlane = 1.0f;
+
+        // ids handed out on first sight and kept for the lifetime of the queue, so the order is stable between frames
+        std::unordered_map<const Pipeline*, uint64_t> m_PipelineIds;
+        std::unordered_map<const Mesh*, uint64_t> m_MeshIds;
+
+        template<typename T>
+        static uint64_t idFor(std::unordered_map<const T*, uint64_t> &ids, const T *object, unsigned int bits) {
+            auto it = ids.find(object);
+            if (it == ids.end())
+                it = ids.emplace(object, (uint64_t) ids.size()).first;
+            return it->second & ((uint64_t(1) << bits) - 1);
+        }
+
+        template<typename Test>
+        void cullPackets(Test test) {
+            m_Spheres.clear();
+            for (const DrawPacket &packet : m_Packets) {
+                glm::vec3 center;
+                float radius;
+                transformSphere(packet.transform, packet.mesh->boundsCenter, packet.mesh->boundsRadius, center, radius);
+                m_Spheres.add(center, radius);
+            }
+            test(m_Visible);
+            // the visible indices are ascending, so the packets can be compacted in place
+            for (size_t i = 0; i < m_Visible.size(); ++i)
+                m_Packets[i] = m_Packets[m_Visible[i]];
+            m_Culled += (unsigned int) (m_Packets.size() - m_Visible.size());
+            m_Packets.resize(m_Visible.size());
+        }
+
+        uint64_t sortKey(const DrawPacket &packet) {
+            uint64_t pipeline = idFor(m_PipelineIds, (const Pipeline*) packet.pipeline, PIPELINE_BITS);
+            // the first texture stands for the material, meshes only share it when they share the material
+            uint64_t material = packet.mesh->textures.empty() ? 0
+                              : packet.mesh->textures[0].id & ((uint64_t(1) << MATERIAL_BITS) - 1);
+            uint64_t mesh = idFor(m_MeshIds, (const Mesh*) packet.mesh, MESH_BITS);
+            float distance = glm::length(glm::vec3(packet.transform[3]) - m_ViewPosition) / m_FarPlane;
+            uint64_t depth = (uint64_t) (std::min(std::max(distance, 0.0f), 1.0f) * ((1 << DEPTH_BITS) - 1));
+            return pipeline << (MATERIAL_BITS + MESH_BITS + DEPTH_BITS)
+                   | material << (MESH_BITS + DEPTH_BITS)
+                   | mesh << DEPTH_BITS
+                   | depth;
+        }
+
+        void buildRuns() {
+            m_Runs.clear();
+            m_Instances.clear();
+            size_t i = 0;
+            while (i < m_Entries.size()) {
+                const DrawPacket &first = m_Packets[m_Entries[i].packet];
+                size_t end = i + 1;
+                while (end < m_Entries.size()) {
+                    const DrawPacket &packet = m_Packets[m_Entries[end].packet];
+                    if (packet.pipeline != first.pipeline || packet.mesh != first.mesh)
+                        break;
+                    ++end;
+                }
+                Run run{i, (unsigned int) (end - i), end - i > 1 && first.pipeline->instancedShader, 0};
+                if (run.instanced) {
+                    run.firstInstance = m_Instances.size();
+                    for (size_t j = i; j < end; ++j)
+                        m_Instances.push_back(m_Packets[m_Entries[j].packet].transform);
+                }
+                m_Runs.push_back(run);
+                i = end;
+            }
+        }
+
+        // the state changes of drawing every packet on its own in the order it was submitted
+        void countUnsortedStateChanges(RenderQueueStats &stats) const {
+            const DrawPacket *previous = nullptr;
+            for (const DrawPacket &packet : m_Packets) {
+                bool programChanged = !previous || packet.pipeline->shader != previous->pipeline->shader;
+                stats.unsortedProgramChanges += programChanged;
+                stats.unsortedMaterialChanges += programChanged || !sameTextures(*packet.mesh, *previous->mesh);
+                stats.unsortedVaoChanges += !previous || packet.mesh->VAO != previous->mesh->VAO;
+                previous = &packet;
+            }
+        }
+    };
+
+};
+
+#endif //PROJECT_BASE_RENDERQUEUE_H
@@ -0,0 +1,334 @@
+#ifndef PROJECT_BASE_SHADOWATLAS_H
+#define PROJECT_BASE_SHADOWATLAS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <rg/GLState.h>
+#include <rg/UniformBlocks.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Omnidirectional shadows of several point lights in one depth texture array. Every light gets six square
+// tiles, one per cube face, sized by how much of the screen the light influences. The tiles come from a
+// quadtree allocator over the layers, and 2.model_lighting.fs picks the face and the tile of a fragment itself,
+// so the atlas is sampled as a sampler2DArray instead of one cubemap per light.
+//
+// Faces aren't rendered every frame. A face is due when its light moved, when the static casters changed or
+// when it was never rendered, and a moving light that covers little of the screen is only due every few
+// frames. schedule() picks the most urgent due faces up to a budget, the rest wait for a later frame.
+namespace rg {
+
+    // rough fraction of the screen height covered by a light's sphere of influence, 1 from inside it
+    inline float screenCoverage(const glm::vec3 &center, float radius, const glm::vec3 &viewPosition, float fovY) {
+        float distance = glm::length(center - viewPosition);
+        if (distance <= radius)
+            return 1.0f;
+        return std::min(1.0f, radius / (distance * std::tan(fovY * 0.5f)));
+    }
+
+    struct ShadowAtlasUpdate {
+        unsigned int light;
+        unsigned int face;
+    };
+
+    struct ShadowAtlasStats {
+        unsigned int lights = 0;            // lights with tiles
+        unsigned int facesRendered = 0;
+        unsigned int facesDeferred = 0;     // due, but over the budget
+    };
+
+    class ShadowAtlas {
+    public:
+        static const unsigned int MAX_LIGHTS = SHADOW_ATLAS_LIGHTS;
+        static const unsigned int MIN_FACE_SIZE = 128, MAX_FACE_SIZE = 512;
+        // texture unit of the atlas, below the clustered light buffers
+        static const unsigned int TEXTURE_UNIT = 11;
+
+        explicit ShadowAtlas(unsigned int size = 2048, unsigned int layers = 2)
+                : m_Size(size), m_Layers(layers), m_Block(SHADOW_ATLAS_BLOCK_BINDING) {
+            GLState &state = GLState::instance();
+            glGenTextures(1, &m_Texture);
+            state.bindTexture(GL_TEXTURE_2D_ARRAY, m_Texture);
+            glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, m_Size, m_Size, m_Layers, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+            glGenFramebuffers(1, &m_FBO);
+            state.bindFramebuffer(m_FBO);
+            glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_Texture, 0, 0);
+            glDrawBuffer(GL_NONE);
+            glReadBuffer(GL_NONE);
+            state.bindFramebuffer(0);
+
+            // the largest level is a whole layer, each level below splits a tile into four
+            while ((m_Size >> m_Levels.size()) >= MIN_FACE_SIZE)
+                m_Levels.push_back(std::vector<Tile>());
+            for (unsigned int layer = 0; layer < m_Layers; ++layer)
+                m_Levels[0].push_back(Tile{0, 0, layer});
+            m_Lights.resize(MAX_LIGHTS);
+        }
+
+        ~ShadowAtlas() {
+            GLState &state = GLState::instance();
+            state.textureDeleted(m_Texture);
+            glDeleteTextures(1, &m_Texture);
+            state.framebufferDeleted(m_FBO);
+            glDeleteFramebuffers(1, &m_FBO);
+        }
+
+        ShadowAtlas(const ShadowAtlas&) = delete;
+        ShadowAtlas& operator=(const ShadowAtlas&) = delete;
+
+        // starts a frame, staticCasters is the hash of the casters' transforms (see hashTransforms)
+        void beginFrame(uint64_t staticCasters) {
+            m_Frame++;
+            m_CastersChanged = staticCasters != m_StaticCasters;
+            m_StaticCasters = staticCasters;
+            for (Light &light : m_Lights)
+                light.seen = false;
+        }
+
+        // places the light in slot for this frame and (re)allocates its tiles when its size changes. false when
+        // the atlas has no room for it, the light is unshadowed then.
+        bool setLight(unsigned int slot, const glm::vec3 &position, float farPlane, float coverage) {
+            Light &light = m_Lights[slot];
+            light.seen = true;
+            light.position = position;
+            light.farPlane = farPlane;
+            light.coverage = coverage;
+            unsigned int faceSize = chooseFaceSize(coverage, light.allocated ? light.faceSize : 0);
+            if (!light.allocated || faceSize != light.faceSize)
+                allocate(light, faceSize);
+            return light.allocated;
+        }
+
+        // frees the lights that weren't set this frame and returns the faces to render, ordered by light. the
+        // faces count as rendered from here on, the caller draws each after beginFace.
+        const std::vector<ShadowAtlasUpdate>& schedule(unsigned int budget) {
+            m_Stats = ShadowAtlasStats();
+            m_Candidates.clear();
+            for (unsigned int slot = 0; slot < MAX_LIGHTS; ++slot) {
+                Light &light = m_Lights[slot];
+                if (light.allocated && !light.seen)
+                    release(light);
+                if (!light.allocated)
+                    continue;
+                m_Stats.lights++;
+                // lights covering little of the screen follow their movement less often
+                unsigned int interval = light.coverage >= 0.3f ? 1 : light.coverage >= 0.1f ? 2 : 4;
+                for (unsigned int face = 0; face < 6; ++face) {
+                    Face &state = light.faces[face];
+                    if (m_CastersChanged)
+                        state.casters = false;
+                    bool moved = state.position != light.position || state.farPlane != light.farPlane;
+                    float priority;
+                    if (!state.rendered)
+                        priority = 1e9f;    // holds no depth at all yet
+                    else if (!state.casters)
+                        priority = 1e6f;
+                    else if (moved && m_Frame - state.frame >= interval)
+                        priority = (m_Frame - state.frame) * (0.05f + light.coverage);
+                    else
+                        continue;
+                    m_Candidates.push_back(Candidate{priority, ShadowAtlasUpdate{slot, face}});
+                }
+            }
+
+            std::sort(m_Candidates.begin(), m_Candidates.end(),
+                      [](const Candidate &a, const Candidate &b) { return a.priority > b.priority; });
+            m_Updates.clear();
+            for (size_t i = 0; i < m_Candidates.size() && i < budget; ++i) {
+                const ShadowAtlasUpdate &update = m_Candidates[i].update;
+                Light &light = m_Lights[update.light];
+                Face &state = light.faces[update.face];
+                state.rendered = state.casters = true;
+                state.position = light.position;
+                state.farPlane = light.farPlane;
+                state.frame = m_Frame;
+                m_Updates.push_back(update);
+            }
+            m_Stats.facesRendered = (unsigned int) m_Updates.size();
+            m_Stats.facesDeferred = (unsigned int) (m_Candidates.size() - m_Updates.size());
+            std::sort(m_Updates.begin(), m_Updates.end(), [](const ShadowAtlasUpdate &a, const ShadowAtlasUpdate &b) {
+                return a.light != b.light ? a.light < b.light : a.face < b.face;
+            });
+            return m_Updates;
+        }
+
+        // binds the layer of the face's tile, sets the viewport to it and clears it. the light's shadow matrices
+        // are the ones of pointShadowMatrices at its position and far plane.
+        void beginFace(const ShadowAtlasUpdate &update) {
+            GLState &state = GLState::instance();
+            const Light &light = m_Lights[update.light];
+            const Tile &tile = light.tiles[update.face];
+            state.bindFramebuffer(m_FBO);
+            if (tile.layer != m_AttachedLayer) {
+                glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_Texture, 0, tile.layer);
+                m_AttachedLayer = tile.layer;
+            }
+            state.viewport(tile.x, tile.y, light.faceSize, light.faceSize);
+            state.enable(GL_SCISSOR_TEST);
+            glScissor(tile.x, tile.y, light.faceSize, light.faceSize);
+            glClear(GL_DEPTH_BUFFER_BIT);
+        }
+
+        // after the scheduled faces are drawn, publishes the tiles for sampling
+        void finish() {
+            GLState::instance().disable(GL_SCISSOR_TEST);
+            ShadowAtlasBlock block;
+            for (unsigned int slot = 0; slot < MAX_LIGHTS; ++slot) {
+                const Light &light = m_Lights[slot];
+                block.lights[slot] = glm::vec4(light.position, light.farPlane);
+                for (unsigned int face = 0; face < 6; ++face) {
+                    const Tile &tile = light.tiles[face];
+                    block.faces[slot * 6 + face] = light.allocated && light.faces[face].rendered
+                            ? glm::vec4((float) tile.x / m_Size, (float) tile.y / m_Size, (float) light.faceSize / m_Size, (float) tile.layer)
+                            : glm::vec4(0.0f);
+                }
+            }
+            m_Block.update(block);
+        }
+
+        const glm::vec3& lightPosition(unsigned int slot) const { return m_Lights[slot].position; }
+        float lightFarPlane(unsigned int slot) const { return m_Lights[slot].farPlane; }
+        unsigned int texture() const { return m_Texture; }
+        const ShadowAtlasStats& stats() const { return m_Stats; }
+
+    private:
+        struct Tile {
+            unsigned int x, y, layer;
+        };
+
+        // what a face was last rendered with
+        struct Face {
+            bool rendered = false;
+            bool casters = false;       // false once the static casters moved
+            glm::vec3 position = glm::vec3(0.0f);
+            float farPlane = 0.0f;
+            uint64_t frame = 0;
+        };
+
+        struct Light {
+            bool seen = false;
+            bool allocated = false;
+            glm::vec3 position = glm::vec3(0.0f);
+            float farPlane = 0.0f;
+            float coverage = 0.0f;
+            unsigned int faceSize = 0;
+            Tile tiles[6];
+            Face faces[6];
+        };
+
+        struct Candidate {
+            float priority;
+            ShadowAtlasUpdate update;
+        };
+
+        unsigned int m_Size, m_Layers;
+        unsigned int m_Texture = 0, m_FBO = 0;
+        unsigned int m_AttachedLayer = 0;
+        UniformBuffer<ShadowAtlasBlock> m_Block;
+        std::vector<std::vector<Tile>> m_Levels;    // free tiles per level, level l is m_Size >> l wide
+        std::vector<Light> m_Lights;
+        std::vector<Candidate> m_Candidates;
+        std::vector<ShadowAtlasUpdate> m_Updates;
+        ShadowAtlasStats m_Stats;
+        uint64_t m_Frame = 0;
+        uint64_t m_StaticCasters = 0;
+        bool m_CastersChanged = true;
+
+        // face size for the coverage. a light only drops to a smaller size once it is well below the threshold
+        // of its current one, so a camera hovering around a threshold doesn't reallocate it every frame.
+        static unsigned int chooseFaceSize(float coverage, unsigned int current) {
+            unsigned int size = coverage >= 0.5f ? MAX_FACE_SIZE : coverage >= 0.2f ? MAX_FACE_SIZE / 2 : MIN_FACE_SIZE;
+            if (size < current) {
+                float threshold = current == MAX_FACE_SIZE ? 0.5f : current == MAX_FACE_SIZE / 2 ? 0.2f : 0.0f;
+                if (coverage >= threshold * 0.75f)
+                    return current;
+            }
+            return size;
+        }
+
+        unsigned int levelOf(unsigned int size) const {
+            unsigned int level = 0;
+            while ((m_Size >> level) > size)
+                level++;
+            return level;
+        }
+
+        // six tiles of faceSize, or smaller ones when the atlas is too full. the faces start unrendered.
+        void allocate(Light &light, unsigned int faceSize) {
+            release(light);
+            for (unsigned int size = faceSize; size >= MIN_FACE_SIZE; size /= 2) {
+                unsigned int level = levelOf(size);
+                unsigned int face = 0;
+                for (; face < 6; ++face)
+                    if (!allocateTile(level, light.tiles[face]))
+                        break;
+                if (face == 6) {
+                    light.allocated = true;
+                    light.faceSize = size;
+                    for (Face &state : light.faces)
+                        state = Face();
+                    return;
+                }
+                while (face > 0)
+                    freeTile(level, light.tiles[--face]);
+            }
+        }
+
+        void release(Light &light) {
+            if (!light.allocated)
+                return;
+            unsigned int level = levelOf(light.faceSize);
+            for (const Tile &tile : light.tiles)
+                freeTile(level, tile);
+            light.allocated = false;
+        }
+
+        bool allocateTile(unsigned int level, Tile &tile) {
+            std::vector<Tile> &free = m_Levels[level];
+            if (free.empty()) {
+                Tile parent;
+                if (level == 0 || !allocateTile(level - 1, parent))
+                    return false;
+                unsigned int size = m_Size >> level;
+                free.push_back(Tile{parent.x + size, parent.y, parent.layer});
+                free.push_back(Tile{parent.x, parent.y + size, parent.layer});
+                free.push_back(Tile{parent.x + size, parent.y + size, parent.layer});
+                tile = parent;
+                return true;
+            }
+            tile = free.back();
+            free.pop_back();
+            return true;
+        }
+
+        // returns the tile and merges it back into its parent when its three siblings are free as well
+        void freeTile(unsigned int level, const Tile &tile) {
+            std::vector<Tile> &free = m_Levels[level];
+            free.push_back(tile);
+            if (level == 0)
+                return;
+            unsigned int parentSize = m_Size >> (level - 1);
+            Tile parent{tile.x - tile.x % parentSize, tile.y - tile.y % parentSize, tile.layer};
+            auto isSibling = [&](const Tile &other) {
+                return other.layer == parent.layer && other.x - other.x % parentSize == parent.x
+                       && other.y - other.y % parentSize == parent.y;
+            };
+            if (std::count_if(free.begin(), free.end(), isSibling) < 4)
+                return;
+            free.erase(std::remove_if(free.begin(), free.end(), isSibling), free.end());
+            freeTile(level - 1, parent);
+        }
+    };
+
+};
+
+#endif //PROJECT_BASE_SHADOWATLAS_H
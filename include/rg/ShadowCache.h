@@ -0,0 +1,138 @@
+#ifndef PROJECT_BASE_SHADOWCACHE_H
+#define PROJECT_BASE_SHADOWCACHE_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <rg/GLState.h>
+#include <rg/TextureRegistry.h>
+
+#include <cstdint>
+#include <vector>
+
+// Point light shadows of the static casters, rendered into a depth cubemap that is kept until the light or one
+// of the casters moves, so a scene standing still costs no shadow pass at all. Nothing in the scene moves yet;
+// moving casters would be drawn every frame on top of a copy of the cached cubemap.
+namespace rg {
+
+    // view-projection of each cube face as seen from the light, in GL_TEXTURE_CUBE_MAP_POSITIVE_X + face order
+    inline void pointShadowMatrices(const glm::vec3 &lightPos, float nearPlane, float farPlane, glm::mat4 matrices[6]) {
+        glm::mat4 projection = glm::perspective(glm::radians(90.0f), 1.0f, nearPlane, farPlane);
+        matrices[0] = projection * glm::lookAt(lightPos, lightPos + glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f));
+        matrices[1] = projection * glm::lookAt(lightPos, lightPos + glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f));
+        matrices[2] = projection * glm::lookAt(lightPos, lightPos + glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+        matrices[3] = projection * glm::lookAt(lightPos, lightPos + glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f));
+        matrices[4] = projection * glm::lookAt(lightPos, lightPos + glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, -1.0f, 0.0f));
+        matrices[5] = projection * glm::lookAt(lightPos, lightPos + glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, -1.0f, 0.0f));
+    }
+
+    // hash of the transforms of the static casters, changes whenever one of them moves
+    inline uint64_t hashTransforms(const std::vector<glm::mat4> &transforms) {
+        return hashBytes(reinterpret_cast<const unsigned char*>(transforms.data()), transforms.size() * sizeof(glm::mat4));
+    }
+
+    class PointShadowCache {
+    public:
+        explicit PointShadowCache(unsigned int size)
+                : m_Size(size) {
+            createCubemap(m_StaticCubemap, m_StaticFBO);
+        }
+
+        ~PointShadowCache() {
+            GLState &state = GLState::instance();
+            state.textureDeleted(m_StaticCubemap);
+            glDeleteTextures(1, &m_StaticCubemap);
+            state.framebufferDeleted(m_StaticFBO);
+            glDeleteFramebuffers(1, &m_StaticFBO);
+            for (unsigned int framebuffer : m_FaceFBOs) {
+                if (framebuffer) {
+                    state.framebufferDeleted(framebuffer);
+                    glDeleteFramebuffers(1, &framebuffer);
+                }
+            }
+        }
+
+        PointShadowCache(const PointShadowCache&) = delete;
+        PointShadowCache& operator=(const PointShadowCache&) = delete;
+
+        // whether the static cubemap was rendered for another light or another placement of the static casters
+        bool isStale(const glm::vec3 &lightPos, float farPlane, uint64_t staticCasters) const {
+            return !m_Valid || lightPos != m_LightPos || farPlane != m_FarPlane || staticCasters != m_StaticCasters;
+        }
+
+        // binds and clears the static cubemap, the caller draws the static casters into it. the light and the
+        // caster hash are remembered, so isStale is false until one of them changes.
+        void beginStatic(const glm::vec3 &lightPos, float farPlane, uint64_t staticCasters) {
+            m_Valid = true;
+            m_LightPos = lightPos;
+            m_FarPlane = farPlane;
+            m_StaticCasters = staticCasters;
+            m_StaticRenders++;
+            GLState::instance().viewport(0, 0, m_Size, m_Size);
+            GLState::instance().bindFramebuffer(m_StaticFBO);
+            glClear(GL_DEPTH_BUFFER_BIT);
+        }
+
+        // binds a single face of the static cubemap, for drawing the faces one by one with the SINGLE_FACE shaders
+        // instead of amplifying every triangle to all six in the geometry shader. call after beginStatic.
+        void bindStaticFace(unsigned int face) {
+            GLState &state = GLState::instance();
+            if (!m_FaceFBOs[face]) {
+                glGenFramebuffers(1, &m_FaceFBOs[face]);
+                state.bindFramebuffer(m_FaceFBOs[face]);
+                glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, m_StaticCubemap, 0);
+                glDrawBuffer(GL_NONE);
+                glReadBuffer(GL_NONE);
+            }
+            state.bindFramebuffer(m_FaceFBOs[face]);
+        }
+
+        unsigned int cubemap() const {
+            return m_StaticCubemap;
+        }
+
+        // how often the static cubemap has been rendered since startup
+        unsigned int staticRenderCount() const {
+            return m_StaticRenders;
+        }
+
+        unsigned int size() const {
+            return m_Size;
+        }
+
+    private:
+        unsigned int m_Size;
+        unsigned int m_StaticCubemap = 0, m_StaticFBO = 0;
+        unsigned int m_FaceFBOs[6] = {0, 0, 0, 0, 0, 0};
+        bool m_Valid = false;
+        glm::vec3 m_LightPos = glm::vec3(0.0f);
+        float m_FarPlane = 0.0f;
+        uint64_t m_StaticCasters = 0;
+        unsigned int m_StaticRenders = 0;
+
+        // a layered depth cubemap and a framebuffer with all six faces attached, for the geometry shader pass
+        void createCubemap(unsigned int &cubemap, unsigned int &framebuffer) {
+            GLState &state = GLState::instance();
+            glGenTextures(1, &cubemap);
+            state.bindTexture(GL_TEXTURE_CUBE_MAP, cubemap);
+            for (unsigned int face = 0; face < 6; ++face)
+                glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, GL_DEPTH_COMPONENT, m_Size, m_Size, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+
+            glGenFramebuffers(1, &framebuffer);
+            state.bindFramebuffer(framebuffer);
+            glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, cubemap, 0);
+            glDrawBuffer(GL_NONE);
+            glReadBuffer(GL_NONE);
+            state.bindFramebuffer(0);
+        }
+    };
+
+};
+
+#endif //PROJECT_BASE_SHADOWCACHE_H
@@ -0,0 +1,131 @@
+#ifndef PROJECT_BASE_TEXTUREREGISTRY_H
+#define PROJECT_BASE_TEXTUREREGISTRY_H
+
+#include <glad/glad.h>
+
+#include <rg/GLState.h>
+#include <rg/MappedFile.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <unordered_map>
+
+namespace rg {
+
+    // 64 bit FNV-1a over 8 byte words (plus the tail bytes), fast enough to hash every texture file at startup.
+    inline uint64_t hashBytes(const unsigned char *data, size_t size) {
+        const uint64_t prime = 1099511628211ull;
+        uint64_t hash = 14695981039346656037ull ^ size;
+        size_t i = 0;
+        for (; i + 8 <= size; i += 8) {
+            uint64_t word;
+            std::memcpy(&word, data + i, 8);
+            hash = (hash ^ word) * prime;
+            hash ^= hash >> 29;
+        }
+        for (; i < size; ++i)
+            hash = (hash ^ data[i]) * prime;
+        return hash;
+    }
+
+    // Process wide registry of GL textures keyed by the contents of the image file, so the same image
+    // referenced by several models (or under several paths) is decoded and resident exactly once.
+    // Every acquire has to be paired with a release, the texture is deleted when the last reference goes away.
+    // The usage string separates uploads of the same file that differ in flipping or sampler state.
+    class TextureRegistry {
+    public:
+        typedef std::function<unsigned int()> CreateTexture;
+
+        static TextureRegistry& instance() {
+            static TextureRegistry registry;
+            return registry;
+        }
+
+        // returns the texture for the file, calling create only if no texture with the same contents
+        // and usage is resident yet.
+        unsigned int acquire(std::string const &path, std::string const &usage, CreateTexture const &create) {
+            std::string key = contentKey(path, usage);
+            auto it = m_Entries.find(key);
+            if (it != m_Entries.end()) {
+                ++it->second.references;
+                ++m_Hits;
+                return it->second.id;
+            }
+            Entry entry;
+            entry.id = create();
+            entry.references = 1;
+            m_Entries[key] = entry;
+            m_Keys[entry.id] = key;
+            return entry.id;
+        }
+
+        void release(unsigned int id) {
+            if (m_ShutDown)
+                return;
+            auto key = m_Keys.find(id);
+            if (key == m_Keys.end())
+                return;
+            auto it = m_Entries.find(key->second);
+            if (--it->second.references == 0) {
+                GLState::instance().textureDeleted(id);
+                glDeleteTextures(1, &id);
+                m_Entries.erase(it);
+                m_Keys.erase(key);
+            }
+        }
+
+        // deletes every resident texture while the GL context still exists, later releases (e.g. from Model
+        // destructors that run after the context is gone) become no-ops.
+        void shutdown() {
+            for (auto &entry : m_Entries) {
+                GLState::instance().textureDeleted(entry.second.id);
+                glDeleteTextures(1, &entry.second.id);
+            }
+            m_Entries.clear();
+            m_Keys.clear();
+            m_ShutDown = true;
+        }
+
+        size_t residentCount() const { return m_Entries.size(); }
+        // how many acquires were served by an already resident texture
+        size_t hitCount() const { return m_Hits; }
+
+    private:
+        struct Entry {
+            unsigned int id;
+            unsigned int references;
+        };
+
+        std::unordered_map<std::string, Entry> m_Entries;        // content key -> texture
+        std::unordered_map<unsigned int, std::string> m_Keys;     // texture -> content key
+        std::unordered_map<std::string, std::string> m_PathKeys;  // path + usage -> content key, so a file is hashed once
+        size_t m_Hits = 0;
+        bool m_ShutDown = false;
+
+        std::string contentKey(std::string const &path, std::string const &usage) {
+            std::string pathKey = usage + '|' + path;
+            auto cached = m_PathKeys.find(pathKey);
+            if (cached != m_PathKeys.end())
+                return cached->second;
+
+            std::string key;
+            MappedFile file;
+            if (file.open(path)) {
+                char hash[17];
+                snprintf(hash, sizeof(hash), "%016llx", (unsigned long long) hashBytes(file.data(), file.size()));
+                key = usage + '|' + std::to_string(file.size()) + '|' + hash;
+            } else {
+                // unreadable files are keyed by path, creating the texture reports the error
+                key = pathKey;
+            }
+            m_PathKeys[pathKey] = key;
+            return key;
+        }
+    };
+
+};
+
+#endif //PROJECT_BASE_TEXTUREREGISTRY_H
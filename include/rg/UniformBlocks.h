@@ -0,0 +1,209 @@
+#ifndef PROJECT_BASE_UNIFORMBLOCKS_H
+#define PROJECT_BASE_UNIFORMBLOCKS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <rg/CpuProfiler.h>
+
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+// Per-frame data shared by every program through std140 uniform blocks. The C++ structs mirror the GLSL
+// declarations byte for byte (vec3 is padded to 16 bytes, a float may follow in the padding), Shader binds
+// every block it finds to the fixed binding point of its name, and the buffers are written once per frame.
+// A block that takes several values in a frame (the Shadow block of each shadowed light) is a
+// UniformBufferArray, all values are written together and the binding point is moved between them.
+//
+//   layout (std140) uniform Camera  { mat4 projection; mat4 view; vec3 viewPosition; };
+//   layout (std140) uniform Lights  { PointLight pointLight; DirectionLight dirlight; };
+//   layout (std140) uniform Shadow  { mat4 shadowMatrices[6]; vec3 lightPos; float far_plane; bool shadows; };
+//   layout (std140) uniform Clusters { uvec4 clusterGrid; vec4 clusterDepth; };
+//   layout (std140) uniform ShadowAtlas { vec4 atlasLights[8]; vec4 atlasFaces[48]; };
+//   layout (std140) uniform Cascades { mat4 cascadeMatrices[4]; vec4 cascadeSplits; int cascadeCount; };
+namespace rg {
+
+    const GLuint CAMERA_BLOCK_BINDING = 0;
+    const GLuint LIGHTS_BLOCK_BINDING = 1;
+    const GLuint SHADOW_BLOCK_BINDING = 2;
+    const GLuint CLUSTERS_BLOCK_BINDING = 3;
+    const GLuint SHADOW_ATLAS_BLOCK_BINDING = 4;
+    const GLuint CASCADES_BLOCK_BINDING = 5;
+
+    // lights the shadow atlas holds at most, the array sizes of the ShadowAtlas block
+    const unsigned int SHADOW_ATLAS_LIGHTS = 8;
+
+    // binding point of a block by its GLSL name, -1 for blocks that aren't shared
+    inline GLint uniformBlockBinding(const char *blockName) {
+        if (std::strcmp(blockName, "Camera") == 0)
+            return CAMERA_BLOCK_BINDING;
+        if (std::strcmp(blockName, "Lights") == 0)
+            return LIGHTS_BLOCK_BINDING;
+        if (std::strcmp(blockName, "Shadow") == 0)
+            return SHADOW_BLOCK_BINDING;
+        if (std::strcmp(blockName, "Clusters") == 0)
+            return CLUSTERS_BLOCK_BINDING;
+        if (std::strcmp(blockName, "ShadowAtlas") == 0)
+            return SHADOW_ATLAS_BLOCK_BINDING;
+        if (std::strcmp(blockName, "Cascades") == 0)
+            return CASCADES_BLOCK_BINDING;
+        return -1;
+    }
+
+    struct CameraBlock {
+        glm::mat4 projection;
+        glm::mat4 view;
+        glm::vec3 viewPosition;
+        float padding;
+    };
+
+    // struct PointLight { vec3 position; float constant; vec3 ambient; float linear; vec3 diffuse; float quadratic; vec3 specular; };
+    struct PointLightBlock {
+        glm::vec3 position;
+        float constant;
+        glm::vec3 ambient;
+        float linear;
+        glm::vec3 diffuse;
+        float quadratic;
+        glm::vec3 specular;
+        float padding;
+    };
+
+    // struct DirectionLight { vec3 direction; vec3 ambient; vec3 diffuse; vec3 specular; };
+    struct DirectionLightBlock {
+        glm::vec3 direction;
+        float padding0;
+        glm::vec3 ambient;
+        float padding1;
+        glm::vec3 diffuse;
+        float padding2;
+        glm::vec3 specular;
+        float padding3;
+    };
+
+    struct LightsBlock {
+        PointLightBlock pointLight;
+        DirectionLightBlock dirlight;
+    };
+
+    struct ShadowBlock {
+        glm::mat4 shadowMatrices[6];
+        glm::vec3 lightPos;
+        float farPlane;
+        GLint shadows;          // GLSL bool, 4 bytes in std140
+        GLint padding[3];
+    };
+
+    // the light grid of rg::ClusteredLights
+    struct ClustersBlock {
+        glm::uvec4 grid;        // clusters along x, y and z, number of lights
+        glm::vec4 depth;        // near, far, slice scale and bias: slice = log(depth) * scale + bias
+    };
+
+    // the cube faces of the lights in rg::ShadowAtlas
+    struct ShadowAtlasBlock {
+        glm::vec4 lights[SHADOW_ATLAS_LIGHTS];          // position, far plane
+        glm::vec4 faces[SHADOW_ATLAS_LIGHTS * 6];       // uv offset, uv size and layer of the face's tile, size 0 until rendered
+    };
+
+    // the directional light's shadow cascades of rg::CascadedShadowMap
+    struct CascadesBlock {
+        glm::mat4 matrices[4];  // world to the light space of each cascade
+        glm::vec4 splits;       // view space distance where each cascade ends
+        GLint count;
+        GLint padding[3];
+    };
+
+    static_assert(sizeof(CameraBlock) == 144, "Camera block doesn't match its std140 layout");
+    static_assert(sizeof(PointLightBlock) == 64 && sizeof(DirectionLightBlock) == 64, "light structs don't match their std140 layout");
+    static_assert(offsetof(LightsBlock, dirlight) == 64 && sizeof(LightsBlock) == 128, "Lights block doesn't match its std140 layout");
+    static_assert(offsetof(ShadowBlock, lightPos) == 384 && offsetof(ShadowBlock, farPlane) == 396
+                  && offsetof(ShadowBlock, shadows) == 400, "Shadow block doesn't match its std140 layout");
+    static_assert(sizeof(ClustersBlock) == 32, "Clusters block doesn't match its std140 layout");
+    static_assert(sizeof(ShadowAtlasBlock) == 896, "ShadowAtlas block doesn't match its std140 layout");
+    static_assert(offsetof(CascadesBlock, splits) == 256 && offsetof(CascadesBlock, count) == 272,
+                  "Cascades block doesn't match its std140 layout");
+
+    // a uniform buffer holding one block, bound to its binding point for the lifetime of the object.
+    template<typename Block>
+    class UniformBuffer {
+    public:
+        explicit UniformBuffer(GLuint binding) {
+            glGenBuffers(1, &m_Buffer);
+            glBindBuffer(GL_UNIFORM_BUFFER, m_Buffer);
+            glBufferData(GL_UNIFORM_BUFFER, sizeof(Block), nullptr, GL_DYNAMIC_DRAW);
+            glBindBufferBase(GL_UNIFORM_BUFFER, binding, m_Buffer);
+            glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        }
+
+        ~UniformBuffer() {
+            glDeleteBuffers(1, &m_Buffer);
+        }
+
+        UniformBuffer(const UniformBuffer&) = delete;
+        UniformBuffer& operator=(const UniformBuffer&) = delete;
+
+        void update(const Block &block) {
+            RG_PROFILE_ZONE("Uniform upload");
+            glBindBuffer(GL_UNIFORM_BUFFER, m_Buffer);
+            glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(Block), &block);
+            glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        }
+
+    private:
+        GLuint m_Buffer = 0;
+    };
+
+    // count blocks in one uniform buffer, each at an offset glBindBufferRange accepts. bind(0) is bound to the
+    // binding point for the lifetime of the object until bind selects another one.
+    template<typename Block>
+    class UniformBufferArray {
+    public:
+        UniformBufferArray(GLuint binding, unsigned int count) : m_Binding(binding), m_Blocks(count) {
+            GLint alignment = 256;
+            glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+            m_Stride = (sizeof(Block) + alignment - 1) / alignment * alignment;
+            m_Staging.resize(m_Stride * count);
+            glGenBuffers(1, &m_Buffer);
+            glBindBuffer(GL_UNIFORM_BUFFER, m_Buffer);
+            glBufferData(GL_UNIFORM_BUFFER, m_Staging.size(), nullptr, GL_DYNAMIC_DRAW);
+            glBindBuffer(GL_UNIFORM_BUFFER, 0);
+            bind(0);
+        }
+
+        ~UniformBufferArray() {
+            glDeleteBuffers(1, &m_Buffer);
+        }
+
+        UniformBufferArray(const UniformBufferArray&) = delete;
+        UniformBufferArray& operator=(const UniformBufferArray&) = delete;
+
+        Block& operator[](unsigned int index) { return m_Blocks[index]; }
+
+        // uploads every block, once a frame before the first draw that reads any of them
+        void update() {
+            RG_PROFILE_ZONE("Uniform upload");
+            for (size_t i = 0; i < m_Blocks.size(); ++i)
+                std::memcpy(&m_Staging[i * m_Stride], &m_Blocks[i], sizeof(Block));
+            glBindBuffer(GL_UNIFORM_BUFFER, m_Buffer);
+            glBufferSubData(GL_UNIFORM_BUFFER, 0, m_Staging.size(), m_Staging.data());
+            glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        }
+
+        // the block the programs read from here on
+        void bind(unsigned int index) {
+            glBindBufferRange(GL_UNIFORM_BUFFER, m_Binding, m_Buffer, index * m_Stride, sizeof(Block));
+        }
+
+    private:
+        GLuint m_Buffer = 0;
+        GLuint m_Binding;
+        std::vector<Block> m_Blocks;
+        std::vector<unsigned char> m_Staging;
+        size_t m_Stride = 0;
+    };
+
+};
+
+#endif //PROJECT_BASE_UNIFORMBLOCKS_H
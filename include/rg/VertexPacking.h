@@ -0,0 +1,92 @@
+#ifndef PROJECT_BASE_VERTEXPACKING_H
+#define PROJECT_BASE_VERTEXPACKING_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+namespace rg {
+
+    // 20 byte vertex, the quantized counterpart of the 56 byte Vertex:
+    //   Position  - 16 bit unorm relative to the mesh bounds, w holds the bitangent sign (0 -> -1, 1 -> +1)
+    //   Normal    - octahedral encoded, 16 bit snorm
+    //   Tangent   - octahedral encoded, 16 bit snorm (the bitangent is cross(normal, tangent) * sign)
+    //   TexCoords - half floats, so tiling coordinates outside [0, 1] still work
+    struct PackedVertex {
+        uint16_t Position[4];
+        int16_t Normal[2];
+        int16_t Tangent[2];
+        uint16_t TexCoords[2];
+    };
+
+    inline uint16_t floatToHalf(float value) {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        uint32_t sign = (bits >> 16) & 0x8000u;
+        int32_t exponent = int32_t((bits >> 23) & 0xFF) - 127 + 15;
+        uint32_t mantissa = bits & 0x7FFFFFu;
+        if (((bits >> 23) & 0xFF) == 0xFF)                     // inf / nan
+            return uint16_t(sign | 0x7C00u | (mantissa ? 0x200u : 0u));
+        if (exponent >= 31)                                     // overflow, clamp to inf
+            return uint16_t(sign | 0x7C00u);
+        if (exponent <= 0) {                                    // subnormal or zero
+            if (exponent < -10)
+                return uint16_t(sign);
+            mantissa |= 0x800000u;
+            uint32_t shift = uint32_t(14 - exponent);
+            uint32_t half = mantissa >> shift;
+            if ((mantissa >> (shift - 1)) & 1u)                 // round half up
+                ++half;
+            return uint16_t(sign | half);
+        }
+        uint32_t half = sign | (uint32_t(exponent) << 10) | (mantissa >> 13);
+        if (mantissa & 0x1000u)                                 // round half up, may carry into the exponent
+            ++half;
+        return uint16_t(half);
+    }
+
+    inline int16_t floatToSnorm16(float value) {
+        return int16_t(std::round(std::min(std::max(value, -1.0f), 1.0f) * 32767.0f));
+    }
+
+    inline uint16_t floatToUnorm16(float value) {
+        return uint16_t(std::round(std::min(std::max(value, 0.0f), 1.0f) * 65535.0f));
+    }
+
+    // octahedral mapping of a unit vector to [-1, 1]^2, the lower hemisphere is folded over the diagonals.
+    inline glm::vec2 octEncode(glm::vec3 n) {
+        float l1 = std::fabs(n.x) + std::fabs(n.y) + std::fabs(n.z);
+        if (l1 <= 0.0f)
+            return glm::vec2(0.0f, 0.0f);
+        n /= l1;
+        if (n.z >= 0.0f)
+            return glm::vec2(n.x, n.y);
+        return glm::vec2((1.0f - std::fabs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f),
+                         (1.0f - std::fabs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f));
+    }
+
+    inline PackedVertex packVertex(const glm::vec3 &position, const glm::vec3 &normal, const glm::vec2 &texCoords,
+                                   const glm::vec3 &tangent, const glm::vec3 &bitangent,
+                                   const glm::vec3 &boundsMin, const glm::vec3 &boundsExtent) {
+        PackedVertex packed;
+        for (int i = 0; i < 3; ++i)
+            packed.Position[i] = floatToUnorm16(boundsExtent[i] > 0.0f ? (position[i] - boundsMin[i]) / boundsExtent[i] : 0.0f);
+        // handedness of the tangent frame, so the bitangent can be rebuilt from normal and tangent
+        packed.Position[3] = glm::dot(glm::cross(normal, tangent), bitangent) < 0.0f ? 0 : 65535;
+        glm::vec2 n = octEncode(normal);
+        packed.Normal[0] = floatToSnorm16(n.x);
+        packed.Normal[1] = floatToSnorm16(n.y);
+        glm::vec2 t = octEncode(tangent);
+        packed.Tangent[0] = floatToSnorm16(t.x);
+        packed.Tangent[1] = floatToSnorm16(t.y);
+        packed.TexCoords[0] = floatToHalf(texCoords.x);
+        packed.TexCoords[1] = floatToHalf(texCoords.y);
+        return packed;
+    }
+
+};
+
+#endif //PROJECT_BASE_VERTEXPACKING_H
@@ -3,14 +3,12 @@ out vec4 FragColor;
 
 struct PointLight {
     vec3 position;
-
-    vec3 specular;
-    vec3 diffuse;
-    vec3 ambient;
-
     float constant;
+    vec3 ambient;
     float linear;
+    vec3 diffuse;
     float quadratic;
+    vec3 specular;
 };
 
 struct DirectionLight{
@@ -34,14 +32,46 @@ in vec2 TexCoords;
 in vec3 Normal;
 in vec3 FragPos;
 
-uniform PointLight pointLight;
-uniform DirectionLight dirlight;
 uniform Material material;
 
-uniform bool shadows;
-uniform float far_plane;
+// shared per-frame block, see rg/UniformBlocks.h
+layout (std140) uniform Camera {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPosition;
+};
+layout (std140) uniform Lights {
+    PointLight pointLight;
+    DirectionLight dirlight;
+};
+layout (std140) uniform Shadow {
+    mat4 shadowMatrices[6];
+    vec3 lightPos;
+    float far_plane;
+    bool shadows;
+};
+// the small point lights, sorted into clusters on the CPU, see rg/ClusteredLights.h
+layout (std140) uniform Clusters {
+    uvec4 clusterGrid;      // clusters along x, y and z, number of lights
+    vec4 clusterDepth;      // near, far, slice scale and bias
+};
+uniform samplerBuffer clusterLights;
+uniform usamplerBuffer clusterRanges;
+uniform usamplerBuffer clusterIndices;
+// cube faces of the shadowed cluster lights, see rg/ShadowAtlas.h
+layout (std140) uniform ShadowAtlas {
+    vec4 atlasLights[8];    // position, far plane
+    vec4 atlasFaces[48];    // uv offset, uv size and layer of each face's tile, size 0 until rendered
+};
+uniform sampler2DArray shadowAtlas;
+// the directional light's shadow cascades, see rg/CascadedShadows.h
+layout (std140) uniform Cascades {
+    mat4 cascadeMatrices[4];
+    vec4 cascadeSplits;     // view space distance where each cascade ends
+    int cascadeCount;
+};
+uniform sampler2DArrayShadow cascadeShadowMap;
 
-uniform vec3 viewPosition;
 // calculates the color when using a point light.
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir,float shadow)
 {
@@ -74,7 +104,7 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir,fl
    else return (ambient + (1.0-shadow)* (diffuse + specular));
 }
 
-vec3 calculateDirLight(DirectionLight light,vec3 normal,vec3 fragPos,vec3 viewDir){
+vec3 calculateDirLight(DirectionLight light,vec3 normal,vec3 fragPos,vec3 viewDir,float shadow){
     vec3 lightdir=normalize(-light.direction);
     float diff = max(dot(normal, lightdir), 0.0);
 
@@ -87,8 +117,24 @@ vec3 calculateDirLight(DirectionLight light,vec3 normal,vec3 fragPos,vec3 viewDi
     vec3 diffuse = light.diffuse * diff * vec3(texture(material.texture_diffuse1, TexCoords));
     vec3 specular = light.specular * spec * vec3(texture(material.texture_specular1, TexCoords).xxx);
 
-    return (ambient+diffuse+specular);
+    if(shadows)return (ambient+diffuse+specular);
+    else return (ambient + (1.0-shadow)* (diffuse + specular));
+
+}
 
+// the first cascade that reaches the fragment's view depth, compared with 2x2 PCF
+float calcDirShadow(DirectionLight light, vec3 normal, vec3 fragPos)
+{
+    float depth = -(view * vec4(fragPos, 1.0)).z;
+    int cascade = 0;
+    while (cascade < cascadeCount && depth > cascadeSplits[cascade])
+        ++cascade;
+    if (cascade >= cascadeCount)
+        return 0.0;
+    vec4 lightSpace = cascadeMatrices[cascade] * vec4(fragPos, 1.0);
+    vec3 coords = lightSpace.xyz / lightSpace.w * 0.5 + 0.5;
+    float bias = max(0.002 * (1.0 - dot(normal, normalize(-light.direction))), 0.0005);
+    return 1.0 - texture(cascadeShadowMap, vec4(coords.xy, float(cascade), coords.z - bias));
 }
 
 float calcShadow(PointLight light,vec3 fragPos){
@@ -104,6 +150,54 @@ float calcShadow(PointLight light,vec3 fragPos){
            return shadow;
 }
 
+// the cluster is found from FragPos rather than gl_FragCoord, so it doesn't depend on the viewport
+int clusterIndex(vec3 fragPos)
+{
+    vec4 viewPos = view * vec4(fragPos, 1.0);
+    vec4 clip = projection * viewPos;
+    vec2 screen = clamp(clip.xy / clip.w * 0.5 + 0.5, 0.0, 0.999);
+    int slice = int(floor(log(max(-viewPos.z, clusterDepth.x)) * clusterDepth.z + clusterDepth.w));
+    ivec3 cluster = ivec3(ivec2(screen * vec2(clusterGrid.xy)), clamp(slice, 0, int(clusterGrid.z) - 1));
+    return cluster.x + int(clusterGrid.x) * (cluster.y + int(clusterGrid.y) * cluster.z);
+}
+
+// the shadow of an atlas light, the face and its uv follow the cubemap face selection rules, which the
+// pointShadowMatrices the faces are rendered with match
+float calcAtlasShadow(int slot, vec3 fragPos)
+{
+    vec3 fragToLight = fragPos - atlasLights[slot].xyz;
+    vec3 a = abs(fragToLight);
+    int face;
+    vec2 st;
+    if (a.x >= a.y && a.x >= a.z) {
+        face = fragToLight.x > 0.0 ? 0 : 1;
+        st = vec2(fragToLight.x > 0.0 ? -fragToLight.z : fragToLight.z, -fragToLight.y) / a.x;
+    } else if (a.y >= a.z) {
+        face = fragToLight.y > 0.0 ? 2 : 3;
+        st = vec2(fragToLight.x, fragToLight.y > 0.0 ? fragToLight.z : -fragToLight.z) / a.y;
+    } else {
+        face = fragToLight.z > 0.0 ? 4 : 5;
+        st = vec2(fragToLight.z > 0.0 ? fragToLight.x : -fragToLight.x, -fragToLight.y) / a.z;
+    }
+    vec4 tile = atlasFaces[slot * 6 + face];
+    if (tile.z <= 0.0)
+        return 0.0;
+    // half a texel in from the tile's edges, the neighbouring tiles belong to other faces
+    float inset = 0.5 / (tile.z * float(textureSize(shadowAtlas, 0).x));
+    vec2 uv = clamp(st * 0.5 + 0.5, inset, 1.0 - inset);
+    float closestDepth = texture(shadowAtlas, vec3(tile.xy + uv * tile.z, tile.w)).r * atlasLights[slot].w;
+    float bias = 0.05;
+    return length(fragToLight) - bias > closestDepth ? 1.0 : 0.0;
+}
+
+PointLight fetchClusterLight(int index)
+{
+    vec4 position = texelFetch(clusterLights, index * 5);
+    vec4 ambient = texelFetch(clusterLights, index * 5 + 1);
+    vec4 diffuse = texelFetch(clusterLights, index * 5 + 2);
+    vec4 specular = texelFetch(clusterLights, index * 5 + 3);
+    return PointLight(position.xyz, position.w, ambient.rgb, ambient.w, diffuse.rgb, diffuse.w, specular.rgb);
+}
 
 void main()
 {
@@ -111,6 +205,14 @@ void main()
     vec3 viewDir = normalize(viewPosition - FragPos);
     float shadow = calcShadow(pointLight,FragPos) ;
     vec3 result = CalcPointLight(pointLight, normal, FragPos, viewDir,shadow);
-    result+=calculateDirLight(dirlight,normal,FragPos,viewDir);
+    result+=calculateDirLight(dirlight,normal,FragPos,viewDir,calcDirShadow(dirlight,normal,FragPos));
+    uvec2 range = texelFetch(clusterRanges, clusterIndex(FragPos)).xy;
+    for (uint i = 0u; i < range.y; ++i)
+    {
+        int light = int(texelFetch(clusterIndices, int(range.x + i)).r);
+        int shadowSlot = int(texelFetch(clusterLights, light * 5 + 4).x);
+        float lightShadow = shadowSlot >= 0 ? calcAtlasShadow(shadowSlot, FragPos) : 0.0;
+        result += CalcPointLight(fetchClusterLight(light), normal, FragPos, viewDir, lightShadow);
+    }
     FragColor = vec4(result, 1.0);
 }
\ No newline at end of file
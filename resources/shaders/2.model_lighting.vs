@@ -1,20 +1,59 @@
 #version 330 core
+#ifdef PACKED_VERTICES
+// rg::PackedVertex: position quantized to the mesh bounds, octahedral normal
+layout (location = 0) in vec4 aPos;
+layout (location = 1) in vec2 aNormal;
+#else
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
+#endif
 layout (location = 2) in vec2 aTexCoords;
+#ifdef INSTANCED
+// per-instance model matrix, see Model::DrawInstanced
+layout (location = 5) in mat4 aInstanceModel;
+#endif
 
 out vec2 TexCoords;
 out vec3 Normal;
 out vec3 FragPos;
 
+#ifndef INSTANCED
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+#endif
+// shared per-frame block, see rg/UniformBlocks.h
+layout (std140) uniform Camera {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPosition;
+};
+
+#ifdef PACKED_VERTICES
+uniform vec3 meshBoundsMin;
+uniform vec3 meshBoundsExtent;
+
+vec3 octDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(n);
+}
+#endif
 
 void main()
 {
-    FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = transpose(inverse(mat3(model))) * aNormal;
+#ifdef INSTANCED
+    mat4 model = aInstanceModel;
+#endif
+#ifdef PACKED_VERTICES
+    vec3 position = meshBoundsMin + aPos.xyz * meshBoundsExtent;
+    vec3 normal = octDecode(aNormal);
+#else
+    vec3 position = aPos;
+    vec3 normal = aNormal;
+#endif
+    FragPos = vec3(model * vec4(position, 1.0));
+    Normal = transpose(inverse(mat3(model))) * normal;
     TexCoords = aTexCoords;    
-    gl_Position = projection * view *model* vec4(FragPos, 1.0);
+    gl_Position = projection * view * vec4(FragPos, 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,6 @@
+#version 330 core
+
+// depth only, the cascades store the rasterized depth
+void main()
+{
+}
@@ -0,0 +1,24 @@
+#version 330 core
+layout (triangles) in;
+layout (triangle_strip, max_vertices=12) out;
+
+// shared per-frame block, see rg/UniformBlocks.h
+layout (std140) uniform Cascades {
+    mat4 cascadeMatrices[4];
+    vec4 cascadeSplits;
+    int cascadeCount;
+};
+
+void main()
+{
+    for(int cascade = 0; cascade < cascadeCount; ++cascade)
+    {
+        gl_Layer = cascade;
+        for(int i = 0; i < 3; ++i)
+        {
+            gl_Position = cascadeMatrices[cascade] * gl_in[i].gl_Position;
+            EmitVertex();
+        }
+        EndPrimitive();
+    }
+}
@@ -0,0 +1,50 @@
+#version 330 core
+#ifdef VERTEX_LAYER_ARB
+#extension GL_ARB_shader_viewport_layer_array : require
+#endif
+#ifdef VERTEX_LAYER_AMD
+#extension GL_AMD_vertex_shader_layer : require
+#endif
+#ifdef PACKED_VERTICES
+layout (location = 0) in vec4 aPos;
+#else
+layout (location = 0) in vec3 aPos;
+#endif
+#ifdef INSTANCED
+layout (location = 5) in mat4 aInstanceModel;
+#else
+uniform mat4 model;
+#endif
+
+#ifdef PACKED_VERTICES
+uniform vec3 meshBoundsMin;
+uniform vec3 meshBoundsExtent;
+#endif
+
+// shared per-frame block, see rg/UniformBlocks.h
+layout (std140) uniform Cascades {
+    mat4 cascadeMatrices[4];
+    vec4 cascadeSplits;
+    int cascadeCount;
+};
+
+// LAYERED_CASCADES: every caster is drawn once per cascade as consecutive instances, the instance picks the
+// cascade and the layer it is written to (see rg::Pipeline::layers). without it cascade.gs does that.
+void main()
+{
+#ifdef INSTANCED
+    mat4 model = aInstanceModel;
+#endif
+#ifdef PACKED_VERTICES
+    vec4 worldPosition = model * vec4(meshBoundsMin + aPos.xyz * meshBoundsExtent, 1.0);
+#else
+    vec4 worldPosition = model * vec4(aPos, 1.0);
+#endif
+#ifdef LAYERED_CASCADES
+    int cascade = gl_InstanceID % cascadeCount;
+    gl_Layer = cascade;
+    gl_Position = cascadeMatrices[cascade] * worldPosition;
+#else
+    gl_Position = worldPosition;
+#endif
+}
@@ -2,7 +2,13 @@
 layout (triangles) in;
 layout (triangle_strip, max_vertices=18) out;
 
-uniform mat4 shadowMatrices[6];
+// shared per-frame block, see rg/UniformBlocks.h
+layout (std140) uniform Shadow {
+    mat4 shadowMatrices[6];
+    vec3 lightPos;
+    float far_plane;
+    bool shadows;
+};
 
 out vec4 FragPos;
 
@@ -8,14 +8,12 @@ in vec3 Normal;
 
 struct PointLight {
     vec3 position;
-
-    vec3 specular;
-    vec3 diffuse;
-    vec3 ambient;
-
     float constant;
+    vec3 ambient;
     float linear;
+    vec3 diffuse;
     float quadratic;
+    vec3 specular;
 };
 
 struct DirectionLight{
@@ -28,9 +26,16 @@ struct DirectionLight{
 };
 
 uniform sampler2D texture1;
-uniform PointLight pointLight;
-uniform DirectionLight dirlight;
-uniform vec3 viewPosition;
+// shared per-frame block, see rg/UniformBlocks.h
+layout (std140) uniform Camera {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPosition;
+};
+layout (std140) uniform Lights {
+    PointLight pointLight;
+    DirectionLight dirlight;
+};
 
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir,vec3 color)
 {
@@ -3,19 +3,41 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec2 aTexCoords;
 layout (location = 2) in vec3 aNormal;
+#ifdef GRASS_INSTANCED
+// rg::GrassInstance: world position, rotation around +y and uniform scale
+layout (location = 3) in vec3 aInstancePosition;
+layout (location = 4) in vec2 aInstanceRotationScale;
+#endif
 
 out vec2 TexCoords;
 out vec3 FragPos;
 out vec3 Normal;
 
+#ifndef GRASS_INSTANCED
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+#endif
+// shared per-frame block, see rg/UniformBlocks.h
+layout (std140) uniform Camera {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPosition;
+};
 
 void main()
 {
+#ifdef GRASS_INSTANCED
+    // a rotation around y and a uniform scale, so the normal only needs the rotation
+    float c = cos(aInstanceRotationScale.x);
+    float s = sin(aInstanceRotationScale.x);
+    mat3 rotation = mat3(c, 0.0, -s,
+                         0.0, 1.0, 0.0,
+                         s, 0.0, c);
+    Normal = rotation * aNormal;
+    FragPos = aInstancePosition + rotation * (aPos * aInstanceRotationScale.y);
+#else
     Normal = transpose(inverse(mat3(model))) * aNormal;
     FragPos = vec3(model * vec4(aPos, 1.0));
+#endif
     TexCoords = aTexCoords;
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    gl_Position = projection * view * vec4(FragPos, 1.0);
 }
@@ -1,8 +1,13 @@
 #version 330 core
 in vec4 FragPos;
 
-uniform vec3 lightPos;
-uniform float far_plane;
+// shared per-frame block, see rg/UniformBlocks.h
+layout (std140) uniform Shadow {
+    mat4 shadowMatrices[6];
+    vec3 lightPos;
+    float far_plane;
+    bool shadows;
+};
 
 void main()
 {
@@ -1,10 +1,63 @@
 #version 330 core
+#ifdef VERTEX_LAYER_ARB
+#extension GL_ARB_shader_viewport_layer_array : require
+#endif
+#ifdef VERTEX_LAYER_AMD
+#extension GL_AMD_vertex_shader_layer : require
+#endif
+#ifdef PACKED_VERTICES
+layout (location = 0) in vec4 aPos;
+#else
 layout (location = 0) in vec3 aPos;
-
+#endif
+#ifdef INSTANCED
+layout (location = 5) in mat4 aInstanceModel;
+#else
 uniform mat4 model;
+#endif
+
+#ifdef PACKED_VERTICES
+uniform vec3 meshBoundsMin;
+uniform vec3 meshBoundsExtent;
+#endif
+
+#if defined(SINGLE_FACE) || defined(LAYERED_FACES)
+// shared per-frame block, see rg/UniformBlocks.h
+layout (std140) uniform Shadow {
+    mat4 shadowMatrices[6];
+    vec3 lightPos;
+    float far_plane;
+    bool shadows;
+};
 
+out vec4 FragPos;
+#endif
+#ifdef SINGLE_FACE
+// one cube face per pass instead of the geometry shader, see rg::PointShadowCache::bindStaticFace
+uniform int shadowFace;
+#endif
+// LAYERED_FACES: every caster is drawn as six instances in one pass, the instance picks the face and the layer
+// it is written to. the per-instance model matrix advances every sixth instance (see rg::Pipeline::layers).
 
 void main()
 {
-    gl_Position = model * vec4(aPos, 1.0);
+#ifdef INSTANCED
+    mat4 model = aInstanceModel;
+#endif
+#ifdef PACKED_VERTICES
+    vec4 worldPosition = model * vec4(meshBoundsMin + aPos.xyz * meshBoundsExtent, 1.0);
+#else
+    vec4 worldPosition = model * vec4(aPos, 1.0);
+#endif
+#if defined(SINGLE_FACE)
+    FragPos = worldPosition;
+    gl_Position = shadowMatrices[shadowFace] * worldPosition;
+#elif defined(LAYERED_FACES)
+    int face = gl_InstanceID % 6;
+    gl_Layer = face;
+    FragPos = worldPosition;
+    gl_Position = shadowMatrices[face] * worldPosition;
+#else
+    gl_Position = worldPosition;
+#endif
 }
\ No newline at end of file
@@ -4,11 +4,15 @@ layout (location = 0) in vec3 aPos;
 
 out vec3 TexCoord;
 
-uniform mat4 projection;
-uniform mat4 view;
+// shared per-frame block, see rg/UniformBlocks.h
+layout (std140) uniform Camera {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPosition;
+};
 
 void main(){
     TexCoord=aPos;
-    vec4 pos=projection * view * vec4(aPos,1.0);
+    vec4 pos=projection * mat4(mat3(view)) * vec4(aPos,1.0);
     gl_Position=pos.xyww;
 }
\ No newline at end of file
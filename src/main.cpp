@@ -14,7 +14,27 @@
 #include <learnopengl/camera.h>
 #include <learnopengl/model.h>
 
+#include <rg/Benchmark.h>
+#include <rg/CascadedShadows.h>
+#include <rg/ClusteredLights.h>
+#include <rg/CpuProfiler.h>
+#include <rg/GLExtensions.h>
+#include <rg/GLInstrumentation.h>
+#include <rg/GpuProfiler.h>
+#include <rg/GrassField.h>
+#include <rg/Headless.h>
+#include <rg/ImageDecodePool.h>
+#include <rg/RenderQueue.h>
+#include <rg/ShadowAtlas.h>
+#include <rg/ShadowCache.h>
+#include <rg/TextureRegistry.h>
+#include <rg/UniformBlocks.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <iostream>
+#include <memory>
 
 void framebuffer_size_callback(GLFWwindow *window, int width, int height);
 
@@ -29,6 +49,12 @@ void key_callback(GLFWwindow *window, int key, int scancode, int action, int mod
 unsigned int loadCubemap(vector<std::string> faces);
 
 unsigned int loadTexture(char const * path);
+
+unsigned int createTexture(char const * path);
+
+void addEmberLights(rg::ClusteredLights &lights, const glm::vec3 &fire, int embers, float time);
+
+rg::PointLightBlock lanternLight(unsigned int corner, float time, bool swing);
 // settings
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
@@ -45,6 +71,14 @@ float lastFrame = 0.0f;
 
 bool shadows=false;
 
+// how the static shadow cubemap is drawn
+enum ShadowPath {
+    SHADOW_GEOMETRY_SHADER,     // one pass, the geometry shader copies every triangle to the six faces
+    SHADOW_PER_FACE,            // six passes, each with the casters culled against its face
+    SHADOW_LAYERED,             // one instanced pass, the vertex shader writes gl_Layer (needs rg::vertexLayerDefine)
+    SHADOW_PATH_COUNT
+};
+
 struct PointLight {
     glm::vec3 position;
     glm::vec3 ambient;
@@ -72,6 +106,29 @@ struct ProgramState {
     glm::vec3 backpackPosition = glm::vec3(0.0f);
     float backpackScale = 1.0f;
     PointLight pointLight;
+    // blades per square unit of the instanced grass field
+    float grassDensity = 2000.0f;
+    // render queue statistics of the last frame, not saved
+    rg::RenderQueueStats shadowPassStats, mainPassStats;
+    // the static point light shadows are drawn again only when the light or a caster moves, unless disabled
+    bool cacheShadows = true;
+    unsigned int shadowCacheRenders = 0;
+    // a ShadowPath, SHADOW_LAYERED is only offered where the driver supports it
+    int shadowPath = SHADOW_PER_FACE;
+    bool layeredShadowsSupported = false;
+    // small lights around the campfire, shaded through the clustered light grid
+    int emberCount = 128;
+    rg::ClusterStats clusterStats;
+    // the lanterns cast shadows through the shadow atlas, which re-renders at most this many faces a frame
+    bool swingLanterns = false;
+    int shadowFaceBudget = 12;
+    rg::ShadowAtlasStats shadowAtlasStats;
+    rg::RenderQueueStats atlasPassStats;
+    // sun shadows over the first shadowDistance units of the view, 0 cascades turns them off
+    int cascadeCount = 4;
+    float cascadeLambda = 0.75f;
+    float shadowDistance = 50.0f;
+    rg::RenderQueueStats cascadePassStats;
     ProgramState()
             : camera(glm::vec3(0.0f, 0.0f, 3.0f)) {}
 
@@ -91,7 +148,8 @@ void ProgramState::SaveToFile(std::string filename) {
         << camera.Position.z << '\n'
         << camera.Front.x << '\n'
         << camera.Front.y << '\n'
-        << camera.Front.z << '\n';
+        << camera.Front.z << '\n'
+        << grassDensity << '\n';
 }
 
 void ProgramState::LoadFromFile(std::string filename) {
@@ -107,6 +165,10 @@ void ProgramState::LoadFromFile(std::string filename) {
            >> camera.Front.x
            >> camera.Front.y
            >> camera.Front.z;
+        // missing in state files written before the grass density was added
+        float density;
+        if (in >> density)
+            grassDensity = density;
     }
 }
 
@@ -116,46 +178,102 @@ bool shadowsKeyPressed=false;
 
 void DrawImGui(ProgramState *programState);
 
-int main() {
-    // glfw: initialize and configure
-    // ------------------------------
-    glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+// glfw: terminate, clearing all previously allocated GLFW resources, when main returns. main declares it before
+// every object that owns GL names, so their destructors run first, while the context is still current.
+struct GlfwSession {
+    bool initialized = false;
 
-#ifdef __APPLE__
-    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-#endif
+    ~GlfwSession() {
+        if (initialized)
+            glfwTerminate();
+    }
+};
 
-    // glfw window creation
-    // --------------------
-    GLFWwindow *window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
-    if (window == NULL) {
-        std::cout << "Failed to create GLFW window" << std::endl;
-        glfwTerminate();
-        return -1;
+int main(int argc, char **argv) {
+    auto startupBegin = std::chrono::steady_clock::now();
+    // CPU zones of the main thread and the startup, see rg/CpuProfiler.h. a no-op unless built with RG_CPU_PROFILER
+    RG_PROFILE_THREAD("Main");
+    RG_PROFILE_BEGIN("Startup");
+    // --headless renders a fixed number of frames offscreen and exits, see rg/Headless.h. --benchmark flies
+    // the camera along a path and reports the frame times, see rg/Benchmark.h
+    rg::HeadlessOptions headless;
+    rg::BenchmarkOptions benchmark;
+    rg::CpuTraceOptions cpuTrace;
+    for (int i = 1; i < argc; ++i) {
+        rg::OptionResult result = rg::parseHeadlessOption(argc, argv, i, headless);
+        if (result == rg::OPTION_UNKNOWN)
+            result = rg::parseBenchmarkOption(argc, argv, i, benchmark);
+        if (result == rg::OPTION_UNKNOWN)
+            result = rg::parseCpuTraceOption(argc, argv, i, cpuTrace);
+        if (result == rg::OPTION_UNKNOWN)
+            std::cout << "Unknown argument: " << argv[i] << std::endl;
+        if (result != rg::OPTION_PARSED)
+            return -1;
     }
-    glfwMakeContextCurrent(window);
-    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-    glfwSetCursorPosCallback(window, mouse_callback);
-    glfwSetScrollCallback(window, scroll_callback);
-    glfwSetKeyCallback(window, key_callback);
-    // tell GLFW to capture our mouse
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-
-    // glad: load all OpenGL function pointers
-    // ---------------------------------------
-    if (!gladLoadGLLoader((GLADloadproc) glfwGetProcAddress)) {
-        std::cout << "Failed to initialize GLAD" << std::endl;
+    rg::CameraPath cameraPath;
+    if (benchmark.enabled && !cameraPath.load(benchmark.path))
         return -1;
+    if (benchmark.enabled && !benchmark.record.empty()) {
+        std::cout << "--record doesn't go with --benchmark" << std::endl;
+        return -1;
+    }
+
+    GLFWwindow *window = NULL;
+    rg::HeadlessContext headlessContext;
+    GlfwSession glfwSession;
+    if (headless.enabled) {
+        if (!headlessContext.create(3, 3, rg::GLInstrumentation::enabled()))
+            return -1;
+    } else {
+        // glfw: initialize and configure
+        // ------------------------------
+        glfwInit();
+        glfwSession.initialized = true;
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        // instrumented builds want every KHR_debug message the driver has
+        glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, rg::GLInstrumentation::enabled());
+
+#ifdef __APPLE__
+        glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+
+        // glfw window creation
+        // --------------------
+        window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
+        if (window == NULL) {
+            std::cout << "Failed to create GLFW window" << std::endl;
+            return -1;
+        }
+        glfwMakeContextCurrent(window);
+        glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+        glfwSetCursorPosCallback(window, mouse_callback);
+        glfwSetScrollCallback(window, scroll_callback);
+        glfwSetKeyCallback(window, key_callback);
+        // tell GLFW to capture our mouse
+        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+
+        // glad: load all OpenGL function pointers
+        // ---------------------------------------
+        if (!gladLoadGLLoader((GLADloadproc) glfwGetProcAddress)) {
+            std::cout << "Failed to initialize GLAD" << std::endl;
+            return -1;
+        }
     }
+    // counts the GL calls from here on and reports GL errors, a no-op unless built with RG_GL_INSTRUMENTATION
+    rg::GLInstrumentation::instance().install(window ? (GLADloadproc) glfwGetProcAddress : headlessContext.loader());
 
-    // tell stb_image.h to flip loaded texture's on the y-axis (before loading model).
-    stbi_set_flip_vertically_on_load(true);
+    // textures are flipped on the y-axis per image by the decode pool (stbi_set_flip_vertically_on_load is global
+    // and would race with the decoding threads), so it's left off here.
 
     programState = new ProgramState;
-    programState->LoadFromFile("resources/program_state.txt");
+    // a benchmark runs with the default settings, whatever the last session left in the state file
+    if (!benchmark.enabled)
+        programState->LoadFromFile("resources/program_state.txt");
+    // there is nothing to show the UI on, and nothing to click it with
+    if (headless.enabled)
+        programState->ImGuiEnabled = false;
     if (programState->ImGuiEnabled) {
        // glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
     }
@@ -167,13 +285,25 @@ int main() {
 
 
 
-    ImGui_ImplGlfw_InitForOpenGL(window, true);
-    ImGui_ImplOpenGL3_Init("#version 330 core");
+    if (window) {
+        ImGui_ImplGlfw_InitForOpenGL(window, true);
+        ImGui_ImplOpenGL3_Init("#version 330 core");
+    }
 
-    // configure global opengl state
+    // configure global opengl state, binds and enables go through the state tracker (see rg/GLState.h)
     // -----------------------------
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_CULL_FACE);
+    rg::GLState &glState = rg::GLState::instance();
+    glState.enable(GL_DEPTH_TEST);
+    glState.enable(GL_CULL_FACE);
+    // without a window the frames go to an offscreen framebuffer of the window's size
+    std::unique_ptr<rg::OffscreenTarget> offscreen;
+    if (headless.enabled) {
+        offscreen.reset(new rg::OffscreenTarget(SCR_WIDTH, SCR_HEIGHT));
+        if (!offscreen->complete()) {
+            std::cout << "Offscreen framebuffer is incomplete" << std::endl;
+            return -1;
+        }
+    }
 
 
 
@@ -183,7 +313,65 @@ int main() {
     Shader ourShader("resources/shaders/2.model_lighting.vs", "resources/shaders/2.model_lighting.fs");
     Shader skybox_shader("resources/shaders/skybox.vs","resources/shaders/skybox.fs");
     Shader shadow_point("resources/shaders/shadow.vs","resources/shaders/shadow.fs","resources/shaders/geometryshader.gs");
-    Shader floor("resources/shaders/grass.vs","resources/shaders/grass.fs");
+    // the models are uploaded as rg::PackedVertex, they are drawn with the PACKED_VERTICES variants
+    Shader ourShaderPacked("resources/shaders/2.model_lighting.vs", "resources/shaders/2.model_lighting.fs", nullptr, {"PACKED_VERTICES"});
+    Shader shadow_point_packed("resources/shaders/shadow.vs","resources/shaders/shadow.fs","resources/shaders/geometryshader.gs", {"PACKED_VERTICES"});
+    // and the mountain tiles with the instanced ones
+    Shader ourShaderInstanced("resources/shaders/2.model_lighting.vs", "resources/shaders/2.model_lighting.fs", nullptr, {"PACKED_VERTICES", "INSTANCED"});
+    Shader shadow_point_instanced("resources/shaders/shadow.vs","resources/shaders/shadow.fs","resources/shaders/geometryshader.gs", {"PACKED_VERTICES", "INSTANCED"});
+    // the same three without the geometry shader, for drawing the shadow cubemap one face at a time
+    Shader shadow_face("resources/shaders/shadow.vs","resources/shaders/shadow.fs", nullptr, {"SINGLE_FACE"});
+    Shader shadow_face_packed("resources/shaders/shadow.vs","resources/shaders/shadow.fs", nullptr, {"PACKED_VERTICES", "SINGLE_FACE"});
+    Shader shadow_face_instanced("resources/shaders/shadow.vs","resources/shaders/shadow.fs", nullptr, {"PACKED_VERTICES", "INSTANCED", "SINGLE_FACE"});
+    Shader floor("resources/shaders/grass.vs","resources/shaders/grass.fs", nullptr, {"GRASS_INSTANCED"});
+    // camera, lights and shadow parameters are shared by every program through uniform blocks written once
+    // per frame (see rg/UniformBlocks.h), the only per-object uniform left is the model matrix.
+    rg::UniformBuffer<rg::CameraBlock> cameraBlock(rg::CAMERA_BLOCK_BINDING);
+    rg::UniformBuffer<rg::LightsBlock> lightsBlock(rg::LIGHTS_BLOCK_BINDING);
+    // the campfire's Shadow block and one for each light of the shadow atlas after it
+    rg::UniformBufferArray<rg::ShadowBlock> shadowBlocks(rg::SHADOW_BLOCK_BINDING, 1 + rg::SHADOW_ATLAS_LIGHTS);
+    UniformHandle<glm::mat4> ourShaderModel = ourShader.uniform<glm::mat4>("model");
+    UniformHandle<glm::mat4> shadowPointModel = shadow_point.uniform<glm::mat4>("model");
+    UniformHandle<glm::mat4> shadowFaceModel = shadow_face.uniform<glm::mat4>("model");
+    Shader *shadowFacePrograms[] = {&shadow_face, &shadow_face_packed, &shadow_face_instanced};
+    UniformHandle<int> shadowFaceIndex[] = {shadow_face.uniform<int>("shadowFace"),
+                                            shadow_face_packed.uniform<int>("shadowFace"),
+                                            shadow_face_instanced.uniform<int>("shadowFace")};
+    // the models go through the render queue, which sorts each pass and instances repeated meshes
+    rg::Pipeline modelPipeline(ourShaderPacked, &ourShaderInstanced);
+    rg::Pipeline shadowPipeline(shadow_point_packed, &shadow_point_instanced);
+    rg::Pipeline shadowFacePipeline(shadow_face_packed, &shadow_face_instanced);
+    // and, where the vertex shader can select the layer, all six faces in one pass without a geometry shader
+    std::unique_ptr<Shader> shadow_layered, shadow_layered_packed, shadow_layered_instanced;
+    std::unique_ptr<rg::Pipeline> shadowLayeredPipeline;
+    UniformHandle<glm::mat4> shadowLayeredModel;
+    if (const char *vertexLayer = rg::vertexLayerDefine()) {
+        shadow_layered.reset(new Shader("resources/shaders/shadow.vs", "resources/shaders/shadow.fs", nullptr,
+                                        {vertexLayer, "LAYERED_FACES"}));
+        shadow_layered_packed.reset(new Shader("resources/shaders/shadow.vs", "resources/shaders/shadow.fs", nullptr,
+                                               {vertexLayer, "PACKED_VERTICES", "LAYERED_FACES"}));
+        shadow_layered_instanced.reset(new Shader("resources/shaders/shadow.vs", "resources/shaders/shadow.fs", nullptr,
+                                                  {vertexLayer, "PACKED_VERTICES", "INSTANCED", "LAYERED_FACES"}));
+        shadowLayeredPipeline.reset(new rg::Pipeline(*shadow_layered_packed, shadow_layered_instanced.get(), 6));
+        shadowLayeredModel = shadow_layered->uniform<glm::mat4>("model");
+        programState->layeredShadowsSupported = true;
+        programState->shadowPath = SHADOW_LAYERED;
+    }
+    // the sun's shadow cascades are drawn in one pass as well, layered from the vertex shader where it can and
+    // through cascade.gs otherwise
+    const char *cascadeLayer = rg::vertexLayerDefine();
+    const char *cascadeGeometry = cascadeLayer ? nullptr : "resources/shaders/cascade.gs";
+    std::vector<std::string> cascadeDefines;
+    if (cascadeLayer)
+        cascadeDefines = {cascadeLayer, "LAYERED_CASCADES"};
+    std::vector<std::string> cascadePackedDefines = cascadeDefines;
+    cascadePackedDefines.push_back("PACKED_VERTICES");
+    std::vector<std::string> cascadeInstancedDefines = cascadePackedDefines;
+    cascadeInstancedDefines.push_back("INSTANCED");
+    Shader cascade_shadow_packed("resources/shaders/cascade.vs", "resources/shaders/cascade.fs", cascadeGeometry, cascadePackedDefines);
+    Shader cascade_shadow_instanced("resources/shaders/cascade.vs", "resources/shaders/cascade.fs", cascadeGeometry, cascadeInstancedDefines);
+    rg::Pipeline cascadePipeline(cascade_shadow_packed, &cascade_shadow_instanced);
+    rg::RenderQueue renderQueue;
 
 
     float skyboxVertices[] = {
@@ -234,7 +422,7 @@ int main() {
     unsigned int skyboxVAO, skyboxVBO;
     glGenVertexArrays(1, &skyboxVAO);
     glGenBuffers(1, &skyboxVBO);
-    glBindVertexArray(skyboxVAO);
+    glState.bindVertexArray(skyboxVAO);
     glBindBuffer(GL_ARRAY_BUFFER, skyboxVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), &skyboxVertices, GL_STATIC_DRAW);
     glEnableVertexAttribArray(0);
@@ -258,7 +446,7 @@ int main() {
     unsigned int planeVAO, planeVBO;
     glGenVertexArrays(1, &planeVAO);
     glGenBuffers(1, &planeVBO);
-    glBindVertexArray(planeVAO);
+    glState.bindVertexArray(planeVAO);
     glBindBuffer(GL_ARRAY_BUFFER, planeVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(planeVertices), &planeVertices, GL_STATIC_DRAW);
     glEnableVertexAttribArray(0);
@@ -285,7 +473,7 @@ int main() {
     unsigned int transparentVAO, transparentVBO;
     glGenVertexArrays(1, &transparentVAO);
     glGenBuffers(1, &transparentVBO);
-    glBindVertexArray(transparentVAO);
+    glState.bindVertexArray(transparentVAO);
     glBindBuffer(GL_ARRAY_BUFFER, transparentVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(transparentVertices), transparentVertices, GL_STATIC_DRAW);
     glEnableVertexAttribArray(0);
@@ -294,44 +482,61 @@ int main() {
     glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
     glEnableVertexAttribArray(2);
     glVertexAttribPointer(2,3,GL_FLOAT,GL_FALSE,8 * sizeof(float),(void*)(5*sizeof(float)));
-    glBindVertexArray(0);
+    glState.bindVertexArray(0);
+    // every blade is an instance of the quad above
+    rg::GrassField grassField;
+    grassField.setup(transparentVAO, 6);
 
     //end trava
 
 
 
+    // queue the standalone textures first so the decode pool works on them while the models load
+    // --------------------------------------------------------------------------------------------
+    vector<std::string> faces
+    {
+        FileSystem::getPath("resources/textures/skybox/skybox_left.png"),
+        FileSystem::getPath("resources/textures/skybox/skybox_right.png"),
+        FileSystem::getPath("resources/textures/skybox/skybox_up.png"),
+        FileSystem::getPath("resources/textures/skybox/skybox_down.png"),
+        FileSystem::getPath("resources/textures/skybox/skybox_front.png"),
+        FileSystem::getPath("resources/textures/skybox/skybox_back.png")
+    };
+
+    unsigned int skybox=loadCubemap(faces);
+
+    unsigned int floorTexture = loadTexture(FileSystem::getPath("resources/objects/camp_fire/grass.jpg").c_str());
+
+    unsigned int grassTexture= loadTexture("resources/textures/grass.png");
+
     // load models
     // -----------
 
 
-    Model ourModel("resources/objects/camp_fire/Campfire OBJ.obj");
+    Model ourModel("resources/objects/camp_fire/Campfire OBJ.obj", false, VertexFormat::Packed, true);
     ourModel.SetShaderTextureNamePrefix("material.");
-    Model planina("resources/objects/mountain/mount.blend1.obj");
+    // upload whatever is decoded by now so the decoded images don't pile up in memory
+    rg::ImageDecodePool::instance().uploadReady();
+    Model planina("resources/objects/mountain/mount.blend1.obj", false, VertexFormat::Packed, true);
     planina.SetShaderTextureNamePrefix("material.");
+    // the mountain tiles around the campfire, the render queue merges them into one instanced draw per pass
+    std::vector<glm::mat4> planinaInstances;
+    for (const glm::vec3 &offset : {glm::vec3(2.5, 0.0, 0.0), glm::vec3(2.5, 0.0, 3.0), glm::vec3(0.0, 0.0, 3.0), glm::vec3(-2.5, 0.0, 3.0),
+                                    glm::vec3(-2.5, 0.0, 0.0), glm::vec3(-2.5, 0.0, -3.0), glm::vec3(0.0, 0.0, -3.0), glm::vec3(2.5, 0.0, -3.0)})
+        planinaInstances.push_back(glm::translate(glm::mat4(1.0f), offset));
 
     //ovde se priprema deapthmap
 
 
     const unsigned int SHADOW_WIDTH = 1024, SHADOW_HEIGHT = 1024;
-    unsigned int depthMapFBO;
-    glGenFramebuffers(1, &depthMapFBO);
-
-    unsigned int depthCubemap;
-    glGenTextures(1, &depthCubemap);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, depthCubemap);
-    for (unsigned int i = 0; i < 6; ++i)
-        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_DEPTH_COMPONENT, SHADOW_WIDTH, SHADOW_HEIGHT, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-
-    glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
-    glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthCubemap, 0);
-    glDrawBuffer(GL_NONE);
-    glReadBuffer(GL_NONE);
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    // depth cubemap of the point light, the static casters are only drawn into it when something changed
+    rg::PointShadowCache shadowCache(SHADOW_WIDTH);
+    std::vector<glm::mat4> staticCasters;
+    rg::ClusteredLights clusteredLights;
+    rg::ShadowAtlas shadowAtlas;
+    rg::CascadedShadowMap cascadedShadows;
+    rg::ShadowBlock shadow;
+    int shadowPathRendered = -1;
 
     //ovde se zavrsava
 
@@ -349,7 +554,7 @@ int main() {
     pointLight.quadratic = 0.032f;
 
     DirectionLight dirlight;
-    dirlight.direction=glm::vec3(0.0,25.0,0.0);
+    dirlight.direction=glm::vec3(-0.4,-1.0,-0.3);
     dirlight.ambient=glm::vec3 (0.05);
     dirlight.diffuse=glm::vec3 (0.05);
     dirlight.specular=glm::vec3(0.05);
@@ -370,23 +575,23 @@ int main() {
         glm::vec3(-15.5,0.5,-16.5),
         glm::vec3(17.5,0.5,-12.5)
     };
-
-
-    vector<std::string> faces
-    {
-        FileSystem::getPath("resources/textures/skybox/skybox_left.png"),
-        FileSystem::getPath("resources/textures/skybox/skybox_right.png"),
-        FileSystem::getPath("resources/textures/skybox/skybox_up.png"),
-        FileSystem::getPath("resources/textures/skybox/skybox_down.png"),
-        FileSystem::getPath("resources/textures/skybox/skybox_front.png"),
-        FileSystem::getPath("resources/textures/skybox/skybox_back.png")
+    // the hand placed tufts (same placement as the old per blade model matrices) plus a scattered field
+    // around the campfire, rebuilt whenever the density changes
+    float grassFieldDensity = -1.0f;
+    auto buildGrass = [&transacije, &grassField](float density) {
+        std::vector<rg::GrassInstance> instances;
+        for (unsigned int i = 0; i < transacije.size(); i++)
+            instances.push_back(rg::makeGrassInstance(transacije[i] * 0.1f, i % 2 == 0 ? glm::radians(15.0f * (i % 12)) : 0.0f, 0.1f));
+        rg::scatterGrass(instances, 1.75f, 0.05f, density, 0.15f, 0.06f, 0.12f);
+        grassField.setInstances(instances);
     };
 
-    unsigned int skybox=loadCubemap(faces);
 
-    unsigned int floorTexture = loadTexture(FileSystem::getPath("resources/objects/camp_fire/grass.jpg").c_str());
 
-    unsigned int grassTexture= loadTexture("resources/textures/grass.png");
+    // upload every texture still being decoded before the first frame
+    rg::ImageDecodePool::instance().finish();
+    RG_PROFILE_END();
+    std::cout << "Startup time: " << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startupBegin).count() << " ms" << std::endl;
 
     // draw in wireframe
     //glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
@@ -396,19 +601,87 @@ int main() {
     skybox_shader.use();
     skybox_shader.setInt("skybox",0);
 
+    for (Shader *shader : {&ourShader, &ourShaderPacked, &ourShaderInstanced}) {
+        shader->use();
+        shader->setInt("depthMap",15);
+        shader->setInt("clusterLights", rg::ClusteredLights::LIGHTS_UNIT);
+        shader->setInt("clusterRanges", rg::ClusteredLights::RANGES_UNIT);
+        shader->setInt("clusterIndices", rg::ClusteredLights::INDICES_UNIT);
+        shader->setInt("shadowAtlas", rg::ShadowAtlas::TEXTURE_UNIT);
+        shader->setInt("cascadeShadowMap", rg::CascadedShadowMap::TEXTURE_UNIT);
+        shader->setFloat("material.shininess", 8.0f);
+    }
+    // the floor plane is drawn with ourShader and its own texture
     ourShader.use();
-    ourShader.setInt("depthMap",15);
-
-    while (!glfwWindowShouldClose(window)) {
+    ourShader.setInt("material.texture_diffuse1", 0);
+
+    // headless and benchmark runs step a fixed clock so every run renders the same frames, and stop on their own.
+    // a benchmark lasts its warmup and then the camera path.
+    bool fixedClock = headless.enabled || benchmark.enabled;
+    float fixedTimestep = benchmark.enabled ? benchmark.timestep : 1.0f / 60.0f;
+    unsigned int frameLimit = 0;
+    if (benchmark.enabled)
+        frameLimit = benchmark.warmup + (unsigned int) std::ceil(cameraPath.duration() / benchmark.timestep) + 1;
+    else if (headless.enabled)
+        frameLimit = headless.frames;
+    std::unique_ptr<rg::FrameTimeRecorder> frameTimes;
+    if (benchmark.enabled)
+        frameTimes.reset(new rg::FrameTimeRecorder());
+
+    float recordStart = 0.0f;
+
+    unsigned int frameIndex = 0;
+    while ((!window || !glfwWindowShouldClose(window)) && (frameLimit == 0 || frameIndex < frameLimit)) {
+        RG_PROFILE_ZONE("Frame");
         // per-frame time logic
         // --------------------
-        float currentFrame = glfwGetTime();
+        float currentFrame = fixedClock ? frameIndex * fixedTimestep : (float) glfwGetTime();
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
+        glState.beginFrame();
+        // GPU time per pass, shown in the render statistics window. in instrumented builds the GL calls of each
+        // pass are counted too, see rg/GLInstrumentation.h
+        rg::GpuProfiler &gpuProfiler = rg::GpuProfiler::instance();
+        rg::GLInstrumentation &glInstrumentation = rg::GLInstrumentation::instance();
+        gpuProfiler.beginFrame();
+        glInstrumentation.beginFrame();
+        gpuProfiler.begin("Frame");
+        auto beginPass = [&](const char *name) {
+            gpuProfiler.begin(name);
+            glInstrumentation.beginPass(name);
+        };
+        auto endPass = [&]() {
+            glInstrumentation.endPass();
+            gpuProfiler.end();
+        };
+        bool measured = benchmark.enabled && frameIndex >= benchmark.warmup;
+        if (measured)
+            frameTimes->beginFrame();
 
         // input
         // -----
-        processInput(window);
+        if (window)
+            processInput(window);
+        if (benchmark.enabled) {
+            // the camera sits at the start of the path during the warmup
+            float pathTime = frameIndex < benchmark.warmup ? 0.0f : (frameIndex - benchmark.warmup) * benchmark.timestep;
+            rg::CameraKey key = cameraPath.sample(pathTime);
+            programState->camera.Position = key.position;
+            programState->camera.Yaw = key.yaw;
+            programState->camera.Pitch = key.pitch;
+            // recomputes the camera vectors from the angles
+            programState->camera.ProcessMouseMovement(0.0f, 0.0f, false);
+        } else if (!benchmark.record.empty() && (cameraPath.empty() || currentFrame - cameraPath.back().time >= 0.25f)) {
+            // the recorded path starts at 0 whenever the recording started
+            if (cameraPath.empty())
+                recordStart = currentFrame;
+            rg::CameraKey key;
+            key.time = currentFrame - recordStart;
+            key.position = programState->camera.Position;
+            key.yaw = programState->camera.Yaw;
+            key.pitch = programState->camera.Pitch;
+            cameraPath.add(key);
+        }
 
         pointLight.position = glm::vec3(1.5,0.1,0.2);//glm::vec3(4.0 * cos(currentFrame), 4.0f,
                                                                  //  4.0 * sin(currentFrame));
@@ -416,12 +689,14 @@ int main() {
         pointLight.diffuse = glm::vec3(0.5,0.4,0.4);
         pointLight.specular = glm::vec3(0.5,0.4,0.4);
 
+        RG_PROFILE_BEGIN("Matrices");
         glm::mat4 model = glm::mat4(1.0f);
         //model = glm::translate(model,programState->backpackPosition);
         model = glm::scale(model, glm::vec3(0.1/*programState->backpackScale*/));
         glm::mat4 projection = glm::perspective(glm::radians(programState->camera.Zoom),
                                                 (float) SCR_WIDTH / (float) SCR_HEIGHT, 0.1f, 100.0f);
         glm::mat4 view = programState->camera.GetViewMatrix();
+        RG_PROFILE_END();
 
 
 
@@ -431,279 +706,366 @@ int main() {
         // deapth cubemap
         float near_plane = 0.1f;
         float far_plane = 100.0f;
-        glm::mat4 shadowProj = glm::perspective(glm::radians(90.0f), (float) SHADOW_WIDTH / (float) SHADOW_HEIGHT,
-                                                near_plane, far_plane);
-        std::vector<glm::mat4> shadowTransforms;
         glm::vec3 lightPos = pointLight.position;
-        shadowTransforms.push_back(shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(1.0f, 0.0f, 0.0f),
-                                                            glm::vec3(0.0f, -1.0f, 0.0f)));
-        shadowTransforms.push_back(shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(-1.0f, 0.0f, 0.0f),
-                                                            glm::vec3(0.0f, -1.0f, 0.0f)));
-        shadowTransforms.push_back(shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(0.0f, 1.0f, 0.0f),
-                                                            glm::vec3(0.0f, 0.0f, 1.0f)));
-        shadowTransforms.push_back(shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(0.0f, -1.0f, 0.0f),
-                                                            glm::vec3(0.0f, 0.0f, -1.0f)));
-        shadowTransforms.push_back(shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(0.0f, 0.0f, 1.0f),
-                                                            glm::vec3(0.0f, -1.0f, 0.0f)));
-        shadowTransforms.push_back(shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(0.0f, 0.0f, -1.0f),
-                                                            glm::vec3(0.0f, -1.0f, 0.0f)));
-//render to cubemap
-
         glm::mat4 pomocna_model_matrica = model;
-        glViewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
-        glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
-        glClear(GL_DEPTH_BUFFER_BIT);
-        shadow_point.use();
-        for (unsigned int i = 0; i < 6; ++i)
-            shadow_point.setMat4("shadowMatrices[" + std::to_string(i) + "]", shadowTransforms[i]);
-        shadow_point.setFloat("far_plane", far_plane);
-        shadow_point.setVec3("lightPos", lightPos);
-        shadow_point.setMat4("model", model);
-        //shadow_point.setVec3("lightPos", lightPos/glm::vec3(0.1));
-        glDisable(GL_CULL_FACE);
-        ourModel.Draw(shadow_point);
-
-
-        model = glm::mat4(1.0f);//glm::scale(model, glm::vec3(10.0));
-        shadow_point.use();
-        shadow_point.setVec3("lightPos", lightPos/glm::vec3(0.1));
-        model = glm::translate(model, glm::vec3(2.5, 0.0, 0.0));
-        shadow_point.setMat4("model", model);
-        planina.Draw(shadow_point);
-
-        shadow_point.use();
-        model = glm::translate(model, glm::vec3(0.0, 0.0, 3.0));
-        shadow_point.setMat4("model", model);
-        planina.Draw(shadow_point);
-
-        shadow_point.use();
-
-        model = glm::translate(model, glm::vec3(-2.5, 0.0, 0.0));
-        shadow_point.setMat4("model", model);
-        planina.Draw(shadow_point);
-        shadow_point.use();
-        model = glm::translate(model, glm::vec3(-2.5, 0.0, 0.0));
-        shadow_point.setMat4("model", model);
-        planina.Draw(shadow_point);
-        shadow_point.use();
-        model = glm::translate(model, glm::vec3(0.0, 0.0, -3.0));
-        shadow_point.setMat4("model", model);
-        planina.Draw(shadow_point);
-        shadow_point.use();
-        model = glm::translate(model, glm::vec3(0.0, 0.0, -3.0));
-        shadow_point.setMat4("model", model);
-        planina.Draw(shadow_point);
-        shadow_point.use();
-        model = glm::translate(model, glm::vec3(2.5, 0.0, 0.0));
-        shadow_point.setMat4("model", model);
-        planina.Draw(shadow_point);
-        shadow_point.use();
-        model = glm::translate(model, glm::vec3(2.5, 0.0, 0.0));
-        shadow_point.setMat4("model", model);
-        planina.Draw(shadow_point);
-
-        glBindVertexArray(planeVAO);
-        shadow_point.use();
-        shadow_point.setMat4("model", pomocna_model_matrica);
-        shadow_point.setVec3("lightPos",lightPos);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
+        // the campfire, the mountain tiles and the floor plane never move, their shadows are only drawn again
+        // when the light or one of them does
+        staticCasters.clear();
+        staticCasters.push_back(model);
+        staticCasters.insert(staticCasters.end(), planinaInstances.begin(), planinaInstances.end());
+        staticCasters.push_back(pomocna_model_matrica);
+        uint64_t staticCastersHash = rg::hashTransforms(staticCasters);
+        bool renderStaticShadows = !programState->cacheShadows || shadowCache.isStale(lightPos, far_plane, staticCastersHash)
+                                   || programState->shadowPath != shadowPathRendered;
+        shadowPathRendered = programState->shadowPath;
+
+        // per-frame uniform blocks, one upload each for every program that reads them
+        rg::CameraBlock camera;
+        camera.projection = projection;
+        camera.view = view;
+        camera.viewPosition = programState->camera.Position;
+        cameraBlock.update(camera);
+
+        rg::LightsBlock lights;
+        lights.pointLight.position = pointLight.position;
+        lights.pointLight.constant = pointLight.constant;
+        lights.pointLight.ambient = pointLight.ambient;
+        lights.pointLight.linear = pointLight.linear;
+        lights.pointLight.diffuse = pointLight.diffuse;
+        lights.pointLight.quadratic = pointLight.quadratic;
+        lights.pointLight.specular = pointLight.specular;
+        lights.dirlight.direction = dirlight.direction;
+        lights.dirlight.ambient = dirlight.ambient;
+        lights.dirlight.diffuse = dirlight.diffuse;
+        lights.dirlight.specular = dirlight.specular;
+        lightsBlock.update(lights);
+
+        clusteredLights.clear();
+        addEmberLights(clusteredLights, pointLight.position, programState->emberCount, currentFrame);
+        shadowAtlas.beginFrame(staticCastersHash);
+        for (unsigned int lantern = 0; lantern < 4; ++lantern) {
+            rg::PointLightBlock light = lanternLight(lantern, currentFrame, programState->swingLanterns);
+            float radius = rg::pointLightRadius(light);
+            float coverage = rg::screenCoverage(light.position, radius, programState->camera.Position,
+                                                glm::radians(programState->camera.Zoom));
+            bool shadowed = shadowAtlas.setLight(lantern, light.position, radius, coverage);
+            clusteredLights.add(light, shadowed ? (int) lantern : -1);
+        }
+        programState->clusterStats = clusteredLights.build(view, projection, 0.1f, 100.0f);
+
+        if (renderStaticShadows)
+            rg::pointShadowMatrices(lightPos, near_plane, far_plane, shadow.shadowMatrices);
+        shadow.lightPos = lightPos;
+        shadow.farPlane = far_plane;
+        shadow.shadows = shadows;
+        shadowBlocks[0] = shadow;
+        // the lantern faces the atlas renders this frame, each scheduled lantern's matrices go to its own block
+        const std::vector<rg::ShadowAtlasUpdate> &atlasUpdates = shadowAtlas.schedule(programState->shadowFaceBudget);
+        int scheduledLantern = -1;
+        for (const rg::ShadowAtlasUpdate &update : atlasUpdates) {
+            // ordered by light
+            if ((int) update.light == scheduledLantern)
+                continue;
+            scheduledLantern = (int) update.light;
+            rg::ShadowBlock &lanternShadow = shadowBlocks[1 + update.light];
+            lanternShadow = shadow;
+            lanternShadow.lightPos = shadowAtlas.lightPosition(update.light);
+            lanternShadow.farPlane = shadowAtlas.lightFarPlane(update.light);
+            rg::pointShadowMatrices(lanternShadow.lightPos, near_plane, lanternShadow.farPlane, lanternShadow.shadowMatrices);
+        }
+        shadowBlocks.update();
+
+        // one face of a point light shadow, drawn with the SINGLE_FACE programs into whatever is bound. the
+        // light's block has to be bound to the Shadow binding point.
+        glm::vec3 planeCenter;
+        float planeRadius;
+        // the floor plane is 10x10 around the origin
+        rg::transformSphere(pomocna_model_matrica, glm::vec3(0.0f), std::sqrt(50.0f), planeCenter, planeRadius);
+        auto drawShadowFace = [&](unsigned int face, const glm::mat4 &faceMatrix, const glm::vec3 &facePosition, float faceFarPlane,
+                                  rg::RenderQueueStats &stats) {
+            for (int i = 0; i < 3; ++i) {
+                shadowFacePrograms[i]->use();
+                shadowFaceIndex[i].set(face);
+            }
+            rg::Frustum faceFrustum = rg::Frustum::fromMatrix(faceMatrix);
+            renderQueue.begin(facePosition, faceFarPlane);
+            renderQueue.submit(shadowFacePipeline, ourModel, model);
+            for (const glm::mat4 &tile : planinaInstances)
+                renderQueue.submit(shadowFacePipeline, planina, tile);
+            renderQueue.cull(faceFrustum);
+            stats.add(renderQueue.flush());
+
+            if (rg::sphereInFrustum(faceFrustum, planeCenter, planeRadius)) {
+                glState.bindVertexArray(planeVAO);
+                shadow_face.use();
+                shadowFaceModel.set(pomocna_model_matrica);
+                glDrawArrays(GL_TRIANGLES, 0, 6);
+            }
+        };
 
-        glEnable(GL_CULL_FACE);
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+//render to cubemap
+        if (renderStaticShadows) {
+            beginPass("Point shadow cubemap");
+            shadowCache.beginStatic(lightPos, far_plane, staticCastersHash);
+            glState.disable(GL_CULL_FACE);
+            if (programState->shadowPath == SHADOW_LAYERED) {
+                // the layered framebuffer of the cache, every draw is repeated for the six faces as instances
+                renderQueue.begin(lightPos, far_plane);
+                renderQueue.submit(*shadowLayeredPipeline, ourModel, model);
+                for (const glm::mat4 &tile : planinaInstances)
+                    renderQueue.submit(*shadowLayeredPipeline, planina, tile);
+                renderQueue.cull(lightPos, far_plane);
+                programState->shadowPassStats = renderQueue.flush();
+
+                glState.bindVertexArray(planeVAO);
+                shadow_layered->use();
+                shadowLayeredModel.set(pomocna_model_matrica);
+                glDrawArraysInstanced(GL_TRIANGLES, 0, 6, 6);
+            } else if (programState->shadowPath == SHADOW_PER_FACE) {
+                // each face only gets the casters inside its own frustum, instead of every caster in range
+                // being amplified to all six faces
+                programState->shadowPassStats = rg::RenderQueueStats();
+                for (unsigned int face = 0; face < 6; ++face) {
+                    shadowCache.bindStaticFace(face);
+                    drawShadowFace(face, shadow.shadowMatrices[face], lightPos, far_plane, programState->shadowPassStats);
+                }
+            } else {
+                renderQueue.begin(lightPos, far_plane);
+                renderQueue.submit(shadowPipeline, ourModel, model);
+                for (const glm::mat4 &tile : planinaInstances)
+                    renderQueue.submit(shadowPipeline, planina, tile);
+                renderQueue.cull(lightPos, far_plane);
+                programState->shadowPassStats = renderQueue.flush();
+
+                glState.bindVertexArray(planeVAO);
+                shadow_point.use();
+                shadowPointModel.set(pomocna_model_matrica);
+                glDrawArrays(GL_TRIANGLES, 0, 6);
+            }
+
+            glState.enable(GL_CULL_FACE);
+            glState.bindFramebuffer(0);
+            endPass();
+        } else {
+            programState->shadowPassStats = rg::RenderQueueStats();
+        }
+        programState->shadowCacheRenders = shadowCache.staticRenderCount();
+
+        // the lantern faces the atlas scheduled for this frame. the Shadow binding points at each lantern's block
+        // while its faces are drawn and at the campfire's again afterwards.
+        programState->atlasPassStats = rg::RenderQueueStats();
+        if (!atlasUpdates.empty()) {
+            beginPass("Shadow atlas");
+            glState.disable(GL_CULL_FACE);
+            int boundLantern = -1;
+            for (const rg::ShadowAtlasUpdate &update : atlasUpdates) {
+                if ((int) update.light != boundLantern) {
+                    boundLantern = (int) update.light;
+                    shadowBlocks.bind(1 + update.light);
+                }
+                const rg::ShadowBlock &lanternShadow = shadowBlocks[1 + update.light];
+                shadowAtlas.beginFace(update);
+                drawShadowFace(update.face, lanternShadow.shadowMatrices[update.face], lanternShadow.lightPos, lanternShadow.farPlane,
+                               programState->atlasPassStats);
+            }
+            shadowBlocks.bind(0);
+            glState.enable(GL_CULL_FACE);
+            glState.bindFramebuffer(0);
+            endPass();
+        }
+        shadowAtlas.finish();
+        programState->shadowAtlasStats = shadowAtlas.stats();
+
+        // sun shadows, the cascades' depth ranges are fitted to the campfire and the mountain tiles
+        cascadedShadows.clearCasters();
+        auto addCascadeCasters = [&](const Model &caster, const glm::mat4 &transform) {
+            for (const Mesh &mesh : caster.meshes) {
+                glm::vec3 center;
+                float radius;
+                rg::transformSphere(transform, mesh.boundsCenter, mesh.boundsRadius, center, radius);
+                cascadedShadows.addCaster(center, radius);
+            }
+        };
+        addCascadeCasters(ourModel, model);
+        for (const glm::mat4 &tile : planinaInstances)
+            addCascadeCasters(planina, tile);
+        cascadedShadows.update(view, glm::radians(programState->camera.Zoom), (float) SCR_WIDTH / (float) SCR_HEIGHT, 0.1f,
+                               programState->shadowDistance, programState->cascadeCount, programState->cascadeLambda,
+                               dirlight.direction);
+        if (cascadedShadows.count() > 0) {
+            beginPass("Sun cascades");
+            cascadePipeline.layers = cascadeLayer ? cascadedShadows.count() : 1;
+            cascadedShadows.begin();
+            glState.disable(GL_CULL_FACE);
+            renderQueue.begin(programState->camera.Position, programState->shadowDistance);
+            renderQueue.submit(cascadePipeline, ourModel, model);
+            for (const glm::mat4 &tile : planinaInstances)
+                renderQueue.submit(cascadePipeline, planina, tile);
+            renderQueue.cull(cascadedShadows.frustums(), cascadedShadows.count());
+            programState->cascadePassStats = renderQueue.flush();
+            cascadedShadows.end();
+            glState.enable(GL_CULL_FACE);
+            glState.bindFramebuffer(0);
+            endPass();
+        } else {
+            programState->cascadePassStats = rg::RenderQueueStats();
+        }
 
         model = pomocna_model_matrica;
 
         // render
-        glViewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
+        glState.viewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
         // ------
+        beginPass("Clear");
         glClearColor(programState->clearColor.r, programState->clearColor.g, programState->clearColor.b, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        // don't forget to enable shader before setting uniforms
-        ourShader.use();
-
-        ourShader.setVec3("pointLight.position", pointLight.position);
-        ourShader.setVec3("pointLight.ambient", pointLight.ambient);
-        ourShader.setVec3("pointLight.diffuse", pointLight.diffuse);
-        ourShader.setVec3("pointLight.specular", pointLight.specular);
-        ourShader.setFloat("pointLight.constant", pointLight.constant);
-        ourShader.setFloat("pointLight.linear", pointLight.linear);
-        ourShader.setFloat("pointLight.quadratic", pointLight.quadratic);
-        ourShader.setVec3("dirlight.direction", dirlight.direction);
-        ourShader.setVec3("dirlight.ambient", dirlight.ambient);
-        ourShader.setVec3("dirlight.diffuse", dirlight.diffuse);
-        ourShader.setVec3("dirlight.specular", dirlight.specular);
-
-        ourShader.setVec3("viewPosition", programState->camera.Position);
-        ourShader.setFloat("far_plane", far_plane);
-        ourShader.setFloat("material.shininess", 8.0f);
-        // view/projection transformations
-
-        ourShader.setMat4("projection", projection);
-        ourShader.setMat4("view", view);
-        ourShader.setInt("shadows", shadows);
+        endPass();
 
         // render the loaded model
 
-        ourShader.setMat4("model", model);
-        glActiveTexture(GL_TEXTURE15);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, depthCubemap);
-
-        ourModel.Draw(ourShader);
-        glActiveTexture(GL_TEXTURE15);
-
-
-
-
-        //planine
-
-        model =glm::mat4(1.0f); //glm::scale(model, glm::vec3(10.0));
+        glState.bindTexture(15, GL_TEXTURE_CUBE_MAP, shadowCache.cubemap());
+        clusteredLights.bind();
+        glState.bindTexture(rg::ShadowAtlas::TEXTURE_UNIT, GL_TEXTURE_2D_ARRAY, shadowAtlas.texture());
+        glState.bindTexture(rg::CascadedShadowMap::TEXTURE_UNIT, GL_TEXTURE_2D_ARRAY, cascadedShadows.texture());
 
-        model = glm::translate(model, glm::vec3(2.5, 0.0, 0.0));
-        ourShader.setMat4("model", model);
-        ourShader.setMat4("view", view);
-        ourShader.setMat4("projection", projection);
-        planina.Draw(ourShader);
-
-        model = glm::translate(model, glm::vec3(0.0, 0.0, 3.0));
-        ourShader.setMat4("model", model);
-        ourShader.setMat4("view", view);
-        ourShader.setMat4("projection", projection);
-        planina.Draw(ourShader);
-
-        model = glm::translate(model, glm::vec3(-2.5, 0.0, 0.0));
-        ourShader.setMat4("model", model);
-        ourShader.setMat4("view", view);
-        ourShader.setMat4("projection", projection);
-        planina.Draw(ourShader);
-
-        model = glm::translate(model, glm::vec3(-2.5, 0.0, 0.0));
-        ourShader.setMat4("model", model);
-        ourShader.setMat4("view", view);
-        ourShader.setMat4("projection", projection);
-        planina.Draw(ourShader);
-
-        model = glm::translate(model, glm::vec3(0.0, 0.0, -3.0));
-        ourShader.setMat4("model", model);
-        ourShader.setMat4("view", view);
-        ourShader.setMat4("projection", projection);
-        planina.Draw(ourShader);
-
-        model = glm::translate(model, glm::vec3(0.0, 0.0, -3.0));
-        ourShader.setMat4("model", model);
-        ourShader.setMat4("view", view);
-        ourShader.setMat4("projection", projection);
-        planina.Draw(ourShader);
-
-        model = glm::translate(model, glm::vec3(2.5, 0.0, 0.0));
-        ourShader.setMat4("model", model);
-        ourShader.setMat4("view", view);
-        ourShader.setMat4("projection", projection);
-        planina.Draw(ourShader);
-
-        model = glm::translate(model, glm::vec3(2.5, 0.0, 0.0));
-        ourShader.setMat4("model", model);
-        ourShader.setMat4("view", view);
-        ourShader.setMat4("projection", projection);
-        planina.Draw(ourShader);
+        // the campfire and the mountain tiles (planine)
+        beginPass("Campfire and mountains");
+        renderQueue.begin(programState->camera.Position, 100.0f);
+        renderQueue.submit(modelPipeline, ourModel, model);
+        for (const glm::mat4 &tile : planinaInstances)
+            renderQueue.submit(modelPipeline, planina, tile);
+        renderQueue.cull(programState->camera.GetFrustum(projection));
+        programState->mainPassStats = renderQueue.flush();
+        endPass();
 
 
 //pod
-        glCullFace(GL_FRONT);
-        glBindVertexArray(planeVAO);
+        beginPass("Floor");
+        glState.cullFace(GL_FRONT);
+        glState.bindVertexArray(planeVAO);
         //model1=glm::mat4(1.0);
         // model=glm::translate(model,glm::vec3(0.0,10,0.0));
         ourShader.use();
-        ourShader.setMat4("model", pomocna_model_matrica);
-        ourShader.setMat4("view", view);
-        ourShader.setMat4("projection", projection);
-        ourShader.setInt("material.texture_diffuse1",0);
+        ourShaderModel.set(pomocna_model_matrica);
          /*
 
           floor.setVec3("dirlight.direction", dirlight.direction);
           floor.setVec3("dirlight.ambient", dirlight.ambient);
           floor.setVec3("dirlight.diffuse", dirlight.diffuse);
           floor.setVec3("dirlight.specular", dirlight.specular);*/
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, floorTexture);
+        glState.bindTexture(0, GL_TEXTURE_2D, floorTexture);
         glDrawArrays(GL_TRIANGLES, 0, 6);
         //model=glm::translate(model,glm::vec3(0.0,-10,0.0));
         //glBindTexture(GL_TEXTURE_2D,0);
         //glActiveTexture(GL_TEXTURE0);
-        glCullFace(GL_BACK);
+        glState.cullFace(GL_BACK);
+        endPass();
 
 //kraj poda
 
 //trava
-        glDisable(GL_CULL_FACE);
+        beginPass("Grass");
+        glState.disable(GL_CULL_FACE);
         floor.use();
-        glBindVertexArray(transparentVAO);
-        glBindTexture(GL_TEXTURE_2D, grassTexture);
-        floor.setVec3("pointLight.position", pointLight.position);
-        floor.setVec3("pointLight.ambient", pointLight.ambient);
-        floor.setVec3("pointLight.diffuse", pointLight.diffuse);
-        floor.setVec3("pointLight.specular", pointLight.specular);
-        floor.setFloat("pointLight.constant", pointLight.constant);
-        floor.setFloat("pointLight.linear", pointLight.linear);
-        floor.setFloat("pointLight.quadratic", pointLight.quadratic);
-        floor.setVec3("viewPosition", programState->camera.Position);
-        glm::mat4 trava_model;
-        for (unsigned int i = 0; i < transacije.size(); i++) {
-            trava_model = glm::mat4(1.0);
-            trava_model = glm::scale(trava_model, glm::vec3(0.1));
-            trava_model = glm::translate(trava_model, transacije[i]);
-            if(i%2==0){
-                trava_model=glm::rotate(trava_model,glm::radians(15.0f*(i%12)),glm::vec3(0.0,1.0,0.0));
-            }
-            floor.setMat4("model", trava_model);
-            floor.setMat4("view", view);
-            floor.setMat4("projection", projection);
-            glDrawArrays(GL_TRIANGLES, 0, 6);
+        glState.bindVertexArray(transparentVAO);
+        glState.bindTexture(0, GL_TEXTURE_2D, grassTexture);
+        if (programState->grassDensity != grassFieldDensity) {
+            buildGrass(programState->grassDensity);
+            grassFieldDensity = programState->grassDensity;
         }
+        grassField.draw();
 
 
-        glEnable(GL_CULL_FACE);
+        glState.enable(GL_CULL_FACE);
+        endPass();
 //kraj trave
 
 
         //skybox
-        glDepthFunc(GL_LEQUAL);
+        beginPass("Skybox");
+        glState.depthFunc(GL_LEQUAL);
         skybox_shader.use();
-        skybox_shader.setMat4("view",glm::mat4(glm::mat3(view)));
-        skybox_shader.setMat4("projection",projection);
 
-        glBindVertexArray(skyboxVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, skybox);
+        glState.bindVertexArray(skyboxVAO);
+        glState.bindTexture(0, GL_TEXTURE_CUBE_MAP, skybox);
         glDrawArrays(GL_TRIANGLES, 0, 36);
-        glBindVertexArray(0);
-        glDepthFunc(GL_LESS);
+        glState.depthFunc(GL_LESS);
+        endPass();
 
-        if (programState->ImGuiEnabled)
+        if (programState->ImGuiEnabled) {
+            beginPass("ImGui");
             DrawImGui(programState);
+            // the ImGui backend binds its own program, VAO and texture
+            glState.invalidate();
+            endPass();
+        }
+        gpuProfiler.end();
 
 
 
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
         // -------------------------------------------------------------------------------
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        if (measured)
+            frameTimes->endFrame();
+        if (window) {
+            RG_PROFILE_BEGIN("glfwSwapBuffers");
+            glfwSwapBuffers(window);
+            RG_PROFILE_END();
+            glfwPollEvents();
+        }
+        frameIndex++;
     }
 
-    programState->SaveToFile("resources/program_state.txt");
+    // a headless run fails when GL reported an error or the screenshot couldn't be written
+    int status = 0;
+    if (headless.enabled) {
+        glFinish();
+        if (!headless.screenshot.empty() && !offscreen->writePPM(headless.screenshot)) {
+            std::cout << "Failed to write " << headless.screenshot << std::endl;
+            status = 1;
+        }
+        for (GLenum error = glGetError(); error != GL_NO_ERROR; error = glGetError()) {
+            std::cout << "OpenGL error 0x" << std::hex << error << std::dec << " during the headless run" << std::endl;
+            status = 1;
+        }
+        std::cout << "Rendered " << frameIndex << " frames headless" << std::endl;
+    }
+    if (benchmark.enabled) {
+        frameTimes->finish();
+        rg::BenchmarkReport report = rg::makeBenchmarkReport(*frameTimes, benchmark.timestep);
+        rg::printBenchmarkReport(report);
+        if (!rg::writeBenchmarkReport(benchmark.report, *frameTimes, report)) {
+            std::cout << "Failed to write the benchmark report " << benchmark.report << std::endl;
+            status = 1;
+        }
+        if (!benchmark.baseline.empty() && !rg::compareBenchmarkBaseline(benchmark.baseline, report, benchmark.threshold))
+            status = 1;
+        frameTimes.reset();
+    }
+    if (!benchmark.record.empty() && !cameraPath.save(benchmark.record)) {
+        std::cout << "Failed to write the camera path " << benchmark.record << std::endl;
+        status = 1;
+    }
+    if (!rg::writeCpuTrace(cpuTrace))
+        status = 1;
+    if (!headless.enabled && !benchmark.enabled)
+        programState->SaveToFile("resources/program_state.txt");
     delete programState;
-    ImGui_ImplOpenGL3_Shutdown();
-    ImGui_ImplGlfw_Shutdown();
+    if (window) {
+        ImGui_ImplOpenGL3_Shutdown();
+        ImGui_ImplGlfw_Shutdown();
+    }
     ImGui::DestroyContext();
-    // glfw: terminate, clearing all previously allocated GLFW resources.
-    // ------------------------------------------------------------------
-    glfwTerminate();
-    return 0;
+    rg::TextureRegistry::instance().shutdown();
+    rg::GpuProfiler::instance().shutdown();
+    // the GL objects of main are destroyed on return, before glfwSession terminates glfw
+    return status;
 }
 
 // process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
 // ---------------------------------------------------------------------------------------------------------
 void processInput(GLFWwindow *window) {
+    RG_PROFILE_ZONE("processInput");
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         glfwSetWindowShouldClose(window, true);
 
@@ -731,7 +1093,7 @@ void processInput(GLFWwindow *window) {
 void framebuffer_size_callback(GLFWwindow *window, int width, int height) {
     // make sure the viewport matches the new window dimensions; note that width and
     // height will be significantly larger than specified on retina displays.
-    glViewport(0, 0, width, height);
+    rg::GLState::instance().viewport(0, 0, width, height);
 }
 
 // glfw: whenever the mouse moves, this callback is called
@@ -760,6 +1122,7 @@ void scroll_callback(GLFWwindow *window, double xoffset, double yoffset) {
 }
 
 void DrawImGui(ProgramState *programState) {
+    RG_PROFILE_ZONE("DrawImGui");
     ImGui_ImplOpenGL3_NewFrame();
     ImGui_ImplGlfw_NewFrame();
     ImGui::NewFrame();
@@ -777,6 +1140,7 @@ void DrawImGui(ProgramState *programState) {
         ImGui::DragFloat("pointLight.constant", &programState->pointLight.constant, 0.05, 0.0, 1.0);
         ImGui::DragFloat("pointLight.linear", &programState->pointLight.linear, 0.05, 0.0, 1.0);
         ImGui::DragFloat("pointLight.quadratic", &programState->pointLight.quadratic, 0.05, 0.0, 1.0);
+        ImGui::DragFloat("Grass density", &programState->grassDensity, 50.0, 0.0, 20000.0);
         ImGui::End();
     }
 
@@ -790,6 +1154,93 @@ void DrawImGui(ProgramState *programState) {
         ImGui::End();
     }
 
+    {
+        ImGui::Begin("Render statistics");
+        for (auto pass : {std::make_pair("Shadow pass", &programState->shadowPassStats),
+                          std::make_pair("Shadow atlas pass", &programState->atlasPassStats),
+                          std::make_pair("Cascade pass", &programState->cascadePassStats),
+                          std::make_pair("Main pass", &programState->mainPassStats)}) {
+            const rg::RenderQueueStats &stats = *pass.second;
+            ImGui::Text("%s", pass.first);
+            ImGui::Text("  culled %u of %u packets", stats.culled, stats.culled + stats.packets);
+            ImGui::Text("  packets %u, draw calls %u (%u instanced), saved %u",
+                        stats.packets, stats.drawCalls, stats.instancedDrawCalls, stats.savedDrawCalls());
+            ImGui::Text("  program/material/VAO changes %u/%u/%u, unsorted %u/%u/%u, saved %d",
+                        stats.programChanges, stats.materialChanges, stats.vaoChanges,
+                        stats.unsortedProgramChanges, stats.unsortedMaterialChanges, stats.unsortedVaoChanges,
+                        stats.savedStateChanges());
+        }
+        ImGui::Checkbox("Cache static shadows", &programState->cacheShadows);
+        const char *shadowPaths[] = {"Geometry shader", "Six passes, culled per face", "Instanced layers"};
+        ImGui::Combo("Shadow path", &programState->shadowPath, shadowPaths,
+                     programState->layeredShadowsSupported ? SHADOW_PATH_COUNT : SHADOW_LAYERED);
+        ImGui::Text("Static shadow cubemap rendered %u times", programState->shadowCacheRenders);
+        ImGui::SliderInt("Embers", &programState->emberCount, 0, 1024);
+        ImGui::Checkbox("Swing lanterns", &programState->swingLanterns);
+        ImGui::SliderInt("Sun shadow cascades", &programState->cascadeCount, 0, rg::CascadedShadowMap::MAX_CASCADES);
+        ImGui::SliderFloat("Cascade split lambda", &programState->cascadeLambda, 0.0f, 1.0f);
+        ImGui::SliderFloat("Sun shadow distance", &programState->shadowDistance, 5.0f, 100.0f);
+        ImGui::SliderInt("Shadow atlas face budget", &programState->shadowFaceBudget, 1, 48);
+        const rg::ShadowAtlasStats &atlas = programState->shadowAtlasStats;
+        ImGui::Text("Shadow atlas: %u lights, %u faces rendered, %u deferred",
+                    atlas.lights, atlas.facesRendered, atlas.facesDeferred);
+        const rg::ClusterStats &clusters = programState->clusterStats;
+        ImGui::Text("Clustered lights: %u of %u visible, %u of %u clusters lit, %u indices",
+                    clusters.visibleLights, clusters.lights, clusters.litClusters, rg::ClusteredLights::CLUSTER_COUNT,
+                    clusters.indices);
+        const rg::GLStateStats &glStats = rg::GLState::instance().lastFrame();
+        ImGui::Text("GL state: %u calls issued, %u redundant ones elided", glStats.issued, glStats.elided);
+        // averaged over the last frames, nested passes are indented under the one they're part of
+        const rg::GpuProfiler &gpuProfiler = rg::GpuProfiler::instance();
+        if (ImGui::BeginTable("GPU passes", 3, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+            ImGui::TableSetupColumn("GPU pass");
+            ImGui::TableSetupColumn("avg ms");
+            ImGui::TableSetupColumn("last ms");
+            ImGui::TableHeadersRow();
+            for (const rg::GpuScopeTiming &timing : gpuProfiler.timings()) {
+                ImGui::TableNextColumn();
+                ImGui::Text("%*s%s", (int) timing.depth * 2, "", timing.name);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.3f", timing.averageMs);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.3f", timing.lastMs);
+            }
+            ImGui::EndTable();
+        }
+        ImGui::Text("GPU frames dropped by the profiler: %u", gpuProfiler.droppedFrames());
+        const rg::GLInstrumentation &glInstrumentation = rg::GLInstrumentation::instance();
+        if (glInstrumentation.enabled() && ImGui::BeginTable("GL calls", 6, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+            ImGui::TableSetupColumn("GL calls");
+            ImGui::TableSetupColumn("draws");
+            ImGui::TableSetupColumn("triangles");
+            ImGui::TableSetupColumn("state");
+            ImGui::TableSetupColumn("uploads");
+            ImGui::TableSetupColumn("KB");
+            ImGui::TableHeadersRow();
+            auto row = [](const char *name, const rg::GLCallStats &stats) {
+                ImGui::TableNextColumn();
+                ImGui::Text("%s", name);
+                ImGui::TableNextColumn();
+                ImGui::Text("%u", stats.drawCalls);
+                ImGui::TableNextColumn();
+                ImGui::Text("%llu", (unsigned long long) stats.triangles);
+                ImGui::TableNextColumn();
+                ImGui::Text("%u", stats.stateChanges);
+                ImGui::TableNextColumn();
+                ImGui::Text("%u", stats.bufferUploads + stats.textureUploads);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.1f", stats.uploadBytes / 1024.0);
+            };
+            for (const rg::GLPassStats &pass : glInstrumentation.lastFramePasses())
+                row(pass.name, pass.stats);
+            row("Frame", glInstrumentation.lastFrame());
+            ImGui::EndTable();
+            ImGui::Text("GL debug output %s, %u messages last frame", glInstrumentation.debugOutput() ? "on" : "unavailable",
+                        glInstrumentation.lastFrameDebugMessages());
+        }
+        ImGui::End();
+    }
+
     ImGui::Render();
     ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 }
@@ -810,74 +1261,119 @@ unsigned int loadCubemap(vector<std::string> faces)
 {
     unsigned int textureID;
     glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+    rg::GLState::instance().bindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
 
-    int width, height, nrChannels;
-    stbi_set_flip_vertically_on_load(false);
+    // the faces are decoded in parallel on the decode pool (cubemap faces are not flipped)
+    // and each one is uploaded as soon as it's ready.
     for (unsigned int i = 0; i < faces.size(); i++)
     {
-        unsigned char *data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
-        if (data)
+        rg::ImageDecodePool::instance().submit(faces[i], false, [textureID, i](const rg::DecodedImage &image)
+        {
+            if (image.data)
+            {
+                GLenum format;
+                if (image.components == 1)
+                    format = GL_RED;
+                else if (image.components == 3)
+                    format = GL_RGB;
+                else if (image.components == 4)
+                    format = GL_RGBA;
+
+                rg::GLState::instance().bindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+                glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, image.data);
+            }
+            else
+            {
+                std::cout << "Cubemap texture failed to load at path: " << image.path << std::endl;
+            }
+        });
+    }
+    return textureID;
+}
+// goes through the texture registry, so an image that's already resident (e.g. used by a model) isn't loaded again
+unsigned int loadTexture(char const * path)
+{
+    return rg::TextureRegistry::instance().acquire(path, "standalone", [path]()
+    {
+        return createTexture(path);
+    });
+}
+unsigned int createTexture(char const * path)
+{
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+
+    rg::ImageDecodePool::instance().submit(path, true, [textureID](const rg::DecodedImage &image)
+    {
+        if (image.data)
         {
             GLenum format;
-            if (nrChannels == 1)
+            if (image.components == 1)
                 format = GL_RED;
-            else if (nrChannels == 3)
+            else if (image.components == 3)
                 format = GL_RGB;
-            else if (nrChannels == 4)
+            else if (image.components == 4)
                 format = GL_RGBA;
 
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-            stbi_image_free(data);
+            rg::GLState::instance().bindTexture(GL_TEXTURE_2D, textureID);
+            glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, image.data);
+            glGenerateMipmap(GL_TEXTURE_2D);
+
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT); // for this tutorial: use GL_CLAMP_TO_EDGE to prevent semi-transparent borders. Due to interpolation it takes texels from next repeat
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
         }
         else
         {
-            std::cout << "Cubemap texture failed to load at path: " << faces[i] << std::endl;
-            stbi_image_free(data);
+            std::cout << "Texture failed to load at path: " << image.path << std::endl;
         }
-    }
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-    stbi_set_flip_vertically_on_load(true);
+    });
+
     return textureID;
 }
-unsigned int loadTexture(char const * path)
-{
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
 
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(path, &width, &height, &nrComponents, 0);
-    if (data)
-    {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT); // for this tutorial: use GL_CLAMP_TO_EDGE to prevent semi-transparent borders. Due to interpolation it takes texels from next repeat
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    }
-    else
-    {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
+// embers floating around the fire, spread on a golden angle spiral and flickering. every one is a short range
+// light for the clustered grid.
+void addEmberLights(rg::ClusteredLights &lights, const glm::vec3 &fire, int embers, float time)
+{
+    rg::PointLightBlock light;
+    light.padding = 0.0f;
+    for (int i = 0; i < embers; ++i) {
+        float angle = i * 2.39996f;
+        float distance = 0.3f + 2.5f * std::sqrt((i + 0.5f) / embers);
+        float height = 0.15f + 0.6f * std::fmod(i * 0.618034f, 1.0f) + 0.05f * std::sin(time * 1.7f + i);
+        float flicker = 0.7f + 0.3f * std::sin(time * 7.0f + i * 1.3f);
+        light.position = fire + glm::vec3(distance * std::cos(angle), height, distance * std::sin(angle));
+        light.ambient = glm::vec3(0.0f);
+        light.diffuse = glm::vec3(1.0f, 0.45f, 0.1f) * flicker;
+        light.specular = light.diffuse;
+        light.constant = 1.0f;
+        light.linear = 1.4f;
+        light.quadratic = 7.0f;
+        lights.add(light);
     }
-
-    return textureID;
 }
 
+// a lantern on one of the corners of the floor, swinging slowly when swing is set
+rg::PointLightBlock lanternLight(unsigned int corner, float time, bool swing)
+{
+    rg::PointLightBlock light;
+    glm::vec3 offset(0.0f);
+    if (swing)
+        offset = glm::vec3(0.3f * std::sin(time * 1.3f + corner), 0.0f, 0.3f * std::cos(time * 0.9f + corner));
+    light.position = glm::vec3((corner & 1) ? 4.5f : -4.5f, 1.0f, (corner & 2) ? 4.5f : -4.5f) + offset;
+    light.constant = 1.0f;
+    light.ambient = glm::vec3(0.0f);
+    light.linear = 0.35f;
+    light.diffuse = glm::vec3(1.0f, 0.85f, 0.5f);
+    light.quadratic = 0.44f;
+    light.specular = light.diffuse;
+    light.padding = 0.0f;
+    return light;
+}
@@ -0,0 +1,170 @@
+// Offline asset cooker: imports models with Assimp and writes the binary .rgm files Model loads at startup,
+// then block compresses every texture the models reference into a .ktx file with a precomputed mip chain.
+// usage: asset_cooker [--force] [--bc7] [--no-textures] model.obj...
+//   --force        cook even if the outputs are up to date
+//   --bc7          use BC7 instead of BC1/BC3 for color textures (needs GL 4.2 or ARB_texture_compression_bptc)
+//   --no-textures  only cook the models
+
+#include <rg/BlockCompression.h>
+#include <rg/CookedModel.h>
+#include <rg/KtxFile.h>
+#include <rg/ModelImporter.h>
+
+#include <stb_image.h>
+
+#include <iostream>
+#include <set>
+#include <string>
+#include <vector>
+
+struct CookOptions {
+    bool force = false;
+    bool bc7 = false;
+    bool textures = true;
+};
+
+const char* blockFormatName(rg::BlockFormat format) {
+    switch (format) {
+        case rg::BlockFormat::BC1: return "BC1";
+        case rg::BlockFormat::BC3: return "BC3";
+        case rg::BlockFormat::BC5: return "BC5";
+        case rg::BlockFormat::BC7: return "BC7";
+    }
+    return "?";
+}
+
+bool cookModel(std::string const &source, CookOptions const &options) {
+    std::string cooked = rg::cookedModelPath(source);
+    if (!options.force && rg::isCookedModelFresh(cooked, source)) {
+        std::cout << "up to date: " << cooked << std::endl;
+        return true;
+    }
+    rg::ImportedModel model;
+    if (!rg::importModel(source, model) || !rg::writeCookedModel(cooked, source, model)) {
+        std::cerr << "failed to cook: " << source << std::endl;
+        return false;
+    }
+    size_t vertexCount = 0, indexCount = 0;
+    for (size_t i = 0; i < model.meshes.size(); ++i)
+        rg::reportMeshOptimization(source + " mesh " + std::to_string(i), model.meshes[i].optimization);
+    for (const rg::ImportedMesh &mesh : model.meshes) {
+        vertexCount += mesh.vertices.size();
+        indexCount += mesh.indices.size();
+    }
+    std::cout << "cooked: " << cooked << " (" << model.meshes.size() << " meshes, " << vertexCount
+              << " vertices, " << indexCount << " indices, " << model.materials.size() << " materials)" << std::endl;
+    return true;
+}
+
+// whether an already cooked texture has a format the options choose. the choice between BC1 and BC3 depends on
+// the image's alpha, which can't change without the image getting newer than the .ktx.
+bool isChosenFormat(uint32_t glInternalFormat, std::string const &type, CookOptions const &options) {
+    auto is = [glInternalFormat](rg::BlockFormat format) {
+        return glInternalFormat == rg::blockFormatGLInternalFormat(format);
+    };
+    if (type == "texture_normal")
+        return is(rg::BlockFormat::BC5);
+    if (options.bc7)
+        return is(rg::BlockFormat::BC7);
+    return is(rg::BlockFormat::BC1) || is(rg::BlockFormat::BC3);
+}
+
+// normal maps go to BC5 (two channels, the shader reconstructs z), color maps to BC1 or BC3 depending on alpha.
+bool cookTexture(std::string const &imagePath, std::string const &type, CookOptions const &options) {
+    std::string ktxPath = rg::compressedTexturePath(imagePath);
+    uint64_t imageSize;
+    int64_t imageMtime;
+    if (!rg::statFile(imagePath, imageSize, imageMtime)) {
+        std::cerr << "missing texture: " << imagePath << std::endl;
+        return false;
+    }
+    uint32_t cookedFormat;
+    if (!options.force && rg::isCompressedTextureFresh(imagePath, cookedFormat) && isChosenFormat(cookedFormat, type, options)) {
+        std::cout << "up to date: " << ktxPath << std::endl;
+        return true;
+    }
+
+    int width, height, components;
+    unsigned char *data = stbi_load(imagePath.c_str(), &width, &height, &components, 0);
+    if (!data) {
+        std::cerr << "failed to decode: " << imagePath << std::endl;
+        return false;
+    }
+    rg::ImageRGBA8 image = rg::imageFromComponents(data, width, height, components);
+    stbi_image_free(data);
+
+    rg::BlockFormat format;
+    if (type == "texture_normal")
+        format = rg::BlockFormat::BC5;
+    else if (options.bc7)
+        format = rg::BlockFormat::BC7;
+    else
+        format = rg::imageHasAlpha(image) ? rg::BlockFormat::BC3 : rg::BlockFormat::BC1;
+
+    std::vector<rg::CompressedLevel> levels;
+    size_t uncompressedSize = 0, compressedSize = 0;
+    for (const rg::ImageRGBA8 &mip : rg::buildMipChain(image)) {
+        levels.push_back(rg::CompressedLevel{mip.width, mip.height, rg::compressImage(mip, format)});
+        uncompressedSize += size_t(mip.width) * mip.height * (components == 3 ? 3 : 4);
+        compressedSize += levels.back().data.size();
+    }
+    if (!rg::writeKtx(ktxPath, format, levels)) {
+        std::cerr << "failed to write: " << ktxPath << std::endl;
+        return false;
+    }
+    std::cout << "cooked: " << ktxPath << " (" << width << "x" << height << " " << blockFormatName(format) << ", "
+              << levels.size() << " mips, " << uncompressedSize / 1024 << " KB -> " << compressedSize / 1024 << " KB)" << std::endl;
+    return true;
+}
+
+bool cookModelTextures(std::string const &source, CookOptions const &options) {
+    rg::MappedFile file;
+    rg::CookedModelView cooked;
+    if (!file.open(rg::cookedModelPath(source)) || !cooked.open(file))
+        return false;
+    std::string directory = source.substr(0, source.find_last_of('/'));
+    std::set<std::string> done;
+    bool success = true;
+    for (uint32_t i = 0; i < cooked.header().textureCount; ++i) {
+        const rg::CookedTextureRecord &texture = cooked.textures()[i];
+        std::string path = directory + '/' + cooked.string(texture.pathOffset, texture.pathLength);
+        if (!done.insert(path).second)
+            continue;
+        success &= cookTexture(path, cooked.string(texture.typeOffset, texture.typeLength), options);
+    }
+    return success;
+}
+
+int main(int argc, char **argv) {
+    CookOptions options;
+    std::vector<std::string> sources;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--force")
+            options.force = true;
+        else if (arg == "--bc7")
+            options.bc7 = true;
+        else if (arg == "--no-textures")
+            options.textures = false;
+        else
+            sources.push_back(arg);
+    }
+    if (sources.empty()) {
+        std::cerr << "usage: " << argv[0] << " [--force] [--bc7] [--no-textures] model..." << std::endl;
+        return 2;
+    }
+
+    // same orientation as TextureFromFile uploads
+    stbi_set_flip_vertically_on_load(true);
+
+    int failed = 0;
+    for (const std::string &source : sources) {
+        if (!cookModel(source, options)) {
+            ++failed;
+            continue;
+        }
+        if (options.textures && !cookModelTextures(source, options))
+            ++failed;
+    }
+    return failed == 0 ? 0 : 1;
+}